@@ -36,6 +36,14 @@ boost::asio::io_context& AsioIOServicePool::getIOService() {
     return service;
 }
 
+boost::asio::io_context& AsioIOServicePool::getIOService(std::size_t index) {
+    return ioServices_[index % ioServices_.size()];
+}
+
+std::size_t AsioIOServicePool::size() const {
+    return ioServices_.size();
+}
+
 void AsioIOServicePool::stop() {
     //因为仅仅执行work.reset并不能让iocontext从run的状态中退出
     //当iocontext已经绑定了读或写的监听事件后，还需要手动stop该服务。
@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "mysqlmgr.h"
+#include "utils.h"
+#include "data.h"
+
+/******************************************************************************
+ * @file       chatmsginsert_bench.cpp
+ * @brief      聊天消息落库吞吐测试：MysqlMgr::addChatMsg(vector)在不同批大小下的每秒消息数，
+ *             以逐条调用addChatMsg(单条)为对照
+ *
+ *             编译：与ChatServer除main.cpp外的源文件一起编译链接，依赖同ChatServer，例如
+ *             g++ -std=c++20 -O2 -I.. chatmsginsert_bench.cpp <ChatServer其余源文件> <ChatServer链接库>
+ *             运行：在放有config.ini的目录下执行
+ *             chatmsginsert_bench <thread_id> <sender_id> <recv_id> [每个批大小写入的消息数]
+ *             会向chat_message写入测试消息，只在测试库上运行
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+static std::vector<std::shared_ptr<ChatMessage>> makeBatch(int thread_id, int sender_id, int recv_id, std::size_t size) {
+    std::vector<std::shared_ptr<ChatMessage>> batch;
+    batch.reserve(size);
+    auto timestamp = getCurrentTimestamp();
+    for (std::size_t i = 0; i < size; ++i) {
+        auto msg = std::make_shared<ChatMessage>();
+        msg->message_id = 0;
+        msg->thread_id = thread_id;
+        msg->sender_id = sender_id;
+        msg->recv_id = recv_id;
+        msg->content = "bench message " + std::to_string(i);
+        msg->chat_time = timestamp;
+        msg->status = 2;
+        msg->msg_type = int(ChatMsgType::TEXT);
+        batch.push_back(msg);
+    }
+    return batch;
+}
+
+// 以batch_size为一批写入total条消息，返回每秒消息数，失败返回负数
+static double run(int thread_id, int sender_id, int recv_id, std::size_t batch_size, std::size_t total, bool single) {
+    auto mysql = MysqlMgr::getInstance();
+    std::size_t written = 0;
+    auto begin = std::chrono::steady_clock::now();
+    while (written < total) {
+        auto batch = makeBatch(thread_id, sender_id, recv_id, std::min(batch_size, total - written));
+        if (single) {
+            for (auto& msg : batch) {
+                if (!mysql->addChatMsg(msg)) {
+                    return -1;
+                }
+            }
+        }
+        else if (!mysql->addChatMsg(batch)) {
+            return -1;
+        }
+        written += batch.size();
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return written / seconds;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cout << "usage: chatmsginsert_bench <thread_id> <sender_id> <recv_id> [msgs per batch size]" << std::endl;
+        return 1;
+    }
+    int thread_id = atoi(argv[1]);
+    int sender_id = atoi(argv[2]);
+    int recv_id = atoi(argv[3]);
+    std::size_t total = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 2000;
+
+    //预热连接池和语句缓存
+    run(thread_id, sender_id, recv_id, 16, 64, false);
+
+    auto single = run(thread_id, sender_id, recv_id, 1, total, true);
+    if (single < 0) {
+        std::cout << "single-row insert failed" << std::endl;
+        return 1;
+    }
+    std::cout << "single-row  msgs/sec " << single << std::endl;
+    for (std::size_t batch_size : { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512 }) {
+        auto rate = run(thread_id, sender_id, recv_id, batch_size, total, false);
+        if (rate < 0) {
+            std::cout << "batch " << batch_size << " insert failed" << std::endl;
+            return 1;
+        }
+        std::cout << "batch " << batch_size << "  msgs/sec " << rate << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../../Common/jsonutil.h"
+
+/******************************************************************************
+ * @file       jsonutil_bench.cpp
+ * @brief      json序列化和解析前后对比：toStyledString + Json::Reader 与 toJsonString + parseJson，
+ *             输出每条消息的耗时和字节数；GateServer和ResourceServer共用Common/jsonutil.h，结论通用
+ *             负载优先使用命令行给出的抓包文件，每个文件是一条线上收发的消息体（去掉6字节包头后的json）；
+ *             没有给出文件时按服务器实际回包的字段构造（登录回包、聊天记录翻页、文本消息请求），
+ *             构造的负载字段齐全但内容是编的，字符串长度和好友数等分布与线上不一定相同
+ *
+ *             编译：g++ -std=c++20 -O2 -I/usr/include/jsoncpp jsonutil_bench.cpp -ljsoncpp
+ *             运行：jsonutil_bench [每种负载的次数] [抓包文件...]
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history    2026/10/18 支持读取抓包的消息体作为负载
+ *****************************************************************************/
+
+// 对照组使用已废弃的Json::Reader
+#if defined(_MSC_VER)
+#pragma warning(disable : 4996)
+#else
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+// 登录回包：用户信息、好友申请和50个好友
+static Json::Value makeLoginRsp() {
+    Json::Value rtvalue;
+    rtvalue["error"] = 0;
+    rtvalue["uid"] = 1019;
+    rtvalue["pwd"] = "745230";
+    rtvalue["name"] = "lueying";
+    rtvalue["email"] = "lueying@example.com";
+    rtvalue["nick"] = "掠影";
+    rtvalue["desc"] = "这个人很懒，什么都没有留下";
+    rtvalue["sex"] = 0;
+    rtvalue["icon"] = "head_1.jpg";
+    rtvalue["token"] = "6c3f0a52-2f1e-4f0e-9d1b-8a9a4c1d2e7f";
+    for (int i = 0; i < 3; ++i) {
+        Json::Value obj;
+        obj["name"] = "apply_user_" + std::to_string(i);
+        obj["uid"] = 2000 + i;
+        obj["icon"] = "head_2.jpg";
+        obj["nick"] = "申请人" + std::to_string(i);
+        obj["sex"] = 1;
+        obj["desc"] = "你好，加个好友";
+        obj["status"] = 0;
+        rtvalue["apply_list"].append(obj);
+    }
+    for (int i = 0; i < 50; ++i) {
+        Json::Value obj;
+        obj["name"] = "friend_" + std::to_string(i);
+        obj["uid"] = 3000 + i;
+        obj["icon"] = "head_" + std::to_string(i % 5) + ".jpg";
+        obj["nick"] = "好友" + std::to_string(i);
+        obj["sex"] = i % 2;
+        obj["desc"] = "今天也要好好学习";
+        obj["back"] = "备注" + std::to_string(i);
+        rtvalue["friend_list"].append(obj);
+    }
+    return rtvalue;
+}
+
+// 聊天记录翻页回包：一页20条
+static Json::Value makeChatPageRsp() {
+    Json::Value rtvalue;
+    rtvalue["error"] = 0;
+    rtvalue["thread_id"] = 88;
+    rtvalue["last_message_id"] = 10420;
+    rtvalue["load_more"] = true;
+    for (int i = 0; i < 20; ++i) {
+        Json::Value chat_data;
+        chat_data["sender"] = i % 2 ? 1019 : 3001;
+        chat_data["msg_id"] = 10400 + i;
+        chat_data["thread_id"] = 88;
+        chat_data["unique_id"] = 0;
+        chat_data["msg_content"] = "晚上一起去吃饭吗？老地方见 " + std::to_string(i);
+        chat_data["chat_time"] = "2026-10-17 20:15:3" + std::to_string(i % 10);
+        chat_data["status"] = 2;
+        chat_data["msg_type"] = 0;
+        chat_data["receiver"] = i % 2 ? 3001 : 1019;
+        rtvalue["chat_datas"].append(chat_data);
+    }
+    return rtvalue;
+}
+
+// 文本消息请求：一次发送3条
+static Json::Value makeTextChatReq() {
+    Json::Value root;
+    root["fromuid"] = 1019;
+    root["touid"] = 3001;
+    root["thread_id"] = 88;
+    for (int i = 0; i < 3; ++i) {
+        Json::Value txt_obj;
+        txt_obj["content"] = "收到，马上到";
+        txt_obj["unique_id"] = "b1c2d3e4-0000-4000-8000-00000000000" + std::to_string(i);
+        root["text_array"].append(txt_obj);
+    }
+    return root;
+}
+
+// 执行count次，返回每次的纳秒数
+static double measure(std::size_t count, const std::function<void()>& func) {
+    auto begin = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i) {
+        func();
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    return static_cast<double>(ns) / count;
+}
+
+struct Payload {
+    std::string name;
+    Json::Value value;
+};
+
+// 读取抓包文件中的消息体，文件不存在或不是合法json时返回false
+static bool loadPayload(const std::string& path, Payload& payload) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    payload.name = path;
+    return parseJson(content.str(), payload.value);
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    if (count == 0) {
+        std::cout << "usage: jsonutil_bench [count] [captured body files...]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Payload> payloads;
+    for (int i = 2; i < argc; ++i) {
+        Payload payload;
+        if (!loadPayload(argv[i], payload)) {
+            std::cout << "load captured body failed: " << argv[i] << std::endl;
+            return 1;
+        }
+        payloads.push_back(std::move(payload));
+    }
+    if (payloads.empty()) {
+        std::cout << "no captured bodies given, using synthesized payloads" << std::endl;
+        payloads = { { "login_rsp", makeLoginRsp() }, { "chat_page_rsp", makeChatPageRsp() },
+            { "text_chat_req", makeTextChatReq() } };
+    }
+
+    std::size_t sink = 0;
+    for (auto& payload : payloads) {
+        auto styled = payload.value.toStyledString();
+        auto compact = toJsonString(payload.value);
+
+        auto styled_write = measure(count, [&]() {
+            sink += payload.value.toStyledString().size();
+            });
+        auto compact_write = measure(count, [&]() {
+            sink += toJsonString(payload.value).size();
+            });
+        auto reader_parse = measure(count, [&]() {
+            Json::Reader reader;
+            Json::Value root;
+            sink += reader.parse(styled, root) ? root.size() : 0;
+            });
+        auto fast_parse = measure(count, [&]() {
+            Json::Value root;
+            sink += parseJson(compact, root) ? root.size() : 0;
+            });
+
+        std::cout << payload.name << std::endl;
+        std::cout << "  before: " << styled.size() << " bytes, write " << styled_write << " ns, parse "
+            << reader_parse << " ns" << std::endl;
+        std::cout << "  after:  " << compact.size() << " bytes, write " << compact_write << " ns, parse "
+            << fast_parse << " ns" << std::endl;
+    }
+    //防止编译器把测试循环优化掉
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,277 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include "mpscqueue.h"
+
+/******************************************************************************
+ * @file       mpscqueue_bench.cpp
+ * @brief      会话发送队列的竞争测试：多个生产者线程同时入队，一个消费者线程出队，
+ *             对比MpscQueue和原来的std::mutex + std::queue<std::shared_ptr>；
+ *             同时校验每个生产者的消息按顺序、不丢不重地到达，兼作压力测试；
+ *             另外模拟CSession的写操作调度（消费者是io_context线程，由生产者投递写操作），
+ *             对比按计数投递、取不到消息就重新投递自己的旧做法和交还写权限的做法，
+ *             统计每条消息触发的写操作次数和其中没取到消息的次数（旧做法中每次都会重新投递，
+ *             现在的做法中每次都以交还写权限结束）
+ *
+ *             编译：g++ -std=c++20 -O2 -I.. mpscqueue_bench.cpp -pthread -o mpscqueue_bench
+ *             运行：mpscqueue_bench [每个生产者的消息数] [最大生产者数]
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history    2026/10/18 增加写操作调度的对比
+ *****************************************************************************/
+
+// 消息负载，模拟发送队列中的shared_ptr<SendNode>
+struct Item : public MpscNode<Item> {
+    Item(std::size_t p, std::size_t s) : producer(p), seq(s) {
+    }
+    std::size_t producer;
+    std::size_t seq;
+};
+using ItemPtr = std::shared_ptr<Item>;
+
+// 原来的做法：每次入队和出队都加同一把锁
+class LockedQueue {
+public:
+    void push(ItemPtr value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push(std::move(value));
+    }
+    bool pop(ItemPtr& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return false;
+        }
+        value = std::move(queue_.front());
+        queue_.pop();
+        return true;
+    }
+private:
+    std::mutex mutex_;
+    std::queue<ItemPtr> queue_;
+};
+
+// producers个线程各入队count条，消费者收齐后返回每秒消息数，顺序或数量不对时返回负数
+template <typename Queue>
+static double run(std::size_t producers, std::size_t count) {
+    Queue queue;
+    std::vector<std::thread> threads;
+    auto begin = std::chrono::steady_clock::now();
+    for (std::size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p, count]() {
+            for (std::size_t i = 0; i < count; ++i) {
+                queue.push(std::make_shared<Item>(p, i));
+            }
+            });
+    }
+
+    std::vector<std::size_t> next_seq(producers, 0);
+    std::size_t received = 0;
+    bool ordered = true;
+    ItemPtr item;
+    while (received < producers * count) {
+        if (!queue.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item->seq != next_seq[item->producer]) {
+            ordered = false;
+        }
+        next_seq[item->producer] = item->seq + 1;
+        ++received;
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    //全部收齐后队列应为空
+    if (!ordered || queue.pop(item)) {
+        return -1;
+    }
+    return received / seconds;
+}
+
+struct WriteStats {
+    double msgs_per_sec;
+    double writes_per_msg;      // 每条消息执行的startWrite次数
+    double empty_per_msg;       // 每条消息执行的、没取到任何消息的startWrite次数
+};
+
+// 模拟会话的写操作：startWrite在io线程中取出队列中的全部消息作为一批，
+// 批次写完的回调同样投递到io线程，模拟async_write的完成回调
+class WriteSim {
+public:
+    WriteSim(std::size_t producers, std::size_t total) : next_seq_(producers, 0), total_(total) {
+    }
+    virtual ~WriteSim() = default;
+
+    virtual void push(ItemPtr item) = 0;
+
+    // producers个线程各发送count条，io线程收齐后返回统计结果，顺序或数量不对时msgs_per_sec为负数
+    WriteStats run(std::size_t producers, std::size_t count) {
+        auto guard = boost::asio::make_work_guard(ioc_);
+        std::thread io_thread([this]() {
+            ioc_.run();
+            });
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < producers; ++p) {
+            threads.emplace_back([this, p, count]() {
+                for (std::size_t i = 0; i < count; ++i) {
+                    push(std::make_shared<Item>(p, i));
+                }
+                });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        while (received_.load() < total_) {
+            std::this_thread::yield();
+        }
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        guard.reset();
+        io_thread.join();
+
+        ItemPtr item;
+        bool ok = ordered_ && received_.load() == total_ && !queue_.pop(item);
+        return { ok ? total_ / seconds : -1, static_cast<double>(writes_) / total_,
+            static_cast<double>(empty_writes_) / total_ };
+    }
+
+protected:
+    // 取出上次留下的消息和当前能取到的全部消息，返回条数
+    std::size_t takeBatch(ItemPtr carry = nullptr) {
+        ++writes_;
+        std::size_t taken = 0;
+        ItemPtr item = std::move(carry);
+        while (item || queue_.pop(item)) {
+            if (item->seq != next_seq_[item->producer]) {
+                ordered_ = false;
+            }
+            next_seq_[item->producer] = item->seq + 1;
+            ++taken;
+            item.reset();
+        }
+        if (taken == 0) {
+            ++empty_writes_;
+        }
+        received_.fetch_add(taken);
+        return taken;
+    }
+
+    boost::asio::io_context ioc_;
+    MpscQueue<Item> queue_;
+
+private:
+    std::vector<std::size_t> next_seq_;
+    std::size_t total_;
+    std::atomic<std::size_t> received_{ 0 };
+    bool ordered_ = true;
+    std::size_t writes_ = 0;
+    std::size_t empty_writes_ = 0;
+};
+
+// 旧做法：计数由0变为1的生产者投递写操作，计数了但消息尚未链接时写操作重新投递自己
+class CountedWriteSim : public WriteSim {
+public:
+    using WriteSim::WriteSim;
+
+    void push(ItemPtr item) override {
+        queue_.push(std::move(item));
+        if (pending_.fetch_add(1) == 0) {
+            boost::asio::post(ioc_, [this]() { startWrite(); });
+        }
+    }
+
+private:
+    void startWrite() {
+        auto taken = takeBatch();
+        if (taken == 0) {
+            boost::asio::post(ioc_, [this]() { startWrite(); });
+            return;
+        }
+        boost::asio::post(ioc_, [this, taken]() {
+            if (pending_.fetch_sub(static_cast<int>(taken)) - static_cast<int>(taken) > 0) {
+                startWrite();
+            }
+            });
+    }
+
+    std::atomic<int> pending_{ 0 };
+};
+
+// 现在的做法，与CSession::pushSendNode/startWrite相同：入队后抢写权限，取不到消息时交还
+class HandoffWriteSim : public WriteSim {
+public:
+    using WriteSim::WriteSim;
+
+    void push(ItemPtr item) override {
+        queue_.push(std::move(item));
+        if (!writing_.exchange(true, std::memory_order_acq_rel)) {
+            boost::asio::post(ioc_, [this]() { startWrite(); });
+        }
+    }
+
+private:
+    void startWrite() {
+        for (;;) {
+            if (takeBatch(std::move(carry_)) > 0) {
+                boost::asio::post(ioc_, [this]() { startWrite(); });
+                return;
+            }
+            writing_.exchange(false, std::memory_order_acq_rel);
+            if (!queue_.pop(carry_)) {
+                return;
+            }
+            if (writing_.exchange(true, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+    }
+
+    std::atomic<bool> writing_{ false };
+    ItemPtr carry_;     // 交还写权限后补取到的消息，与会话中的carry_node_相同
+};
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::size_t max_producers = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    if (count == 0 || max_producers == 0) {
+        std::cout << "usage: mpscqueue_bench [count per producer] [max producers]" << std::endl;
+        return 1;
+    }
+
+    for (std::size_t producers = 1; producers <= max_producers; producers *= 2) {
+        auto locked = run<LockedQueue>(producers, count);
+        auto mpsc = run<MpscQueue<Item>>(producers, count);
+        if (locked < 0 || mpsc < 0) {
+            std::cout << "producers " << producers << ": lost, duplicated or reordered messages" << std::endl;
+            return 1;
+        }
+        std::cout << "producers " << producers << "  mutex+queue msgs/sec " << locked
+            << "  mpsc msgs/sec " << mpsc << std::endl;
+    }
+
+    for (std::size_t producers = 1; producers <= max_producers; producers *= 2) {
+        auto counted = CountedWriteSim(producers, producers * count).run(producers, count);
+        auto handoff = HandoffWriteSim(producers, producers * count).run(producers, count);
+        if (counted.msgs_per_sec < 0 || handoff.msgs_per_sec < 0) {
+            std::cout << "producers " << producers << ": write scheduling lost, duplicated or reordered messages" << std::endl;
+            return 1;
+        }
+        std::cout << "producers " << producers << "  write repost msgs/sec " << counted.msgs_per_sec
+            << " writes/msg " << counted.writes_per_msg << " empty/msg " << counted.empty_per_msg
+            << "  write handoff msgs/sec " << handoff.msgs_per_sec
+            << " writes/msg " << handoff.writes_per_msg << " empty/msg " << handoff.empty_per_msg << std::endl;
+    }
+    return 0;
+}
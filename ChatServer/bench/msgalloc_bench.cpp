@@ -0,0 +1,152 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+#include "logicnodepool.h"
+#include "logicworker.h"
+#include "sendnodepool.h"
+
+/******************************************************************************
+ * @file       msgalloc_bench.cpp
+ * @brief      消息收发路径的微基准：统计每条消息的堆分配次数和耗时
+ *             接收：从节点池取出节点、投递到LogicWorker、回调执行后归还，
+ *                   对比逐条make_shared的旧做法
+ *             发送：从发送节点池取出节点并写入消息、进入会话发送队列、出队写完后归还，
+ *                   对比逐条make_shared<SendNode>的旧做法
+ *             不包含socket读写、LogicSystem的分发和回调自身的业务处理（json解析、查库等），
+ *             登录等协程回调的协程帧也不在统计范围内
+ *
+ *             编译：与ChatServer除main.cpp外的源文件一起编译链接，依赖同ChatServer，例如
+ *             g++ -std=c++20 -O2 -I.. msgalloc_bench.cpp <ChatServer其余源文件> <ChatServer链接库>
+ *             运行：msgalloc_bench [消息数] [在途消息数]
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history    2026/10/18 覆盖投递到逻辑线程和发送队列的完整路径
+ *****************************************************************************/
+
+// 替换全局operator new统计分配次数，所有线程的分配都计入
+static std::atomic<std::size_t> g_alloc_count{ 0 };
+
+void* operator new(std::size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+struct BenchResult {
+    double allocs_per_msg;
+    double ns_per_msg;
+};
+
+// 模拟一条聊天消息的消息体
+static const char BODY[] = "{\"fromuid\":1001,\"touid\":1002,\"text_array\":[{\"msgid\":\"bench\",\"content\":\"hello\"}]}";
+static const short BODY_LEN = sizeof(BODY) - 1;
+static const short BENCH_MSG_ID = 1;
+
+// 接收路径：最多in_flight条消息在逻辑线程的队列中等待，超出时等待逻辑线程处理
+template <typename Acquire>
+static BenchResult runRecv(std::size_t count, std::size_t in_flight, Acquire acquire) {
+    std::map<short, FunCallBack> callbacks;
+    callbacks[BENCH_MSG_ID] = [](std::shared_ptr<CSession>, const short&, std::string_view) {
+        };
+    LogicWorker worker(0, callbacks);
+
+    auto post = [&](std::size_t total) {
+        auto handled_begin = worker.getStats().handled_count;
+        for (std::size_t i = 0; i < total; ++i) {
+            while (i - (worker.getStats().handled_count - handled_begin) >= in_flight) {
+                std::this_thread::yield();
+            }
+            worker.postTask(acquire());
+        }
+        while (worker.getStats().handled_count - handled_begin < total) {
+            std::this_thread::yield();
+        }
+        };
+
+    //预热，让节点池和队列容量达到稳定状态
+    post(in_flight * 2);
+
+    auto alloc_begin = g_alloc_count.load();
+    auto time_begin = std::chrono::steady_clock::now();
+    post(count);
+    auto time_end = std::chrono::steady_clock::now();
+    auto allocs = g_alloc_count.load() - alloc_begin;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time_end - time_begin).count();
+    return { static_cast<double>(allocs) / count, static_cast<double>(ns) / count };
+}
+
+// 发送路径：最多in_flight条消息正在写，超出时最早的一条写完归还
+template <typename Acquire>
+static BenchResult runSend(std::size_t count, std::size_t in_flight, Acquire acquire) {
+    MpscQueue<SendNode> send_queue;
+    std::vector<std::shared_ptr<SendNode>> sending(in_flight);
+    auto send = [&](std::size_t total) {
+        std::shared_ptr<SendNode> node;
+        for (std::size_t i = 0; i < total; ++i) {
+            send_queue.push(acquire());
+            send_queue.pop(node);
+            sending[i % in_flight] = std::move(node);
+        }
+        };
+
+    send(in_flight * 2);
+
+    auto alloc_begin = g_alloc_count.load();
+    auto time_begin = std::chrono::steady_clock::now();
+    send(count);
+    auto time_end = std::chrono::steady_clock::now();
+    auto allocs = g_alloc_count.load() - alloc_begin;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time_end - time_begin).count();
+    return { static_cast<double>(allocs) / count, static_cast<double>(ns) / count };
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::size_t in_flight = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+    if (count == 0 || in_flight == 0 || in_flight > LOGIC_NODE_POOL_SIZE / 2) {
+        std::cout << "usage: msgalloc_bench [count] [in_flight <= " << LOGIC_NODE_POOL_SIZE / 2 << "]" << std::endl;
+        return 1;
+    }
+
+    //MsgNode析构和逻辑线程处理消息时会打印日志，测试期间关闭标准输出
+    std::cout.setstate(std::ios::failbit);
+    auto recv_baseline = runRecv(count, in_flight, []() {
+        return std::make_shared<LogicNode>(nullptr, std::make_shared<RecvNode>(MAX_LENGTH, BENCH_MSG_ID));
+        });
+    auto recv_pooled = runRecv(count, in_flight, []() {
+        return LogicNodePool::local().acquire(BENCH_MSG_ID);
+        });
+    auto send_baseline = runSend(count, in_flight, []() {
+        return std::make_shared<SendNode>(BODY, BODY_LEN, BENCH_MSG_ID);
+        });
+    auto send_pooled = runSend(count, in_flight, []() {
+        return SendNodePool::local().acquire(BODY, BODY_LEN, BENCH_MSG_ID);
+        });
+    std::cout.clear();
+
+    std::cout << count << " msgs, " << in_flight << " in flight" << std::endl;
+    std::cout << "recv make_shared: allocs/msg " << recv_baseline.allocs_per_msg << ", ns/msg " << recv_baseline.ns_per_msg << std::endl;
+    std::cout << "recv pool:        allocs/msg " << recv_pooled.allocs_per_msg << ", ns/msg " << recv_pooled.ns_per_msg << std::endl;
+    std::cout << "send make_shared: allocs/msg " << send_baseline.allocs_per_msg << ", ns/msg " << send_baseline.ns_per_msg << std::endl;
+    std::cout << "send pool:        allocs/msg " << send_pooled.allocs_per_msg << ", ns/msg " << send_pooled.ns_per_msg << std::endl;
+    //退出时池中节点析构的日志同样不输出
+    std::cout.setstate(std::ios::failbit);
+    return 0;
+}
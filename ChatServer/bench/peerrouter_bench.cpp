@@ -0,0 +1,192 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include "chatgrpcclient.h"
+#include "redismgr.h"
+#include "const.h"
+
+/******************************************************************************
+ * @file       peerrouter_bench.cpp
+ * @brief      跨服务器通知的转发吞吐测试：逐条grpc和redis发布订阅成批转发对比
+ *             grpc：向对端ChatServer逐条调用NotifyTextChatMsg，统计到收到全部回复为止的每秒通知数
+ *             pubsub：按批大小打包成PeerNotifyBatch，PUBLISH到本程序订阅的频道，
+ *                     统计到订阅端解析出全部通知为止的每秒通知数
+ *             touid应为不在对端在线的用户，对端只做查找，不会推送给客户端
+ *
+ *             编译：与ChatServer除main.cpp外的源文件一起编译链接，依赖同ChatServer，例如
+ *             g++ -std=c++20 -O2 -I.. peerrouter_bench.cpp <ChatServer其余源文件> <ChatServer链接库>
+ *             运行：在放有config.ini的目录下执行，对端名字为[PeerServer]中配置的Name
+ *             peerrouter_bench <对端服务器名> <touid> [通知数] [grpc在途上限]
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 等待count个完成事件
+class Latch {
+public:
+    explicit Latch(std::size_t count) : count_(count) {
+    }
+    void countDown(std::size_t n = 1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        count_ = count_ > n ? count_ - n : 0;
+        if (count_ == 0) {
+            cond_.notify_all();
+        }
+    }
+    bool wait(std::chrono::seconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cond_.wait_for(lock, timeout, [this]() {
+            return count_ == 0;
+            });
+    }
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::size_t count_;
+};
+
+static message::TextChatMsgReq makeReq(int touid, std::size_t i) {
+    message::TextChatMsgReq req;
+    req.set_fromuid(0);
+    req.set_touid(touid);
+    req.set_thread_id(0);
+    auto* text = req.add_textmsgs();
+    text->set_unique_id("bench_" + std::to_string(i));
+    text->set_msg_id(static_cast<int>(i));
+    text->set_msgcontent("bench message " + std::to_string(i));
+    text->set_chat_time("2026-10-17 00:00:00");
+    return req;
+}
+
+// 逐条grpc，在途调用数不超过window，返回每秒通知数，失败返回负数
+static double runGrpc(const std::string& server, int touid, std::size_t total, std::size_t window) {
+    auto client = ChatGrpcClient::getInstance();
+    std::counting_semaphore<> slots(static_cast<std::ptrdiff_t>(window));
+    std::atomic<std::size_t> failed{ 0 };
+    Latch done(total);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < total; ++i) {
+        slots.acquire();
+        client->notifyTextChatMsg(server, makeReq(touid, i), [&](const message::TextChatMsgRsp& rsp) {
+            if (rsp.error() != ErrorCodes::Success) {
+                failed.fetch_add(1);
+            }
+            slots.release();
+            done.countDown();
+            });
+    }
+    if (!done.wait(std::chrono::seconds(120)) || failed.load() > 0) {
+        std::cout << "grpc failed " << failed.load() << " of " << total << std::endl;
+        return -1;
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return total / seconds;
+}
+
+// 发布订阅，每批batch_size条，订阅端收齐后结束，返回每秒通知数，失败返回负数
+static double runPubSub(const std::string& channel, int touid, std::size_t total, std::size_t batch_size, Latch& done) {
+    auto client = RedisMgr::getInstance()->asyncClient();
+    //订阅端可能先于PUBLISH的回复收齐，计数器由回调共同持有
+    auto failed = std::make_shared<std::atomic<std::size_t>>(0);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (std::size_t sent = 0; sent < total;) {
+        message::PeerNotifyBatch batch;
+        batch.set_from_server("bench");
+        for (std::size_t i = 0; i < batch_size && sent < total; ++i, ++sent) {
+            *batch.add_notifies()->mutable_text_chat_msg() = makeReq(touid, sent);
+        }
+        RedisCommand command{ "PUBLISH", channel, batch.SerializeAsString() };
+        client->asyncCommand(std::move(command), [failed](boost::system::error_code ec, RedisResult result) {
+            if (ec || result.type != REDIS_REPLY_INTEGER || result.integer == 0) {
+                failed->fetch_add(1);
+            }
+            });
+    }
+    if (!done.wait(std::chrono::seconds(120)) || failed->load() > 0) {
+        std::cout << "pubsub failed, publish errors " << failed->load() << std::endl;
+        return -1;
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return total / seconds;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: peerrouter_bench <peer server name> <touid> [count] [grpc window]" << std::endl;
+        return 1;
+    }
+    std::string server = argv[1];
+    int touid = atoi(argv[2]);
+    std::size_t total = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 20000;
+    std::size_t window = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 256;
+    if (total == 0 || window == 0) {
+        std::cout << "count and grpc window must be positive" << std::endl;
+        return 1;
+    }
+
+    auto grpc_rate = runGrpc(server, touid, total, window);
+    if (grpc_rate < 0) {
+        return 1;
+    }
+    std::cout << "grpc unary   window " << window << "  notifies/sec " << grpc_rate << std::endl;
+
+    //订阅端解析批次并计数，当前轮次的计数器由latch指向
+    auto channel = "peer_bench_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    std::mutex latch_mutex;
+    Latch* latch = nullptr;
+    RedisMgr::getInstance()->subscribe({ channel }, {}, [&](const std::string&, const std::string& data) {
+        message::PeerNotifyBatch batch;
+        if (!batch.ParseFromString(data)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(latch_mutex);
+        if (latch) {
+            latch->countDown(static_cast<std::size_t>(batch.notifies_size()));
+        }
+        });
+
+    //等待订阅生效，PUBLISH返回的订阅者数量大于0
+    auto sync_client = RedisMgr::getInstance();
+    bool subscribed = false;
+    for (int i = 0; i < 50 && !subscribed; ++i) {
+        std::vector<RedisCommand> commands{ { "PUBLISH", channel, "" } };
+        std::vector<RedisResult> results;
+        subscribed = sync_client->pipeline(commands, results) && !results.empty()
+            && results[0].type == REDIS_REPLY_INTEGER && results[0].integer > 0;
+        if (!subscribed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    if (!subscribed) {
+        std::cout << "subscribe " << channel << " failed" << std::endl;
+        return 1;
+    }
+
+    for (std::size_t batch_size : { 1, 8, 32, 64, 128 }) {
+        Latch done(total);
+        {
+            std::lock_guard<std::mutex> lock(latch_mutex);
+            latch = &done;
+        }
+        auto rate = runPubSub(channel, touid, total, batch_size, done);
+        {
+            std::lock_guard<std::mutex> lock(latch_mutex);
+            latch = nullptr;
+        }
+        if (rate < 0) {
+            return 1;
+        }
+        std::cout << "pubsub batch " << batch_size << "  notifies/sec " << rate << std::endl;
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 ﻿#include "chatgrpcclient.h"
+#include "../Common/jsonutil.h"
 
 /******************************************************************************
  * @file       chatgrpcclient.cpp
@@ -18,6 +19,7 @@
 #include <json/reader.h>
 #include "csession.h"
 #include "mysqlmgr.h"
+#include "usercache.h"
 
 ChatGrpcClient::ChatGrpcClient() {
 	auto& cfg = ConfigMgr::getInst();
@@ -44,18 +46,11 @@ ChatGrpcClient::ChatGrpcClient() {
 }
 
 // 通知添加好友
-AddFriendRsp ChatGrpcClient::notifyAddFriend(std::string server_ip, const AddFriendReq& req) {
+void ChatGrpcClient::notifyAddFriend(std::string server_ip, const AddFriendReq& req, RpcCallback<AddFriendRsp> callback) {
 	AddFriendRsp rsp;
-	Defer defer([&rsp, &req]() {
-		rsp.set_error(ErrorCodes::Success);
-		rsp.set_applyuid(req.applyuid());
-		rsp.set_touid(req.touid());
-		});
-
-	auto find_iter = pools_.find(server_ip);
-	if (find_iter == pools_.end()) {
-		return rsp;
-	}
+	rsp.set_error(ErrorCodes::Success);
+	rsp.set_applyuid(req.applyuid());
+	rsp.set_touid(req.touid());
 
 	auto& cfg = ConfigMgr::getInst();
 	auto self_name = cfg["SelfServer"]["Name"];
@@ -70,38 +65,35 @@ AddFriendRsp ChatGrpcClient::notifyAddFriend(std::string server_ip, const AddFri
 			rtvalue["applyuid"] = req.applyuid();
 			rtvalue["name"] = req.name();
 			rtvalue["desc"] = req.desc();
-			std::string return_str = rtvalue.toStyledString();
+			std::string return_str = toJsonString(rtvalue);
 			session->send(return_str, ID_NOTIFY_ADD_FRIEND_REQ);
 		}
 
-		return rsp;
-	}
-
-	auto& pool = find_iter->second;
-	ClientContext context;
-	auto stub = pool->getConnection();
-	Status status = stub->NotifyAddFriend(&context, req, &rsp);
-	Defer defercon([&stub, this, &pool]() {
-		pool->returnConnection(std::move(stub));
-		});
-
-	if (!status.ok()) {
-		rsp.set_error(ErrorCodes::RPCFailed);
-		return rsp;
+		if (callback) {
+			callback(rsp);
+		}
+		return;
 	}
 
-	return rsp;
+	asyncCall(server_ip, req, std::move(rsp),
+		[](auto* async, ClientContext* context, const AddFriendReq* request, AddFriendRsp* response, auto done) {
+			async->NotifyAddFriend(context, request, response, std::move(done));
+		}, std::move(callback));
 }
 
 // 获取用户基础信息
 bool ChatGrpcClient::getBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo) {
-	//优先查redis中查询用户信息
+	//优先查进程内缓存
+	if (UserCache::getInstance()->get(uid, *userinfo)) {
+		return true;
+	}
+
+	//再查redis中查询用户信息
 	std::string info_str = "";
 	bool b_base = RedisMgr::getInstance()->get(base_key, info_str);
 	if (b_base) {
-		Json::Reader reader;
 		Json::Value root;
-		reader.parse(info_str, root);
+		parseJson(info_str, root);
 		userinfo->uid = root["uid"].asInt();
 		userinfo->name = root["name"].asString();
 		userinfo->pwd = root["pwd"].asString();
@@ -112,6 +104,7 @@ bool ChatGrpcClient::getBaseInfo(std::string base_key, int uid, std::shared_ptr<
 		userinfo->icon = root["icon"].asString();
 		std::cout << "user login uid is  " << userinfo->uid << " name  is "
 			<< userinfo->name << " pwd is " << userinfo->pwd << " email is " << userinfo->email << std::endl;
+		UserCache::getInstance()->put(*userinfo);
 	}
 	else {
 		//redis中没有则查询mysql
@@ -134,24 +127,19 @@ bool ChatGrpcClient::getBaseInfo(std::string base_key, int uid, std::shared_ptr<
 		redis_root["desc"] = userinfo->desc;
 		redis_root["sex"] = userinfo->sex;
 		redis_root["icon"] = userinfo->icon;
-		RedisMgr::getInstance()->set(base_key, redis_root.toStyledString());
+		UserCache::getInstance()->noteLocalWrite(base_key);
+		RedisMgr::getInstance()->set(base_key, toJsonString(redis_root));
+		UserCache::getInstance()->put(*userinfo);
 	}
-
+	return true;
 }
 
 // 通知好友申请已通过
-AuthFriendRsp ChatGrpcClient::notifyAuthFriend(std::string server_ip, const AuthFriendReq& req) {
+void ChatGrpcClient::notifyAuthFriend(std::string server_ip, const AuthFriendReq& req, RpcCallback<AuthFriendRsp> callback) {
 	AuthFriendRsp rsp;
-	Defer defer([&rsp, &req]() {
-		rsp.set_error(ErrorCodes::Success);
-		rsp.set_fromuid(req.fromuid());
-		rsp.set_touid(req.touid());
-		});
-
-	auto find_iter = pools_.find(server_ip);
-	if (find_iter == pools_.end()) {
-		return rsp;
-	}
+	rsp.set_error(ErrorCodes::Success);
+	rsp.set_fromuid(req.fromuid());
+	rsp.set_touid(req.touid());
 
 	auto& cfg = ConfigMgr::getInst();
 	auto self_name = cfg["SelfServer"]["Name"];
@@ -178,94 +166,54 @@ AuthFriendRsp ChatGrpcClient::notifyAuthFriend(std::string server_ip, const Auth
 			}
 
 
-			std::string return_str = rtvalue.toStyledString();
+			std::string return_str = toJsonString(rtvalue);
 			session->send(return_str, ID_NOTIFY_AUTH_FRIEND_REQ);
 		}
 
-		return rsp;
-	}
-
-	auto& pool = find_iter->second;
-	ClientContext context;
-	auto stub = pool->getConnection();
-	Status status = stub->NotifyAuthFriend(&context, req, &rsp);
-	Defer defercon([&stub, this, &pool]() {
-		pool->returnConnection(std::move(stub));
-		});
-
-	if (!status.ok()) {
-		rsp.set_error(ErrorCodes::RPCFailed);
-		return rsp;
+		if (callback) {
+			callback(rsp);
+		}
+		return;
 	}
 
-	return rsp;
+	asyncCall(server_ip, req, std::move(rsp),
+		[](auto* async, ClientContext* context, const AuthFriendReq* request, AuthFriendRsp* response, auto done) {
+			async->NotifyAuthFriend(context, request, response, std::move(done));
+		}, std::move(callback));
 }
 
 // 通知有文字信息
-TextChatMsgRsp ChatGrpcClient::notifyTextChatMsg(std::string server_name,
-	const TextChatMsgReq& req, const Json::Value& rtvalue) {
+void ChatGrpcClient::notifyTextChatMsg(std::string server_name,
+	const TextChatMsgReq& req, RpcCallback<TextChatMsgRsp> callback) {
 
 	TextChatMsgRsp rsp;
 	rsp.set_error(ErrorCodes::Success);
-
-	Defer defer([&rsp, &req]() {
-		rsp.set_fromuid(req.fromuid());
-		rsp.set_touid(req.touid());
-		for (const auto& text_data : req.textmsgs()) {
-			TextChatData* new_msg = rsp.add_textmsgs();
-			new_msg->set_msg_id(text_data.msg_id());
-			new_msg->set_msgcontent(text_data.msgcontent());
-		}
-
-		});
-
-	auto find_iter = pools_.find(server_name);
-	if (find_iter == pools_.end()) {
-		std::cout << "Error: ChatGrpcClient could not find pool for server: " << server_name << std::endl;
-		return rsp;
-	}
-
-	auto& pool = find_iter->second;
-	ClientContext context;
-	auto stub = pool->getConnection();
-	Status status = stub->NotifyTextChatMsg(&context, req, &rsp);
-	Defer defercon([&stub, this, &pool]() {
-		pool->returnConnection(std::move(stub));
-		});
-
-	if (!status.ok()) {
-		rsp.set_error(ErrorCodes::RPCFailed);
-		return rsp;
-	}
-
-	return rsp;
+	rsp.set_fromuid(req.fromuid());
+	rsp.set_touid(req.touid());
+	rsp.set_thread_id(req.thread_id());
+
+	asyncCall(server_name, req, std::move(rsp),
+		[](auto* async, ClientContext* context, const TextChatMsgReq* request, TextChatMsgRsp* response, auto done) {
+			async->NotifyTextChatMsg(context, request, response, std::move(done));
+		}, std::move(callback));
 }
 
 // 通知踢掉客户端
-KickUserRsp ChatGrpcClient::notifyKickUser(std::string server_ip, const KickUserReq& req) {
+void ChatGrpcClient::notifyKickUser(std::string server_ip, const KickUserReq& req, RpcCallback<KickUserRsp> callback) {
 	KickUserRsp rsp;
-	Defer defer([&rsp, &req]() {
-		rsp.set_error(ErrorCodes::Success);
-		rsp.set_uid(req.uid());
-		});
+	rsp.set_error(ErrorCodes::Success);
+	rsp.set_uid(req.uid());
 
+	asyncCall(server_ip, req, std::move(rsp),
+		[](auto* async, ClientContext* context, const KickUserReq* request, KickUserRsp* response, auto done) {
+			async->NotifyKickUser(context, request, response, std::move(done));
+		}, std::move(callback));
+}
+
+ChatService::Stub* ChatGrpcClient::getStub(const std::string& server_ip) {
 	auto find_iter = pools_.find(server_ip);
 	if (find_iter == pools_.end()) {
-		return rsp;
+		return nullptr;
 	}
-
-	auto& pool = find_iter->second;
-	ClientContext context;
-	auto stub = pool->getConnection();
-	Defer defercon([&stub, this, &pool]() {
-		pool->returnConnection(std::move(stub));
-		});
-	Status status = stub->NotifyKickUser(&context, req, &rsp);
-
-	if (!status.ok()) {
-		rsp.set_error(ErrorCodes::RPCFailed);
-		return rsp;
-	}
-
-	return rsp;
-}
\ No newline at end of file
+	return find_iter->second->getConnection();
+}
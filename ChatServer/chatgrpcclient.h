@@ -5,13 +5,16 @@
 #include <grpcpp/grpcpp.h> 
 #include "message.grpc.pb.h"
 #include "message.pb.h"
-#include <queue>
+#include <vector>
+#include <atomic>
+#include <functional>
 #include "const.h"
 #include "data.h"
 
 /******************************************************************************
  * @file       chatgrpcclient.h
  * @brief      grpc客户端类，用于chatserver之间的通信
+ *             使用回调接口，调用立即返回，结果在grpc的回调线程中通知
  *
  * @author     lueying
  * @date       2026/1/29
@@ -40,56 +43,34 @@ using message::ChatService;
 using message::KickUserReq;
 using message::KickUserRsp;
 
+// 回调接口的调用不独占stub，多个channel轮流使用即可，不需要归还
 class ChatConPool {
 public:
 	ChatConPool(size_t poolSize, std::string host, std::string port)
-		: poolSize_(poolSize), host_(host), port_(port), b_stop_(false) {
+		: poolSize_(poolSize), host_(host), port_(port), b_stop_(false), next_(0) {
 		for (size_t i = 0; i < poolSize_; ++i) {
 
 			std::shared_ptr<Channel> channel = grpc::CreateChannel(host + ":" + port,
 				grpc::InsecureChannelCredentials());
 
-			connections_.push(ChatService::NewStub(channel));
+			connections_.push_back(ChatService::NewStub(channel));
 		}
 	}
 
 	~ChatConPool() {
-		std::lock_guard<std::mutex> lock(mutex_);
 		Close();
-		while (!connections_.empty()) {
-			connections_.pop();
-		}
 	}
 
-	std::unique_ptr<ChatService::Stub> getConnection() {
-		std::unique_lock<std::mutex> lock(mutex_);
-		cond_.wait(lock, [this] {
-			if (b_stop_) {
-				return true;
-			}
-			return !connections_.empty();
-			});
-		// 如果停止则直接返回空指针
-		if (b_stop_) {
+	// 如果停止则返回空指针
+	ChatService::Stub* getConnection() {
+		if (b_stop_ || connections_.empty()) {
 			return nullptr;
 		}
-		auto context = std::move(connections_.front());
-		connections_.pop();
-		return context;
-	}
-
-	void returnConnection(std::unique_ptr<ChatService::Stub> context) {
-		std::lock_guard<std::mutex> lock(mutex_);
-		if (b_stop_) {
-			return;
-		}
-		connections_.push(std::move(context));
-		cond_.notify_one();
+		return connections_[next_++ % connections_.size()].get();
 	}
 
 	void Close() {
 		b_stop_ = true;
-		cond_.notify_all();
 	}
 
 private:
@@ -97,11 +78,14 @@ private:
 	size_t poolSize_;
 	std::string host_;
 	std::string port_;
-	std::queue<std::unique_ptr<ChatService::Stub> > connections_;
-	std::mutex mutex_;
-	std::condition_variable cond_;
+	std::vector<std::unique_ptr<ChatService::Stub>> connections_;
+	std::atomic<size_t> next_;
 };
 
+// 异步调用完成的回调，在grpc的回调线程中执行，不要在其中阻塞
+template <typename Rsp>
+using RpcCallback = std::function<void(const Rsp&)>;
+
 class ChatGrpcClient :public Singleton<ChatGrpcClient>
 {
 	friend class Singleton<ChatGrpcClient>;
@@ -110,21 +94,64 @@ public:
 
 	}
 	// 通知添加好友
-	AddFriendRsp notifyAddFriend(std::string server_ip, const AddFriendReq& req);
+	void notifyAddFriend(std::string server_ip, const AddFriendReq& req, RpcCallback<AddFriendRsp> callback = nullptr);
 	// 通知好友申请已通过
-	AuthFriendRsp notifyAuthFriend(std::string server_ip, const AuthFriendReq& req);
+	void notifyAuthFriend(std::string server_ip, const AuthFriendReq& req, RpcCallback<AuthFriendRsp> callback = nullptr);
 	// 获取用户基础信息
 	bool getBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo);
 	// 通知有聊天消息
-	TextChatMsgRsp notifyTextChatMsg(std::string server_ip, const TextChatMsgReq& req, const Json::Value& rtvalue);
+	void notifyTextChatMsg(std::string server_ip, const TextChatMsgReq& req, RpcCallback<TextChatMsgRsp> callback = nullptr);
 	// 通知踢掉客户端
-	KickUserRsp notifyKickUser(std::string server_ip, const KickUserReq& req);
+	void notifyKickUser(std::string server_ip, const KickUserReq& req, RpcCallback<KickUserRsp> callback = nullptr);
+	// 获取到server的stub，用于建立PeerLink流，没有配置该服务器返回空指针
+	ChatService::Stub* getStub(const std::string& server_ip);
 private:
 	ChatGrpcClient();
-	std::unordered_map<std::string, std::unique_ptr<ChatConPool>> pools_;
-};
-
 
+	// 一次异步调用的上下文，需要保持到调用完成
+	template <typename Req, typename Rsp>
+	struct AsyncCall {
+		ClientContext context;
+		Req req;
+		Rsp rsp;
+	};
+
+	// 向server发起一次异步调用，start负责在stub上发起具体的rpc，rsp为预先填好的默认回包
+	template <typename Req, typename Rsp, typename Start>
+	void asyncCall(const std::string& server_ip, const Req& req, Rsp rsp, Start start, RpcCallback<Rsp> callback) {
+		auto find_iter = pools_.find(server_ip);
+		if (find_iter == pools_.end()) {
+			std::cout << "Error: ChatGrpcClient could not find pool for server: " << server_ip << std::endl;
+			if (callback) {
+				callback(rsp);
+			}
+			return;
+		}
 
+		auto stub = find_iter->second->getConnection();
+		if (stub == nullptr) {
+			rsp.set_error(ErrorCodes::RPCFailed);
+			if (callback) {
+				callback(rsp);
+			}
+			return;
+		}
 
+		auto call = std::make_shared<AsyncCall<Req, Rsp>>();
+		call->req = req;
+		call->rsp = std::move(rsp);
+		call->context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(CHAT_RPC_TIME_OUT));
+		start(stub->async(), &call->context, &call->req, &call->rsp,
+			[call, callback = std::move(callback)](Status status) {
+				if (!status.ok()) {
+					std::cout << "chat rpc failed, error is " << status.error_message() << std::endl;
+					call->rsp.set_error(ErrorCodes::RPCFailed);
+				}
+				if (callback) {
+					callback(call->rsp);
+				}
+			});
+	}
 
+	std::unordered_map<std::string, std::unique_ptr<ChatConPool>> pools_;
+};
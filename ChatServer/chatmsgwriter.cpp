@@ -0,0 +1,485 @@
+﻿#include "chatmsgwriter.h"
+#include <set>
+#include <algorithm>
+#include "configmgr.h"
+#include "mysqlmgr.h"
+#include "msgidallocator.h"
+#include "threadmsgcache.h"
+#include "redismgr.h"
+#include "const.h"
+#include "../Common/jsonutil.h"
+
+/******************************************************************************
+ * @file       chatmsgwriter.cpp
+ * @brief      聊天消息写后持久化实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 日志段文件名为msg_<序号>.log
+static const std::string SEGMENT_PREFIX = "msg_";
+static const std::string SEGMENT_SUFFIX = ".log";
+// 无法落库的消息追加到死信日志，重启时不重放，由人工处理
+static const std::string DEAD_LETTER_FILE = "dead_letter.log";
+
+// 读取正整数配置，未配置时使用默认值
+static std::size_t msgWriterConfig(const std::string& key, std::size_t default_value) {
+    auto value_str = ConfigMgr::getInst()["MsgWriter"][key];
+    long long value = value_str.empty() ? 0 : atoll(value_str.c_str());
+    return value > 0 ? static_cast<std::size_t>(value) : default_value;
+}
+
+ChatMsgWriter::ChatMsgWriter() : enabled_(ConfigMgr::getInst()["MsgWriter"]["Enabled"] == "true"),
+    max_batch_(msgWriterConfig("MaxBatch", 500)), max_queue_(msgWriterConfig("MaxQueue", 100000)),
+    segment_bytes_(msgWriterConfig("SegmentBytes", 16 * 1024 * 1024)),
+    b_stop_(false), active_seq_(0), active_bytes_(0) {
+    auto dir = ConfigMgr::getInst()["MsgWriter"]["JournalDir"];
+    dir_ = dir.empty() ? boost::filesystem::path("msg_journal") : boost::filesystem::path(dir);
+}
+
+ChatMsgWriter::~ChatMsgWriter() {
+    stop();
+}
+
+bool ChatMsgWriter::enabled() const {
+    return enabled_;
+}
+
+bool ChatMsgWriter::start() {
+    if (!enabled_) {
+        return true;
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(dir_, ec);
+    if (ec) {
+        std::cout << "create msg journal dir " << dir_ << " failed, error is " << ec.message() << std::endl;
+        return false;
+    }
+
+    //分配器从数据库和日志中最大的id之后开始，避免重复
+    auto max_db_id = MysqlMgr::getInstance()->getMaxChatMsgId();
+    if (max_db_id < 0) {
+        return false;
+    }
+    auto max_journal_id = replay();
+    MsgIdAllocator::getInstance()->init(std::max<int64_t>(max_db_id, max_journal_id));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        //重放的消息重新登记为未落库，翻页不会越过它们
+        std::vector<int64_t> allocs;
+        for (auto& [alloc, count] : alloc_pending_) {
+            allocs.push_back(alloc);
+        }
+        if (!MsgIdAllocator::getInstance()->restore(allocs)) {
+            return false;
+        }
+        if (!openSegment(active_seq_ + 1)) {
+            return false;
+        }
+    }
+    thread_ = std::thread([this]() {
+        run();
+        });
+    return true;
+}
+
+void ChatMsgWriter::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        b_stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+
+    //全部落库后当前段也不再需要
+    std::lock_guard<std::mutex> lock(mutex_);
+    journal_.close();
+    if (segment_pending_[active_seq_] == 0) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(segmentPath(active_seq_), ec);
+    }
+}
+
+bool ChatMsgWriter::append(std::vector<std::shared_ptr<ChatMessage>>& chat_datas) {
+    if (chat_datas.empty()) {
+        return true;
+    }
+    //mysql长时间不可用时队列不再无限增长，新消息直接保存失败
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= max_queue_) {
+            std::cout << "msg writer queue is full, size is " << queue_.size() << std::endl;
+            return false;
+        }
+    }
+    //一批消息用一次redis往返领取连续的id，不占用写日志的锁
+    auto first_id = MsgIdAllocator::getInstance()->allocate(static_cast<int>(chat_datas.size()));
+    if (first_id == 0) {
+        return false;
+    }
+    //allocate已保证整批id都在int范围内
+    for (std::size_t i = 0; i < chat_datas.size(); ++i) {
+        chat_datas[i]->message_id = static_cast<int>(first_id + static_cast<int64_t>(i));
+    }
+
+    std::string lines;
+    for (auto& msg : chat_datas) {
+        lines += encode(*msg);
+        lines += '\n';
+    }
+
+    bool b_written = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        b_written = writeJournal(lines);
+        if (b_written) {
+            for (auto& msg : chat_datas) {
+                addPending(msg, active_seq_, first_id);
+            }
+        }
+    }
+    if (!b_written) {
+        //这批id不会落库，撤销登记，否则翻页会一直停在这里直到登记过期
+        MsgIdAllocator::getInstance()->release({ first_id });
+        return false;
+    }
+    cond_.notify_one();
+    return true;
+}
+
+bool ChatMsgWriter::hasPending(int thread_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return thread_pending_.count(thread_id) > 0;
+}
+
+// 写库期间到达的消息在下一次一起提交，负载越高每批越大
+void ChatMsgWriter::run() {
+    auto allocator = MsgIdAllocator::getInstance();
+    auto refresh_interval = std::chrono::seconds(std::max(1, allocator->pendingTTL() / 3));
+    auto next_refresh = std::chrono::steady_clock::now() + refresh_interval;
+    for (;;) {
+        std::vector<Entry> batch;
+        std::vector<int64_t> released;
+        std::vector<std::shared_ptr<ChatMessage>> uploaded;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_until(lock, next_refresh, [this]() {
+                return b_stop_ || !queue_.empty();
+                });
+            if (queue_.empty() && b_stop_) {
+                return;
+            }
+            auto count = std::min(max_batch_, queue_.size());
+            batch.assign(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.begin() + count));
+            queue_.erase(queue_.begin(), queue_.begin() + count);
+            released.swap(unreleased_);
+            uploaded.swap(unapplied_);
+        }
+
+        //空闲时也按时续期本服务器的未落库登记
+        if (std::chrono::steady_clock::now() >= next_refresh) {
+            allocator->keepAlive();
+            next_refresh = std::chrono::steady_clock::now() + refresh_interval;
+        }
+        if (batch.empty()) {
+            bool b_applied = uploaded.empty() || applyUploaded(uploaded);
+            if (!b_applied || !allocator->release(released)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!b_applied) {
+                    unapplied_.insert(unapplied_.end(), uploaded.begin(), uploaded.end());
+                }
+                unreleased_.insert(unreleased_.end(), released.begin(), released.end());
+            }
+            continue;
+        }
+
+        std::vector<std::shared_ptr<ChatMessage>> msgs;
+        msgs.reserve(batch.size());
+        for (auto& entry : batch) {
+            msgs.push_back(entry.msg);
+        }
+
+        std::vector<Entry> retry;
+        std::vector<std::shared_ptr<ChatMessage>> dead;
+        bool b_transient = false;
+        if (!MysqlMgr::getInstance()->insertChatMsgs(msgs, b_transient)) {
+            if (b_transient) {
+                retry.swap(batch);
+            }
+            else {
+                //数据错误时逐条插入，找出坏消息转入死信日志后放弃，其余照常落库，
+                //一条坏消息不会一直占住登记，挡住整个集群的翻页
+                isolateBadRows(batch, retry, dead);
+            }
+            msgs.clear();
+            for (auto& entry : batch) {
+                if (std::find(dead.begin(), dead.end(), entry.msg) == dead.end()) {
+                    msgs.push_back(entry.msg);
+                }
+            }
+        }
+
+        if (!retry.empty()) {
+            //连接不可用，放回队首，稍后重试
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_.insert(queue_.begin(), std::make_move_iterator(retry.begin()), std::make_move_iterator(retry.end()));
+            unreleased_.insert(unreleased_.end(), released.begin(), released.end());
+            unapplied_.insert(unapplied_.end(), uploaded.begin(), uploaded.end());
+            released.clear();
+            uploaded.clear();
+            //逐条插入时已有部分消息落库，先完成它们的收尾，下一轮再重试剩余的
+            if (batch.empty()) {
+                if (b_stop_) {
+                    return;
+                }
+                cond_.wait_for(lock, std::chrono::seconds(1), [this]() {
+                    return b_stop_;
+                    });
+                continue;
+            }
+        }
+        if (!dead.empty()) {
+            //放弃的消息已追加到缓存，从缓存中删除，避免翻页读到不存在的消息
+            ThreadMsgCache::getInstance()->remove(dead);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& entry : batch) {
+                --segment_pending_[entry.segment];
+                auto iter = thread_pending_.find(entry.msg->thread_id);
+                if (iter != thread_pending_.end() && --iter->second == 0) {
+                    thread_pending_.erase(iter);
+                }
+                auto alloc_iter = alloc_pending_.find(entry.alloc);
+                if (alloc_iter != alloc_pending_.end() && --alloc_iter->second == 0) {
+                    released.push_back(entry.alloc);
+                    alloc_pending_.erase(alloc_iter);
+                }
+            }
+            releaseSegments();
+        }
+
+        //落库后补写缓存中缺少的消息：未落库期间缓存被删除或过期时，
+        //其他服务器从mysql重建的窗口会缺少这些消息；已有的成员不覆盖，
+        //它们可能已按mysql中更新后的状态重建，整批只用一次redis往返
+        ThreadMsgCache::getInstance()->repair(msgs);
+
+        //ResourceServer在消息落库前完成上传时只能留下标记，落库后由这里补上状态，
+        //放在缓存补写之后，撤销的窗口重建时以mysql中的新状态为准
+        for (auto& msg : msgs) {
+            if (msg->status == MsgStatus::UN_UPLOAD) {
+                uploaded.push_back(msg);
+            }
+        }
+        bool b_applied = uploaded.empty() || applyUploaded(uploaded);
+
+        //缓存补写之后再撤销登记，水位线越过的消息在mysql和缓存窗口中都已存在；
+        //上传状态没补上时暂不撤销，翻页停在这些消息之前，下一轮重试
+        if (!b_applied || !allocator->release(released)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!b_applied) {
+                unapplied_.insert(unapplied_.end(), uploaded.begin(), uploaded.end());
+            }
+            unreleased_.insert(unreleased_.end(), released.begin(), released.end());
+        }
+    }
+}
+
+bool ChatMsgWriter::openSegment(uint64_t seq) {
+    journal_.close();
+    journal_.clear();
+    journal_.open(segmentPath(seq).string(), std::ios::binary | std::ios::app);
+    if (!journal_) {
+        std::cout << "open msg journal " << segmentPath(seq) << " failed" << std::endl;
+        return false;
+    }
+    active_seq_ = seq;
+    active_bytes_ = 0;
+    segment_pending_[seq] += 0;
+    releaseSegments();
+    return true;
+}
+
+// 逐条插入批中的消息：成功的留在batch中；数据错误的写入死信日志，也留在batch中按已处理计，并记入dead；
+// 中途遇到连接错误时，该条及之后的消息移入retry
+void ChatMsgWriter::isolateBadRows(std::vector<Entry>& batch, std::vector<Entry>& retry,
+    std::vector<std::shared_ptr<ChatMessage>>& dead) {
+    std::vector<Entry> done;
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        bool b_transient = false;
+        if (MysqlMgr::getInstance()->insertChatMsgs({ batch[i].msg }, b_transient)) {
+            done.push_back(std::move(batch[i]));
+            continue;
+        }
+        if (b_transient) {
+            retry.assign(std::make_move_iterator(batch.begin() + i), std::make_move_iterator(batch.end()));
+            break;
+        }
+        std::cout << "chat msg " << batch[i].msg->message_id << " can not be saved, move to dead letter journal" << std::endl;
+        std::ofstream out((dir_ / DEAD_LETTER_FILE).string(), std::ios::binary | std::ios::app);
+        out << encode(*batch[i].msg) << '\n';
+        dead.push_back(batch[i].msg);
+        done.push_back(std::move(batch[i]));
+    }
+    batch.swap(done);
+}
+
+// 写入操作系统即返回，可以应对进程崩溃，不等待刷盘
+bool ChatMsgWriter::writeJournal(const std::string& lines) {
+    if (active_bytes_ >= segment_bytes_ && !openSegment(active_seq_ + 1)) {
+        return false;
+    }
+    journal_.write(lines.data(), lines.size());
+    journal_.flush();
+    if (!journal_) {
+        std::cout << "write msg journal failed" << std::endl;
+        return false;
+    }
+    active_bytes_ += lines.size();
+    return true;
+}
+
+void ChatMsgWriter::addPending(const std::shared_ptr<ChatMessage>& msg, uint64_t segment, int64_t alloc) {
+    ++segment_pending_[segment];
+    ++thread_pending_[msg->thread_id];
+    ++alloc_pending_[alloc];
+    queue_.push_back({ msg, segment, alloc });
+}
+
+// ResourceServer更新状态没有命中行时先写标记再重试一次更新，
+// 这里在提交之后读取标记，两边至少有一方会看到对方的结果
+bool ChatMsgWriter::applyUploaded(const std::vector<std::shared_ptr<ChatMessage>>& msgs) {
+    std::vector<RedisCommand> commands;
+    for (auto& msg : msgs) {
+        commands.push_back({ "GET", CHAT_MSG_UPLOADED_PREFIX + std::to_string(msg->message_id) });
+    }
+    std::vector<RedisResult> results;
+    if (!RedisMgr::getInstance()->pipeline(commands, results) || results.size() != msgs.size()) {
+        return false;
+    }
+
+    std::vector<int> message_ids;
+    std::set<int> thread_ids;
+    RedisCommand del_command{ "DEL" };
+    for (std::size_t i = 0; i < msgs.size(); ++i) {
+        if (results[i].type != REDIS_REPLY_STRING) {
+            continue;
+        }
+        message_ids.push_back(msgs[i]->message_id);
+        thread_ids.insert(msgs[i]->thread_id);
+        del_command.push_back(commands[i][1]);
+    }
+    if (message_ids.empty()) {
+        return true;
+    }
+    if (!MysqlMgr::getInstance()->updateChatMsgStatus(message_ids, MsgStatus::READED)) {
+        return false;
+    }
+    //缓存中是追加时的旧状态，撤销窗口后由mysql重建
+    for (auto thread_id : thread_ids) {
+        ThreadMsgCache::getInstance()->invalidate(thread_id);
+    }
+    std::vector<RedisCommand> del_commands{ std::move(del_command) };
+    RedisMgr::getInstance()->pipeline(del_commands, results);
+    return true;
+}
+
+// 删除已经全部落库的旧段，当前段继续追加
+void ChatMsgWriter::releaseSegments() {
+    for (auto iter = segment_pending_.begin(); iter != segment_pending_.end();) {
+        if (iter->first == active_seq_ || iter->second > 0) {
+            ++iter;
+            continue;
+        }
+        boost::system::error_code ec;
+        boost::filesystem::remove(segmentPath(iter->first), ec);
+        iter = segment_pending_.erase(iter);
+    }
+}
+
+// 日志中的消息可能已经落库（崩溃发生在提交之后、删除日志之前），重新写入时按id忽略
+int64_t ChatMsgWriter::replay() {
+    std::map<uint64_t, boost::filesystem::path> segments;
+    for (auto& item : boost::filesystem::directory_iterator(dir_)) {
+        auto name = item.path().filename().string();
+        if (name.size() <= SEGMENT_PREFIX.size() + SEGMENT_SUFFIX.size()
+            || name.compare(0, SEGMENT_PREFIX.size(), SEGMENT_PREFIX) != 0
+            || name.compare(name.size() - SEGMENT_SUFFIX.size(), SEGMENT_SUFFIX.size(), SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        auto seq_str = name.substr(SEGMENT_PREFIX.size(), name.size() - SEGMENT_PREFIX.size() - SEGMENT_SUFFIX.size());
+        segments[std::stoull(seq_str)] = item.path();
+    }
+
+    int64_t max_id = 0;
+    std::size_t total = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [seq, path] : segments) {
+        active_seq_ = std::max(active_seq_, seq);
+        std::ifstream in(path.string(), std::ios::binary);
+        std::string line;
+        std::size_t count = 0;
+        while (std::getline(in, line)) {
+            //崩溃时最后一行可能不完整
+            auto msg = std::make_shared<ChatMessage>();
+            if (!decode(line, *msg)) {
+                continue;
+            }
+            max_id = std::max<int64_t>(max_id, msg->message_id);
+            //原来的分配已无从得知，每条消息单独作为一次分配重新登记
+            addPending(msg, seq, msg->message_id);
+            ++count;
+        }
+        segment_pending_[seq] += 0;
+        total += count;
+    }
+    releaseSegments();
+    if (total > 0) {
+        std::cout << "replay " << total << " chat msgs from journal" << std::endl;
+    }
+    return max_id;
+}
+
+boost::filesystem::path ChatMsgWriter::segmentPath(uint64_t seq) const {
+    return dir_ / (SEGMENT_PREFIX + std::to_string(seq) + SEGMENT_SUFFIX);
+}
+
+// 每条消息一行紧凑json，内容中的换行会被转义
+std::string ChatMsgWriter::encode(const ChatMessage& msg) {
+    Json::Value root;
+    root["message_id"] = msg.message_id;
+    root["thread_id"] = msg.thread_id;
+    root["sender_id"] = msg.sender_id;
+    root["recv_id"] = msg.recv_id;
+    root["unique_id"] = msg.unique_id;
+    root["content"] = msg.content;
+    root["chat_time"] = msg.chat_time;
+    root["status"] = msg.status;
+    root["msg_type"] = msg.msg_type;
+    return toJsonString(root);
+}
+
+bool ChatMsgWriter::decode(const std::string& line, ChatMessage& msg) {
+    Json::Value root;
+    if (line.empty() || !parseJson(line, root) || !root.isObject() || !root.isMember("msg_type")) {
+        return false;
+    }
+    msg.message_id = root["message_id"].asInt();
+    msg.thread_id = root["thread_id"].asInt();
+    msg.sender_id = root["sender_id"].asInt();
+    msg.recv_id = root["recv_id"].asInt();
+    msg.unique_id = root["unique_id"].asString();
+    msg.content = root["content"].asString();
+    msg.chat_time = root["chat_time"].asString();
+    msg.status = root["status"].asInt();
+    msg.msg_type = root["msg_type"].asInt();
+    return msg.message_id > 0;
+}
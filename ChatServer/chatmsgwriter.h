@@ -0,0 +1,90 @@
+﻿#ifndef CHATMSGWRITER_H
+#define CHATMSGWRITER_H
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <condition_variable>
+#include <boost/filesystem.hpp>
+#include "singleton.h"
+#include "data.h"
+
+/******************************************************************************
+ * @file       chatmsgwriter.h
+ * @brief      聊天消息的写后持久化：消息从MsgIdAllocator取得id、追加到本地日志后
+ *             立即返回，由后台线程把积攒的消息成批写入chat_message；
+ *             日志按段滚动，一段中的消息全部落库后删除该段，
+ *             进程崩溃后重启时重放剩余的日志段
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+class ChatMsgWriter : public Singleton<ChatMsgWriter> {
+    friend class Singleton<ChatMsgWriter>;
+public:
+    ~ChatMsgWriter();
+    // 配置[MsgWriter] Enabled=true时启用，否则调用方直接同步写库
+    bool enabled() const;
+    // 重放日志中未落库的消息，初始化id分配器并启动写线程，需在处理请求前调用
+    bool start();
+    // 写完队列中的消息后退出，写库失败的消息留在日志中等下次启动重放
+    void stop();
+    // 为消息分配id并写入日志，成功后即可回复和转发
+    bool append(std::vector<std::shared_ptr<ChatMessage>>& chat_datas);
+    // 会话中是否还有已分配id但未落库的消息，此时mysql中读到的最近消息不完整
+    bool hasPending(int thread_id);
+private:
+    ChatMsgWriter();
+
+    struct Entry {
+        std::shared_ptr<ChatMessage> msg;
+        uint64_t segment;   // 所在的日志段
+        int64_t alloc;      // 所属id分配的第一个id
+    };
+
+    void run();
+    // 落库后补上ResourceServer在落库前记下的图片上传状态，失败返回false
+    bool applyUploaded(const std::vector<std::shared_ptr<ChatMessage>>& msgs);
+    void isolateBadRows(std::vector<Entry>& batch, std::vector<Entry>& retry,
+        std::vector<std::shared_ptr<ChatMessage>>& dead);
+    // 以下函数调用时需持有mutex_
+    bool openSegment(uint64_t seq);
+    bool writeJournal(const std::string& lines);
+    void releaseSegments();
+    void addPending(const std::shared_ptr<ChatMessage>& msg, uint64_t segment, int64_t alloc);
+
+    // 读取日志目录中剩余的段，返回其中最大的消息id
+    int64_t replay();
+    boost::filesystem::path segmentPath(uint64_t seq) const;
+    static std::string encode(const ChatMessage& msg);
+    static bool decode(const std::string& line, ChatMessage& msg);
+
+    bool enabled_;
+    std::size_t max_batch_;
+    std::size_t max_queue_;     // 队列中最多积压的消息数，超出时append失败
+    std::size_t segment_bytes_;
+    boost::filesystem::path dir_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Entry> queue_;
+    bool b_stop_;
+    std::thread thread_;
+
+    std::ofstream journal_;
+    uint64_t active_seq_;       // 正在追加的段
+    std::size_t active_bytes_;
+    std::map<uint64_t, std::size_t> segment_pending_;  // 每段还没落库的消息数
+    std::map<int, std::size_t> thread_pending_;        // 每个会话还没落库的消息数
+    std::map<int64_t, std::size_t> alloc_pending_;     // 每次id分配还没落库的消息数
+    std::vector<int64_t> unreleased_;                  // 已落库但撤销登记失败的分配，下一轮重试
+    std::vector<std::shared_ptr<ChatMessage>> unapplied_;  // 补上传状态失败的图片消息，下一轮重试
+};
+
+#endif // CHATMSGWRITER_H
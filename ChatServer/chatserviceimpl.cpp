@@ -7,6 +7,11 @@
 #include "redismgr.h"
 #include "mysqlmgr.h"
 #include "cserver.h"
+#include "msgcodec.h"
+#include "../Common/jsonutil.h"
+#include "usercache.h"
+#include "dbexecutor.h"
+#include "peerrouter.h"
 
 /******************************************************************************
  * @file       chserviceimpl.cpp
@@ -22,7 +27,156 @@ ChatServiceImpl::ChatServiceImpl()
 
 }
 
-Status ChatServiceImpl::NotifyAddFriend(ServerContext* context, const AddFriendReq* request, AddFriendRsp* reply)
+grpc::ServerUnaryReactor* ChatServiceImpl::NotifyAddFriend(grpc::CallbackServerContext* context,
+	const AddFriendReq* request, AddFriendRsp* reply) {
+	auto* reactor = context->DefaultReactor();
+	reactor->Finish(handleAddFriend(request, reply));
+	return reactor;
+}
+
+grpc::ServerUnaryReactor* ChatServiceImpl::NotifyAuthFriend(grpc::CallbackServerContext* context,
+	const AuthFriendReq* request, AuthFriendRsp* reply) {
+	auto* reactor = context->DefaultReactor();
+	//json通知需要查询申请人信息，可能访问redis和mysql，放到执行线程池中处理
+	//request和reply在Finish之前一直有效
+	DBExecutor::getInstance()->post([this, reactor, request, reply]() {
+		reactor->Finish(handleAuthFriend(request, reply));
+		});
+	return reactor;
+}
+
+grpc::ServerUnaryReactor* ChatServiceImpl::NotifyTextChatMsg(grpc::CallbackServerContext* context,
+	const TextChatMsgReq* request, TextChatMsgRsp* reply) {
+	auto* reactor = context->DefaultReactor();
+	reactor->Finish(handleTextChatMsg(request, reply));
+	return reactor;
+}
+
+grpc::ServerUnaryReactor* ChatServiceImpl::NotifyKickUser(grpc::CallbackServerContext* context,
+	const KickUserReq* request, KickUserRsp* reply) {
+	auto* reactor = context->DefaultReactor();
+	reactor->Finish(handleKickUser(request, reply));
+	return reactor;
+}
+
+grpc::ServerUnaryReactor* ChatServiceImpl::NotifyChatImgMsg(grpc::CallbackServerContext* context,
+	const ::message::NotifyChatImgReq* request, ::message::NotifyChatImgRsp* response) {
+	auto* reactor = context->DefaultReactor();
+	reactor->Finish(handleChatImgMsg(request, response));
+	return reactor;
+}
+
+// PeerLink流的服务端，一批处理完才读下一批，对端的发送窗口据此限流
+// 确认是累计的，写确认期间处理完的批次合并为一次确认
+// 同一条流上的seq必须连续递增（对端重连后seq接着之前的值，第一批不检查），
+// 出现缺口或回退说明批次乱序，结束流，由对端把未确认的批次改走grpc
+class PeerLinkReactor : public grpc::ServerBidiReactor<message::PeerNotifyBatch, message::PeerNotifyAck> {
+public:
+	PeerLinkReactor() : writing_(false), read_done_(false), finished_(false), acked_seq_(0), done_seq_(0) {
+		StartRead(&batch_);
+	}
+
+	void OnReadDone(bool ok) override {
+		if (!ok) {
+			bool finish = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				read_done_ = true;
+				finish = shouldFinishLocked();
+			}
+			if (finish) {
+				Finish(status_);
+			}
+			return;
+		}
+		//通知可能需要查询用户信息，放到执行线程池中处理
+		DBExecutor::getInstance()->post([this]() {
+			auto seq = batch_.seq();
+			if (done_seq_ != 0 && seq != done_seq_ + 1) {
+				std::cout << "peer link batch out of order, expect seq " << done_seq_ + 1
+					<< " but got " << seq << std::endl;
+				bool finish = false;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					read_done_ = true;
+					status_ = Status(grpc::StatusCode::ABORTED, "peer link batch out of order");
+					finish = shouldFinishLocked();
+				}
+				if (finish) {
+					Finish(status_);
+				}
+				return;
+			}
+			PeerRouter::getInstance()->deliver(batch_);
+			bool write = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				done_seq_ = seq;
+				if (!writing_) {
+					writing_ = write = true;
+					ack_.set_seq(seq);
+				}
+			}
+			if (write) {
+				StartWrite(&ack_);
+			}
+			StartRead(&batch_);
+			});
+	}
+
+	void OnWriteDone(bool ok) override {
+		bool write = false;
+		bool finish = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			acked_seq_ = ack_.seq();
+			writing_ = false;
+			if (ok && done_seq_ > acked_seq_) {
+				writing_ = write = true;
+				ack_.set_seq(done_seq_);
+			}
+			else {
+				finish = shouldFinishLocked();
+			}
+		}
+		if (write) {
+			StartWrite(&ack_);
+		}
+		if (finish) {
+			Finish(status_);
+		}
+	}
+
+	void OnDone() override {
+		delete this;
+	}
+private:
+	// 读完且没有在写的确认时结束，只结束一次
+	bool shouldFinishLocked() {
+		if (read_done_ && !writing_ && !finished_) {
+			finished_ = true;
+			return true;
+		}
+		return false;
+	}
+
+	std::mutex mutex_;
+	message::PeerNotifyBatch batch_;
+	message::PeerNotifyAck ack_;
+	bool writing_;
+	bool read_done_;
+	bool finished_;
+	int64_t acked_seq_;
+	int64_t done_seq_;
+	Status status_;		// 结束流时返回的状态，批次乱序时为ABORTED
+};
+
+grpc::ServerBidiReactor<message::PeerNotifyBatch, message::PeerNotifyAck>* ChatServiceImpl::PeerLink(
+	grpc::CallbackServerContext* context) {
+	return new PeerLinkReactor();
+}
+
+Status ChatServiceImpl::handleAddFriend(const AddFriendReq* request, AddFriendRsp* reply)
 {
 	//查找用户是否在本服务器
 	auto touid = request->touid();
@@ -49,14 +203,13 @@ Status ChatServiceImpl::NotifyAddFriend(ServerContext* context, const AddFriendR
 	rtvalue["sex"] = request->sex();
 	rtvalue["nick"] = request->nick();
 
-	std::string return_str = rtvalue.toStyledString();
+	std::string return_str = toJsonString(rtvalue);
 
 	session->send(return_str, ID_NOTIFY_ADD_FRIEND_REQ);
 	return Status::OK;
 }
 
-Status ChatServiceImpl::NotifyAuthFriend(ServerContext* context, const AuthFriendReq* request,
-	AuthFriendRsp* reply) {
+Status ChatServiceImpl::handleAuthFriend(const AuthFriendReq* request, AuthFriendRsp* reply) {
 	//查找用户是否在本服务器
 	auto touid = request->touid();
 	auto fromuid = request->fromuid();
@@ -102,14 +255,13 @@ Status ChatServiceImpl::NotifyAuthFriend(ServerContext* context, const AuthFrien
 		rtvalue["chat_datas"].append(chat);
 	}
 
-	std::string return_str = rtvalue.toStyledString();
+	std::string return_str = toJsonString(rtvalue);
 
 	session->send(return_str, ID_NOTIFY_AUTH_FRIEND_REQ);
 	return Status::OK;
 }
 
-Status ChatServiceImpl::NotifyTextChatMsg(::grpc::ServerContext* context,
-	const TextChatMsgReq* request, TextChatMsgRsp* reply) {
+Status ChatServiceImpl::handleTextChatMsg(const TextChatMsgReq* request, TextChatMsgRsp* reply) {
 	//查找用户是否在本服务器
 	auto touid = request->touid();
 	auto session = UserMgr::getInstance()->getSession(touid);
@@ -120,6 +272,24 @@ Status ChatServiceImpl::NotifyTextChatMsg(::grpc::ServerContext* context,
 		return Status::OK;
 	}
 
+	//对方协商了protobuf编码则直接发送二进制通知
+	if (session->getCodec() == CODEC_PROTOBUF) {
+		ClientTextChatMsgRsp notify;
+		notify.set_error(ErrorCodes::Success);
+		notify.set_fromuid(request->fromuid());
+		notify.set_touid(request->touid());
+		notify.set_thread_id(request->thread_id());
+		for (auto& msg : request->textmsgs()) {
+			auto* chat_data = notify.add_chat_datas();
+			chat_data->set_message_id(msg.msg_id());
+			chat_data->set_unique_id(msg.unique_id());
+			chat_data->set_content(msg.msgcontent());
+			chat_data->set_chat_time(msg.chat_time());
+		}
+		session->send(encodeTextChatMsg(CODEC_PROTOBUF, notify), ID_NOTIFY_TEXT_CHAT_MSG_REQ);
+		return Status::OK;
+	}
+
 	//在内存中则直接发送通知对方
 	Json::Value  rtvalue;
 	rtvalue["error"] = ErrorCodes::Success;
@@ -138,7 +308,7 @@ Status ChatServiceImpl::NotifyTextChatMsg(::grpc::ServerContext* context,
 	}
 	rtvalue["chat_datas"] = text_array;
 
-	std::string return_str = rtvalue.toStyledString();
+	std::string return_str = toJsonString(rtvalue);
 
 	session->send(return_str, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
 	return Status::OK;
@@ -146,13 +316,17 @@ Status ChatServiceImpl::NotifyTextChatMsg(::grpc::ServerContext* context,
 
 
 bool ChatServiceImpl::getBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo) {
-	//优先查redis中查询用户信息
+	//优先查进程内缓存
+	if (UserCache::getInstance()->get(uid, *userinfo)) {
+		return true;
+	}
+
+	//再查redis中查询用户信息
 	std::string info_str = "";
 	bool b_base = RedisMgr::getInstance()->get(base_key, info_str);
 	if (b_base) {
-		Json::Reader reader;
 		Json::Value root;
-		reader.parse(info_str, root);
+		parseJson(info_str, root);
 		userinfo->uid = root["uid"].asInt();
 		userinfo->name = root["name"].asString();
 		userinfo->pwd = root["pwd"].asString();
@@ -163,6 +337,7 @@ bool ChatServiceImpl::getBaseInfo(std::string base_key, int uid, std::shared_ptr
 		userinfo->icon = root["icon"].asString();
 		std::cout << "user login uid is  " << userinfo->uid << " name  is "
 			<< userinfo->name << " pwd is " << userinfo->pwd << " email is " << userinfo->email << std::endl;
+		UserCache::getInstance()->put(*userinfo);
 	}
 	else {
 		//redis中没有则查询mysql
@@ -185,7 +360,9 @@ bool ChatServiceImpl::getBaseInfo(std::string base_key, int uid, std::shared_ptr
 		redis_root["desc"] = userinfo->desc;
 		redis_root["sex"] = userinfo->sex;
 		redis_root["icon"] = userinfo->icon;
-		RedisMgr::getInstance()->set(base_key, redis_root.toStyledString());
+		UserCache::getInstance()->noteLocalWrite(base_key);
+		RedisMgr::getInstance()->set(base_key, toJsonString(redis_root));
+		UserCache::getInstance()->put(*userinfo);
 	}
 	return true;
 }
@@ -194,7 +371,7 @@ void ChatServiceImpl::RegisterServer(std::shared_ptr<CServer> pServer) {
 	p_server_ = pServer;
 }
 
-Status ChatServiceImpl::NotifyKickUser(::grpc::ServerContext* context, const KickUserReq* request, KickUserRsp* reply) {
+Status ChatServiceImpl::handleKickUser(const KickUserReq* request, KickUserRsp* reply) {
 	//查找用户是否在本服务器
 	auto uid = request->uid();
 	auto session = UserMgr::getInstance()->getSession(uid);
@@ -217,7 +394,7 @@ Status ChatServiceImpl::NotifyKickUser(::grpc::ServerContext* context, const Kic
 	return Status::OK;
 }
 
-Status ChatServiceImpl::NotifyChatImgMsg(::grpc::ServerContext* context, const ::message::NotifyChatImgReq* request, ::message::NotifyChatImgRsp* response) {
+Status ChatServiceImpl::handleChatImgMsg(const ::message::NotifyChatImgReq* request, ::message::NotifyChatImgRsp* response) {
 	//查找用户是否在本服务器
 	auto uid = request->to_uid();
 	auto session = UserMgr::getInstance()->getSession(uid);
@@ -9,6 +9,7 @@
 /******************************************************************************
  * @file       chserviceimpl.h
  * @brief      grpc服务端类，用于chatserver之间的通信
+ *             使用回调接口，不阻塞grpc的回调线程，需要查库的通知放到执行线程池中
  *
  * @author     lueying
  * @date       2026/1/29
@@ -36,28 +37,39 @@ using message::ChatService;
 
 class CServer;
 
-class ChatServiceImpl final : public ChatService::Service
+class ChatServiceImpl final : public ChatService::CallbackService
 {
 public:
 	ChatServiceImpl();
-	Status NotifyAddFriend(ServerContext* context, const AddFriendReq* request,
+	grpc::ServerUnaryReactor* NotifyAddFriend(grpc::CallbackServerContext* context, const AddFriendReq* request,
 		AddFriendRsp* reply) override;
 
-	Status NotifyAuthFriend(ServerContext* context,
+	grpc::ServerUnaryReactor* NotifyAuthFriend(grpc::CallbackServerContext* context,
 		const AuthFriendReq* request, AuthFriendRsp* response) override;
 
-	Status NotifyTextChatMsg(::grpc::ServerContext* context,
+	grpc::ServerUnaryReactor* NotifyTextChatMsg(grpc::CallbackServerContext* context,
 		const TextChatMsgReq* request, TextChatMsgRsp* response) override;
 
 	bool getBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo);
 
 	//接受rpc踢人请求
-	Status NotifyKickUser(::grpc::ServerContext* context,
+	grpc::ServerUnaryReactor* NotifyKickUser(grpc::CallbackServerContext* context,
 		const KickUserReq* request, KickUserRsp* response) override;
 
 	void RegisterServer(std::shared_ptr<CServer> pServer);
 	//接收客户端发送的图片聊天通知
-	virtual ::grpc::Status NotifyChatImgMsg(::grpc::ServerContext* context, const ::message::NotifyChatImgReq* request, ::message::NotifyChatImgRsp* response) override;
+	grpc::ServerUnaryReactor* NotifyChatImgMsg(grpc::CallbackServerContext* context,
+		const ::message::NotifyChatImgReq* request, ::message::NotifyChatImgRsp* response) override;
+	//其他服务器建立的通知双向流
+	grpc::ServerBidiReactor<message::PeerNotifyBatch, message::PeerNotifyAck>* PeerLink(
+		grpc::CallbackServerContext* context) override;
+
+	//通知的具体处理，grpc和redis转发收到的通知共用
+	Status handleAddFriend(const AddFriendReq* request, AddFriendRsp* reply);
+	Status handleAuthFriend(const AuthFriendReq* request, AuthFriendRsp* reply);
+	Status handleTextChatMsg(const TextChatMsgReq* request, TextChatMsgRsp* reply);
+	Status handleKickUser(const KickUserReq* request, KickUserRsp* reply);
+	Status handleChatImgMsg(const ::message::NotifyChatImgReq* request, ::message::NotifyChatImgRsp* response);
 private:
 	std::shared_ptr<CServer> p_server_;
 };
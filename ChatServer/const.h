@@ -58,6 +58,7 @@ enum ErrorCodes {
     RPCGetFailed = 1012,    // 找不到chatServer
     CreatChatFailed = 1013, //创建聊天失败
     LoadChatFailed = 1014,  //加载聊天失败
+    SaveChatFailed = 1015,  //保存聊天消息失败
 };
 
 // 配置管理类
@@ -88,12 +89,32 @@ private:
 #define LOCK_PREFIX "lock_"
 #define USER_SESSION_PREFIX "usession_"
 #define LOCK_COUNT "lockcount"
+#define CHAT_MSG_ID_KEY "chatmsgid"    // 聊天消息id分配器的计数器
+#define CHAT_MSG_PENDING_PREFIX "chatmsgpending_"  // 每台服务器已分配id但还没落库的消息
+#define CHAT_MSG_WRITERS_KEY "chatmsgwriters"      // 登记过未落库消息的服务器
+#define CHAT_MSG_UPLOADED_PREFIX "chatmsguploaded_" // 消息落库前已上传完成的图片
+#define FRIEND_LIST_PREFIX "friendlist_"    // 好友列表快照
+#define FRIEND_VERSION_PREFIX "friendver_"  // 好友列表版本，好友关系变化时递增
+#define THREAD_MSG_PREFIX "threadmsg_"      // 会话最近消息缓存
+
+//心跳超时时间（秒），客户端每10秒发一次心跳，允许连续丢失两次
+#define HEARTBEAT_TIMEOUT 30
 
 //分布式锁的持有时间
 #define LOCK_TIME_OUT 10
 //分布式锁的重试时间
 #define ACQUIRE_TIME_OUT 5
 
+//聊天服务器之间grpc调用的超时时间（秒）
+#define CHAT_RPC_TIME_OUT 5
+
+//好友列表快照的过期时间（秒），好友资料变化最多延迟这么久出现在快照中
+#define FRIEND_LIST_TTL 600
+//好友列表版本的过期时间（秒），需远大于一次登录加载好友列表的耗时
+#define FRIEND_VERSION_TTL 86400
+//从mysql分页加载好友列表时每页的条数
+#define FRIEND_LIST_PAGE_SIZE 500
+
 // 传递数据相关
 #define MAX_LENGTH 1024*2
 #define HEAD_TOTAL_LEN 4    // 头部总长度
@@ -101,6 +122,23 @@ private:
 #define HEAD_DATA_LEN 2     // 头部数据长度
 #define MAX_RECVQUE 10000
 #define MAX_SENDQUE 10000
+#define MAX_HELD_MSGS 1000  // 协程回调执行期间每个会话最多暂存的消息数
+#define MAX_SEND_BATCH_BYTES 1024*64   // 一次聚集写合并的最大字节数
+#define RECV_BUFFER_SIZE 1024*64    // 会话接收缓冲区大小，需不小于HEAD_TOTAL_LEN + MAX_LENGTH
+
+// 默认的逻辑工作线程数量（可在config.ini的[LogicSystem]WorkerCount中配置）
+#define LOGIC_WORKER_COUNT 4
+
+// 每个io线程接收消息节点池的最大节点数
+#define LOGIC_NODE_POOL_SIZE 256
+// 每个发送线程发送节点池的最大节点数，节点缓冲区为HEAD_TOTAL_LEN + MAX_LENGTH，更长的消息不走池
+#define SEND_NODE_POOL_SIZE 1024
+
+// 客户端长连接消息体的编码方式，登录时协商，默认json
+enum MsgCodec {
+    CODEC_JSON = 0,
+    CODEC_PROTOBUF = 1,
+};
 
 // 消息类型
 enum MSG_IDS {
@@ -3,6 +3,8 @@
 #include "usermgr.h"
 #include "redismgr.h"
 #include "configmgr.h"
+#include "logicsystem.h"
+#include "usercache.h"
 #include <iostream>
 
 /******************************************************************************
@@ -14,81 +16,133 @@
  * @history
  *****************************************************************************/
 
-CServer::CServer(boost::asio::io_context& io_context, short port) :io_context_(io_context), port_(port),
-acceptor_(io_context, tcp::endpoint(tcp::v4(), port)), timer_(io_context) {
-    std::cout << "Server start success, listen on port : " << port_ << endl;
-    startAccept();
+#ifdef SO_REUSEPORT
+using reuse_port_option = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+CServer::CServer(boost::asio::io_context& io_context, short port, bool reuse_port) :io_context_(io_context), port_(port),
+reuse_port_(reuse_port), timer_(io_context), heartbeat_wheel_(HEARTBEAT_TIMEOUT), wheel_timer_(io_context) {
+    openAcceptors();
+    std::cout << "Server start success, listen on port : " << port_
+        << ", acceptor count : " << acceptors_.size() << endl;
+    for (std::size_t i = 0; i < acceptors_.size(); ++i) {
+        startAccept(i);
+    }
+    //定时器回调中有同步的redis调用，只在构造时启动等待，不在构造函数中直接执行
+    timer_.expires_after(std::chrono::seconds(60));
+    timer_.async_wait([this](boost::system::error_code ec) {
+        on_timer(ec);
+        });
+    wheel_timer_.expires_after(std::chrono::seconds(1));
+    wheel_timer_.async_wait([this](boost::system::error_code ec) {
+        on_wheel_tick(ec);
+        });
 }
 
 CServer::~CServer() {
 }
 
+// 创建监听器
+void CServer::openAcceptors() {
+#ifndef SO_REUSEPORT
+    if (reuse_port_) {
+        std::cout << "SO_REUSEPORT is not supported on this platform, use single acceptor" << endl;
+        reuse_port_ = false;
+    }
+#else
+    if (reuse_port_) {
+        //每个io线程一个监听器，都绑定同一端口，新连接由内核分发，连接留在接受它的线程上
+        auto pool = AsioIOServicePool::getInstance();
+        tcp::endpoint endpoint(tcp::v4(), port_);
+        for (std::size_t i = 0; i < pool->size(); ++i) {
+            auto acceptor = std::make_unique<tcp::acceptor>(pool->getIOService(i));
+            acceptor->open(endpoint.protocol());
+            acceptor->set_option(tcp::acceptor::reuse_address(true));
+            acceptor->set_option(reuse_port_option(true));
+            acceptor->bind(endpoint);
+            acceptor->listen();
+            acceptors_.push_back(std::move(acceptor));
+        }
+        return;
+    }
+#endif
+    acceptors_.push_back(std::make_unique<tcp::acceptor>(io_context_, tcp::endpoint(tcp::v4(), port_)));
+}
+
 // 监听与处理新连接请求
-void CServer::startAccept() {
-    auto& io_context = AsioIOServicePool::getInstance()->getIOService();
+void CServer::startAccept(std::size_t index) {
+    //reuse_port模式下会话和监听器使用同一个io_context，否则轮询分配
+    auto pool = AsioIOServicePool::getInstance();
+    auto& io_context = reuse_port_ ? pool->getIOService(index) : pool->getIOService();
     shared_ptr<CSession> new_session = make_shared<CSession>(io_context, this);
-    acceptor_.async_accept(new_session->getSocket(), std::bind(&CServer::handleAccept, this, new_session, placeholders::_1));   // 也可以用lamda表达式
+    acceptors_[index]->async_accept(new_session->getSocket(),
+        std::bind(&CServer::handleAccept, this, index, new_session, placeholders::_1));   // 也可以用lamda表达式
 }
 
 // 接受连接回调处理
-void CServer::handleAccept(shared_ptr<CSession> new_session, const boost::system::error_code& error) {
+void CServer::handleAccept(std::size_t index, shared_ptr<CSession> new_session, const boost::system::error_code& error) {
     if (!error) {
+        sessions_.set(new_session->getUuid(), new_session);
+        //连接建立时放入时间轮，之后每次心跳刷新
+        new_session->updateHeartbeat();
         new_session->start();
-        lock_guard<mutex> lock(mutex_);
-        sessions_.insert(make_pair(new_session->getUuid(), new_session));
     }
     else {
         cout << "session accept failed, error is " << error.what() << endl;
     }
 
-    startAccept();
+    startAccept(index);
 }
 
 // 清理连接
 void CServer::clearSession(std::string session_id) {
-    if (sessions_.find(session_id) != sessions_.end()) {
-        //移除用户和session的关联
-        UserMgr::getInstance()->rmvUserSession(sessions_[session_id]->getUserId());
+    shared_ptr<CSession> session;
+    if (!sessions_.take(session_id, session)) {
+        return;
     }
 
-    {
-        lock_guard<mutex> lock(mutex_);
-        sessions_.erase(session_id);
+    //移除用户和session的关联
+    UserMgr::getInstance()->rmvUserSession(session->getUserId(), session);
+    heartbeat_wheel_.remove(session_id);
+}
+
+// 刷新会话的心跳超时时间，已清理的会话不再放回时间轮
+void CServer::touchHeartbeat(std::shared_ptr<CSession> session) {
+    if (!checkValid(session->getUuid())) {
+        return;
     }
+    heartbeat_wheel_.touch(session->getUuid(), session);
 }
 
-// 定时心跳监测
+// 定时上报在线人数，心跳超时由时间轮处理
 void CServer::on_timer(const boost::system::error_code& ec) {
-    std::vector<std::shared_ptr<CSession>> _expired_sessions;
-    int session_count = 0;
-    //此处加锁遍历session
-    {
-        lock_guard<mutex> lock(mutex_);
-        time_t now = std::time(nullptr);
-        for (auto iter = sessions_.begin(); iter != sessions_.end(); iter++) {
-            auto b_expired = iter->second->isHeartbeatExpired(now);
-            if (b_expired) {
-                //关闭socket, 其实这里也会触发async_read的错误处理
-                iter->second->close();
-                //收集过期信息
-                _expired_sessions.push_back(iter->second);
-                continue;
-            }
-            session_count++;
-        }
+    if (ec == boost::asio::error::operation_aborted) {
+        return;
     }
 
+    std::size_t session_count = sessions_.size();
+
     //设置session数量
     auto& cfg = ConfigMgr::getInst();
     auto self_name = cfg["SelfServer"]["Name"];
     auto count_str = std::to_string(session_count);
     RedisMgr::getInstance()->hSet(LOGIN_COUNT, self_name, count_str);
 
-    //处理过期session, 单独提出，防止死锁
-    for (auto& session : _expired_sessions) {
-        session->dealExceptionSession();
+    //输出逻辑工作线程的队列深度和处理耗时
+    auto worker_stats = LogicSystem::getInstance()->getWorkerStats();
+    for (std::size_t i = 0; i < worker_stats.size(); ++i) {
+        auto& stat = worker_stats[i];
+        auto avg_us = stat.handled_count == 0 ? 0 : stat.total_latency_us / stat.handled_count;
+        std::cout << "logic worker [" << i << "] queue depth: " << stat.queue_depth
+            << ", handled: " << stat.handled_count << ", avg latency: " << avg_us
+            << "us, max latency: " << stat.max_latency_us << "us" << std::endl;
     }
 
+    //输出用户信息缓存的命中情况
+    auto cache_stats = UserCache::getInstance()->getStats();
+    std::cout << "user cache size: " << cache_stats.size << ", hits: " << cache_stats.hits
+        << ", misses: " << cache_stats.misses << std::endl;
+
     //再次设置，下一个60s检测
     timer_.expires_after(std::chrono::seconds(60));
     timer_.async_wait([this](boost::system::error_code ec) {
@@ -96,12 +150,28 @@ void CServer::on_timer(const boost::system::error_code& ec) {
         });
 }
 
+// 时间轮前进一格，只处理这一格中到期的会话
+void CServer::on_wheel_tick(const boost::system::error_code& ec) {
+    if (ec == boost::asio::error::operation_aborted) {
+        return;
+    }
+
+    auto expired_sessions = heartbeat_wheel_.tick();
+    for (auto& session : expired_sessions) {
+        std::cout << "heartbeat expired, session id is  " << session->getUuid() << std::endl;
+        //关闭socket, 其实这里也会触发async_read的错误处理
+        session->close();
+        //在时间轮的锁外处理，防止死锁
+        session->dealExceptionSession();
+    }
+
+    wheel_timer_.expires_after(std::chrono::seconds(1));
+    wheel_timer_.async_wait([this](boost::system::error_code ec) {
+        on_wheel_tick(ec);
+        });
+}
+
 // 检查server中是否有指定uuid的session
 bool CServer::checkValid(std::string uuid) {
-    lock_guard<mutex> lock(mutex_);
-    auto it = sessions_.find(uuid);
-    if (it != sessions_.end()) {
-        return true;
-    }
-    return false;
+    return sessions_.contains(uuid);
 }
\ No newline at end of file
@@ -4,9 +4,9 @@
 #include <boost/asio.hpp>
 #include "csession.h"
 #include <memory.h>
-#include <map>
-#include <mutex>
+#include "shardedmap.h"
 #include <boost/asio/steady_timer.hpp>
+#include "timingwheel.h"
 
 /******************************************************************************
  * @file       cserver.h
@@ -22,26 +22,36 @@ using boost::asio::ip::tcp;
 
 class CServer: public std::enable_shared_from_this<CServer> {
 public:
-    CServer(boost::asio::io_context& io_context, short port);
+    // reuse_port为true时在每个io线程上各开一个SO_REUSEPORT监听，由内核分发新连接
+    CServer(boost::asio::io_context& io_context, short port, bool reuse_port = false);
     ~CServer();
     void clearSession(std::string);
     // 检查server中是否有指定uuid的session
     bool checkValid(std::string uuid);
+    // 刷新会话的心跳超时时间
+    void touchHeartbeat(std::shared_ptr<CSession> session);
 private:
-    // 监听与处理新连接请求
-    void startAccept();
+    // 创建监听器，开启reuse_port时每个io线程一个
+    void openAcceptors();
+    // 监听与处理新连接请求，index为监听器下标
+    void startAccept(std::size_t index);
     // 连接回调处理
-    void handleAccept(shared_ptr<CSession>, const boost::system::error_code& error);
+    void handleAccept(std::size_t index, shared_ptr<CSession>, const boost::system::error_code& error);
     boost::asio::io_context& io_context_;
     short port_;
-    tcp::acceptor acceptor_;
-    // 会话管理
-    std::map<std::string, shared_ptr<CSession>> sessions_;
-    std::mutex mutex_;  // 保护会话
+    bool reuse_port_;
+    std::vector<std::unique_ptr<tcp::acceptor>> acceptors_;
+    // 会话管理，按uuid分片加锁，读路径上的checkValid只加分片读锁
+    ShardedMap<std::string, shared_ptr<CSession>> sessions_;
     boost::asio::steady_timer timer_;
+    // 心跳超时时间轮，每秒前进一格
+    TimingWheel heartbeat_wheel_;
+    boost::asio::steady_timer wheel_timer_;
 
-    // 定时心跳监测
+    // 定时上报在线人数
     void on_timer(const boost::system::error_code& e);
+    // 时间轮前进一格，处理到期的会话
+    void on_wheel_tick(const boost::system::error_code& e);
 };
 
 #endif // CSERVER_H
\ No newline at end of file
@@ -2,9 +2,12 @@
 #include "cserver.h"
 #include "logicsystem.h"
 #include "redismgr.h"
+#include "logicnodepool.h"
+#include "sendnodepool.h"
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include "../Common/jsonutil.h"
 
 /******************************************************************************
  * @file       csession.h
@@ -16,10 +19,10 @@
  *****************************************************************************/
 
 CSession::CSession(boost::asio::io_context& io_context, CServer* server): 
-    socket_(io_context), server_(server), b_close_(false), b_head_pares_(false), user_uid_(0) {
+    socket_(io_context), server_(server), b_close_(false), b_head_pares_(false), user_uid_(0), codec_(CODEC_JSON), worker_index_(-1), async_running_(false),
+    recv_begin_(0), recv_end_(0), send_pending_(0), writing_(false) {
     boost::uuids::uuid a_uuid = boost::uuids::random_generator()();
     uuid_ = boost::uuids::to_string(a_uuid);
-    recv_head_node_ = make_shared<MsgNode>(HEAD_TOTAL_LEN);
 }
 
 CSession::~CSession() {
@@ -41,6 +44,14 @@ int CSession::getUserId() {
     return user_uid_;
 }
 
+int CSession::getCodec() {
+    return codec_;
+}
+
+void CSession::setCodec(int codec) {
+    codec_ = codec;
+}
+
 std::shared_ptr<CSession> CSession::sharedSelf() {
     return shared_from_this();
 }
@@ -48,7 +59,7 @@ std::shared_ptr<CSession> CSession::sharedSelf() {
 
 // 开始
 void CSession::start() {
-    asyncReadHead(HEAD_TOTAL_LEN);
+    asyncRead();
 }
 
 void CSession::close() {
@@ -64,7 +75,7 @@ void CSession::notifyOffline(int uid) {
     rtvalue["uid"] = uid;
 
 
-    std::string return_str = rtvalue.toStyledString();
+    std::string return_str = toJsonString(rtvalue);
 
     send(return_str, ID_NOTIFY_OFF_LINE_REQ);
     return;
@@ -81,226 +92,189 @@ void CSession::notifyChatImgRecv(const::message::NotifyChatImgReq* request) {
     rtvalue["total_size"] = std::to_string(request->total_size());
     rtvalue["thread_id"] = request->thread_id();
 
-    std::string return_str = rtvalue.toStyledString();
+    std::string return_str = toJsonString(rtvalue);
     //通知图片聊天信息
     send(return_str, ID_NOTIFY_IMG_CHAT_MSG_REQ);
     return;
 }
 
-// 异步读取消息头部
-void CSession::asyncReadHead(int total_len) {
-    auto self = shared_from_this();
-    asyncReadFull(HEAD_TOTAL_LEN, [self, this](const boost::system::error_code& ec, std::size_t bytes_transfered) {
-        try {
-            if (ec) {
-                // 如果出现错误，关闭连接
-                std::cout << "handle read failed, error is " << ec.what() << endl;
-                close();
-
-                //加锁清除session
-                auto uid_str = std::to_string(user_uid_);
-                auto lock_key = LOCK_PREFIX + uid_str;
-                auto identifier = RedisMgr::getInstance()->acquireLock(lock_key, LOCK_TIME_OUT, ACQUIRE_TIME_OUT);
-                Defer defer([identifier, lock_key, self, this]() {
-                    server_->clearSession(uuid_);
-                    RedisMgr::getInstance()->releaseLock(lock_key, identifier);
-                    });
-
-                if (identifier.empty()) {
-                    return;
-                }
-                std::string redis_session_id = "";
-                auto bsuccess = RedisMgr::getInstance()->get(USER_SESSION_PREFIX + uid_str, redis_session_id);
-                if (!bsuccess) {
-                    return;
-                }
-
-                if (redis_session_id != uuid_) {
-                    //说明有客户在其他服务器异地登录了
-                    return;
-                }
-
-                RedisMgr::getInstance()->del(USER_SESSION_PREFIX + uid_str);
-                //清除用户登录信息
-                RedisMgr::getInstance()->del(USERIPPREFIX + uid_str);
-                return;
-            }
-
-            if (bytes_transfered < HEAD_TOTAL_LEN) {
-                // 如果读取头部长度不够
-                std::cout << "read length not match, read [" << bytes_transfered << "] , total ["
-                    << HEAD_TOTAL_LEN << "]" << std::endl;
-                close();
-                server_->clearSession(uuid_);
-                return;
-            }
-
-            // 读取头部成功，将缓冲区中的头部数据拷贝到RecvHeadNode中
-            recv_head_node_->clear();
-            memcpy(recv_head_node_->data_, data_, bytes_transfered);
-
-            //获取头部MSGID数据
-            short msg_id = 0;
-            memcpy(&msg_id, recv_head_node_->data_, HEAD_ID_LEN);
-
-            //网络字节序转化为本地字节序
-            msg_id = boost::asio::detail::socket_ops::network_to_host_short(msg_id);
-            std::cout << "msg_id is " << msg_id << std::endl;
+// 异步读取数据，一次读取可能包含多个消息帧
+void CSession::asyncRead() {
+    socket_.async_read_some(boost::asio::buffer(recv_buf_ + recv_end_, RECV_BUFFER_SIZE - recv_end_),
+        std::bind(&CSession::handleRead, this, std::placeholders::_1, std::placeholders::_2, sharedSelf()));
+}
 
-            // id非法
-            if (msg_id > MAX_LENGTH) {
-                std::cout << "invalid msg_id is " << msg_id << std::endl;
-                server_->clearSession(uuid_);
-                return;
-            }
+// 读处理函数
+void CSession::handleRead(const boost::system::error_code& error, size_t bytes_transferred, std::shared_ptr<CSession> shared_self) {
+    try {
+        if (error) {
+            // 如果出现错误，关闭连接
+            std::cout << "handle read failed, error is " << error.what() << endl;
+            close();
+            dealExceptionSession();
+            return;
+        }
 
-            // 读取数据长度数据
-            short msg_len = 0;
-            memcpy(&msg_len, recv_head_node_->data_ + HEAD_ID_LEN, HEAD_DATA_LEN);
+        //判断连接无效
+        if (!server_->checkValid(uuid_)) {
+            close();
+            return;
+        }
 
-            //网络字节序转化为本地字节序
-            msg_len = boost::asio::detail::socket_ops::network_to_host_short(msg_len);
-            std::cout << "msg_len is " << msg_len << std::endl;
+        //收到任何数据都说明连接仍然存活，刷新时间轮，不依赖逻辑线程处理心跳包的时机
+        updateHeartbeat();
 
-            // 数据长度非法（超过缓冲区长度）
-            if (msg_len > MAX_LENGTH) {
-                std::cout << "invalid data length is " << msg_len << std::endl;
-                server_->clearSession(uuid_);
-                return;
-            }
+        recv_end_ += bytes_transferred;
+        if (!parseFrames()) {
+            close();
+            server_->clearSession(uuid_);
+            return;
+        }
 
-            recv_msg_node_ = std::make_shared<RecvNode>(msg_len, msg_id);
-            // 读取数据体
-            asyncReadBody(msg_len);
+        // 数据全部解析完则从头开始，否则剩余空间放不下一个完整帧时将剩余数据移到缓冲区开头
+        if (recv_begin_ == recv_end_) {
+            recv_begin_ = recv_end_ = 0;
         }
-        catch (std::exception& e) {
-            std::cout << "Exception code is " << e.what() << std::endl;
+        else if (RECV_BUFFER_SIZE - recv_begin_ < HEAD_TOTAL_LEN + MAX_LENGTH) {
+            ::memmove(recv_buf_, recv_buf_ + recv_begin_, recv_end_ - recv_begin_);
+            recv_end_ -= recv_begin_;
+            recv_begin_ = 0;
         }
-        });
-}
-
-//读取完整长度
-void CSession::asyncReadFull(std::size_t maxLength, std::function<void(const boost::system::error_code&, std::size_t)> handler) {
-    // 清空缓冲区
-    ::memset(data_, 0, MAX_LENGTH);
-    asyncReadLen(0, maxLength, handler);
-}
-
-//读取指定字节范围（解决半包问题）
-void CSession::asyncReadLen(std::size_t read_len, std::size_t total_len,
-    std::function<void(const boost::system::error_code&, std::size_t)> handler) {
-    auto self = shared_from_this();
-    socket_.async_read_some(boost::asio::buffer(data_ + read_len, total_len - read_len),
-        [read_len, total_len, handler, self](const boost::system::error_code& ec, std::size_t  bytesTransfered) {
-            if (ec) {
-                // 出现错误，调用回调函数
-                handler(ec, read_len + bytesTransfered);
-                return;
-            }
-
-            if (read_len + bytesTransfered >= total_len) {
-                //长度够了就调用回调函数
-                handler(ec, read_len + bytesTransfered);
-                return;
-            }
 
-            // 长度不够，继续递归调用自己，直到读满 total_len
-            self->asyncReadLen(read_len + bytesTransfered, total_len, handler);
-        });
+        //继续监听读事件
+        asyncRead();
+    }
+    catch (std::exception& e) {
+        std::cout << "Exception code is " << e.what() << std::endl;
+    }
 }
 
-// 读取数据体
-void CSession::asyncReadBody(int total_len) {
-    auto self = shared_from_this();
-    asyncReadFull(total_len, [self, this, total_len](const boost::system::error_code& ec, std::size_t bytes_transfered) {
-        try {
-            if (ec) {
-                // 如果出现错误，关闭连接
-                std::cout << "handle read failed, error is " << ec.what() << endl;
-                close();
-                dealExceptionSession();
-                return;
-            }
+// 解析缓冲区中的消息帧
+bool CSession::parseFrames() {
+    while (recv_end_ - recv_begin_ >= HEAD_TOTAL_LEN) {
+        const char* head = recv_buf_ + recv_begin_;
+
+        //获取头部MSGID数据
+        short msg_id = 0;
+        memcpy(&msg_id, head, HEAD_ID_LEN);
+        //网络字节序转化为本地字节序
+        msg_id = boost::asio::detail::socket_ops::network_to_host_short(msg_id);
+
+        // id非法
+        if (msg_id > MAX_LENGTH) {
+            std::cout << "invalid msg_id is " << msg_id << std::endl;
+            return false;
+        }
 
-            if (bytes_transfered < total_len) {
-                std::cout << "read length not match, read [" << bytes_transfered << "] , total ["
-                    << total_len << "]" << std::endl;
-                close();
-                server_->clearSession(uuid_);
-                return;
-            }
+        // 读取数据长度数据
+        short msg_len = 0;
+        memcpy(&msg_len, head + HEAD_ID_LEN, HEAD_DATA_LEN);
+        //网络字节序转化为本地字节序
+        msg_len = boost::asio::detail::socket_ops::network_to_host_short(msg_len);
 
-            //判断连接无效
-            if (!server_->checkValid(uuid_)) {
-                close();
-                return;
-            }
+        // 数据长度非法（超过缓冲区长度）
+        if (msg_len < 0 || msg_len > MAX_LENGTH) {
+            std::cout << "invalid data length is " << msg_len << std::endl;
+            return false;
+        }
 
-            // 将缓冲区中的数据拷贝到RecvNode中
-            memcpy(recv_msg_node_->data_, data_, bytes_transfered);
-            recv_msg_node_->cur_len_ += bytes_transfered;
-            recv_msg_node_->data_[recv_msg_node_->total_len_] = '\0';
-            std::cout << "receive data is " << recv_msg_node_->data_ << std::endl;
-            //此处将消息投递到逻辑队列中
-            LogicSystem::getInstance()->postMsgToQue(make_shared<LogicNode>(shared_from_this(), recv_msg_node_));
-            //继续监听头部接受事件
-            asyncReadHead(HEAD_TOTAL_LEN);
+        // 半包，等待下次读取
+        if (recv_end_ - recv_begin_ < static_cast<std::size_t>(HEAD_TOTAL_LEN + msg_len)) {
+            break;
         }
-        catch (std::exception& e) {
-            std::cout << "Exception code is " << e.what() << std::endl;
+
+        std::cout << "msg_id is " << msg_id << " msg_len is " << msg_len << std::endl;
+        // 从本io线程的节点池中取出节点，拷贝消息体后投递到逻辑队列中
+        auto node = LogicNodePool::local().acquire(msg_id);
+        auto& recvnode = node->recvnode_;
+        memcpy(recvnode->data_, head + HEAD_TOTAL_LEN, msg_len);
+        recvnode->cur_len_ = msg_len;
+        recvnode->data_[msg_len] = '\0';
+        node->session_ = sharedSelf();
+        LogicSystem::getInstance()->postMsgToQue(std::move(node));
+        // 暂存的消息过多时会话已被关闭，不再解析后续的帧
+        if (b_close_) {
+            return false;
         }
-    });
+
+        recv_begin_ += HEAD_TOTAL_LEN + msg_len;
+    }
+    return true;
 }
 
 // 发送数据
 void CSession::send(char* msg, short max_length, short msgid) {
-    std::lock_guard<std::mutex> lock(send_lock_);
-    int send_que_size = send_queue_.size();
-    if (send_que_size > MAX_SENDQUE) {
+    if (send_pending_ > MAX_SENDQUE) {
         std::cout << "session: " << uuid_ << " send que fulled, size is " << MAX_SENDQUE << endl;
         return;
     }
+    pushSendNode(SendNodePool::local().acquire(msg, max_length, msgid));
+}
 
-    send_queue_.push(make_shared<SendNode>(msg, max_length, msgid));
-    if (send_que_size > 0) {
-        // 如果压入前，发送队列中已经有消息，说明正在发送，直接返回即可
+void CSession::send(const std::string& msg, short msgid) {
+    if (send_pending_ > MAX_SENDQUE) {
+        std::cout << "session: " << uuid_ << " send que fulled, size is " << MAX_SENDQUE << endl;
         return;
     }
-    // 如果压入前发送队列为空，说明当前没有消息在发送，开始发送
-    auto& msgnode = send_queue_.front();
-    boost::asio::async_write(socket_, boost::asio::buffer(msgnode->data_, msgnode->total_len_),
-        std::bind(&CSession::handleWrite, this, std::placeholders::_1, sharedSelf()));
+    pushSendNode(SendNodePool::local().acquire(msg.c_str(), msg.length(), msgid));
 }
 
-void CSession::send(std::string msg, short msgid) {
-    std::lock_guard<std::mutex> lock(send_lock_);
-    int send_que_size = send_queue_.size();
-    if (send_que_size > MAX_SENDQUE) {
-        std::cout << "session: " << uuid_ << " send que fulled, size is " << MAX_SENDQUE << endl;
-        return;
+void CSession::pushSendNode(std::shared_ptr<SendNode> msgnode) {
+    send_pending_.fetch_add(1, std::memory_order_relaxed);
+    send_queue_.push(std::move(msgnode));
+    // 先完成入队再抢写权限：抢到的生产者负责启动写操作，否则由持有写权限的写操作继续发送
+    if (!writing_.exchange(true, std::memory_order_acq_rel)) {
+        boost::asio::post(socket_.get_executor(),
+            std::bind(&CSession::startWrite, this, sharedSelf()));
     }
+}
 
-    send_queue_.push(make_shared<SendNode>(msg.c_str(), msg.length(), msgid));
-    if (send_que_size > 0) {
-        return;
+// 把发送队列中的消息（总长度不超过MAX_SEND_BATCH_BYTES，至少一条）合并为一次聚集写
+// 只在持有写权限时调用，取不到消息时交还写权限，不重新投递自己
+void CSession::startWrite(std::shared_ptr<CSession> self_shared) {
+    for (;;) {
+        std::size_t batch_bytes = 0;
+        std::shared_ptr<SendNode> msgnode = std::move(carry_node_);
+        while (msgnode || send_queue_.pop(msgnode)) {
+            if (!sending_nodes_.empty() && batch_bytes + msgnode->total_len_ > MAX_SEND_BATCH_BYTES) {
+                carry_node_ = std::move(msgnode);
+                break;
+            }
+            batch_bytes += msgnode->total_len_;
+            sending_buffers_.push_back(boost::asio::buffer(msgnode->data_, msgnode->total_len_));
+            sending_nodes_.push_back(std::move(msgnode));
+            msgnode.reset();
+        }
+
+        if (!sending_nodes_.empty()) {
+            boost::asio::async_write(socket_, sending_buffers_,
+                std::bind(&CSession::handleWrite, this, std::placeholders::_1, self_shared));
+            return;
+        }
+
+        // 队列为空，或者生产者已交换队尾但尚未链接，交还写权限
+        // 尚未链接的生产者完成入队后会抢到写权限并重新投递，这里不需要等待
+        writing_.exchange(false, std::memory_order_acq_rel);
+        // 交还之前已经完成入队、又没被取到的消息由这里补发，避免它的生产者看到写权限被占用而不投递
+        if (!send_queue_.pop(carry_node_)) {
+            return;
+        }
+        if (writing_.exchange(true, std::memory_order_acq_rel)) {
+            // 其他生产者已经投递了写操作，留下的消息由它在同一io线程中发送
+            return;
+        }
     }
-    auto& msgnode = send_queue_.front();
-    boost::asio::async_write(socket_, boost::asio::buffer(msgnode->data_, msgnode->total_len_),
-        std::bind(&CSession::handleWrite, this, std::placeholders::_1, sharedSelf()));
 }
 
 // 写处理函数
 void CSession::handleWrite(const boost::system::error_code& error, shared_ptr<CSession> self_shared) {
     try {
         if (!error) {
-            std::lock_guard<std::mutex> lock(send_lock_);
-            send_queue_.pop();
-            if (!send_queue_.empty()) {
-                // 如果当前发送队列仍然有数据，继续发送
-                auto& msgnode = send_queue_.front();
-                boost::asio::async_write(socket_, boost::asio::buffer(msgnode->data_, msgnode->total_len_),
-                    std::bind(&CSession::handleWrite, this, std::placeholders::_1, self_shared));
-            }
+            send_pending_.fetch_sub(static_cast<int>(sending_nodes_.size()), std::memory_order_relaxed);
+            sending_nodes_.clear();
+            sending_buffers_.clear();
+            // 继续发送队列中的数据，队列为空时交还写权限
+            startWrite(self_shared);
         }
         else {
             // 如果出现错误，关闭连接
@@ -317,53 +291,57 @@ void CSession::handleWrite(const boost::system::error_code& error, shared_ptr<CS
 
 // 清理过期的会话
 void CSession::dealExceptionSession() {
+    //获取锁期间协程挂起，io线程继续处理其他连接
+    boost::asio::co_spawn(socket_.get_executor(), asyncDealExceptionSession(),
+        [uuid = uuid_](std::exception_ptr e) {
+            if (!e) {
+                return;
+            }
+            try {
+                std::rethrow_exception(e);
+            }
+            catch (std::exception& ex) {
+                std::cout << "deal exception session [" << uuid << "] exception: " << ex.what() << std::endl;
+            }
+        });
+}
+
+boost::asio::awaitable<void> CSession::asyncDealExceptionSession() {
     auto self = shared_from_this();
+    auto redis = RedisMgr::getInstance();
     //加锁清除session
     auto uid_str = std::to_string(user_uid_);
     auto lock_key = LOCK_PREFIX + uid_str;
-    auto identifier = RedisMgr::getInstance()->acquireLock(lock_key, LOCK_TIME_OUT, ACQUIRE_TIME_OUT);
-    Defer defer([identifier, lock_key, self, this]() {
-        server_->clearSession(uuid_);
-        RedisMgr::getInstance()->releaseLock(lock_key, identifier);
-        });
-
-    if (identifier.empty()) {
-        return;
+    auto identifier = co_await redis->asyncAcquireLock(lock_key, LOCK_TIME_OUT, ACQUIRE_TIME_OUT);
+    //析构函数中不能co_await，异常先暂存，解锁后再抛出
+    std::exception_ptr eptr;
+    try {
+        std::string redis_session_id = "";
+        //没拿到锁、redis中没有记录，或者有客户在其他服务器异地登录了，都不清除登录信息
+        if (!identifier.empty() && co_await redis->asyncGet(USER_SESSION_PREFIX + uid_str, redis_session_id)
+            && redis_session_id == uuid_) {
+            //清除session id和用户登录信息，一次DEL删除
+            std::vector<std::string> keys{ USER_SESSION_PREFIX + uid_str, USERIPPREFIX + uid_str };
+            co_await redis->asyncDel(std::move(keys));
+        }
     }
-    std::string redis_session_id = "";
-    auto bsuccess = RedisMgr::getInstance()->get(USER_SESSION_PREFIX + uid_str, redis_session_id);
-    if (!bsuccess) {
-        return;
+    catch (...) {
+        eptr = std::current_exception();
     }
 
-    if (redis_session_id != uuid_) {
-        //说明有客户在其他服务器异地登录了
-        return;
+    server_->clearSession(uuid_);
+    co_await redis->asyncReleaseLock(lock_key, identifier);
+    if (eptr) {
+        std::rethrow_exception(eptr);
     }
-
-    RedisMgr::getInstance()->del(USER_SESSION_PREFIX + uid_str);
-    //清除用户登录信息
-    RedisMgr::getInstance()->del(USERIPPREFIX + uid_str);
 }
 
 // 更新心跳
 void CSession::updateHeartbeat() {
-    time_t now = std::time(nullptr);
-    last_heartbeat_ = now;
+    //刷新会话在时间轮中的位置
+    server_->touchHeartbeat(shared_from_this());
 }
 
-// 心跳是否过期
-bool CSession::isHeartbeatExpired(std::time_t& now) {
-    double diff_sec = std::difftime(now, last_heartbeat_);
-    if (diff_sec > 20) {
-        std::cout << "heartbeat expired, session id is  " << uuid_ << std::endl;
-        return true;
-    }
-
-    return false;
-}
-
-
 LogicNode::LogicNode(std::shared_ptr<CSession>  session,
     std::shared_ptr<RecvNode> recvnode) :session_(session), recvnode_(recvnode) {
 }
\ No newline at end of file
@@ -6,8 +6,12 @@
 #include <mutex>
 #include <iostream>
 #include <queue>
+#include <deque>
+#include <vector>
+#include <atomic>
 #include "const.h"
 #include "msgnode.h"
+#include "mpscqueue.h"
 #include "message.grpc.pb.h"
 #include "message.pb.h"
 
@@ -22,11 +26,18 @@
 
 using boost::asio::ip::tcp;
 using message::NotifyChatImgReq;
+using message::ClientTextChatMsgReq;
+using message::ClientTextChatMsgRsp;
+using message::ClientChatData;
+using message::ClientHeartBeatReq;
+using message::ClientHeartBeatRsp;
 
 class CServer;
 class LogicSystem;
+class LogicNode;
 
 class CSession : public std::enable_shared_from_this<CSession> {
+    friend class LogicSystem;
 public:
     CSession(boost::asio::io_context& io_context, CServer* server);
     ~CSession();
@@ -38,62 +49,75 @@ public:
     std::shared_ptr<CSession> sharedSelf();
     void start();
     void send(char* msg, short max_length, short msgid);
-    void send(std::string msg, short msgid);
+    void send(const std::string& msg, short msgid);
     void close();
     // 通知客户端要下线
     void notifyOffline(int uid);
     // 通知聊天图片上传完成
     void notifyChatImgRecv(const ::message::NotifyChatImgReq* request);
+    // 获取和设置消息体编码方式（MsgCodec）
+    int getCodec();
+    void setCodec(int codec);
     // 更新心跳
     void updateHeartbeat();
-    // 心跳是否过期
-    bool isHeartbeatExpired(std::time_t& now);
-    // 清理过期的会话
+    // 清理过期的会话，在会话的io_context上启动协程处理，不阻塞调用方
     void dealExceptionSession();
 
 private:
+    // 清理会话的协程：加分布式锁，确认redis中记录的仍是本会话后清除登录信息
+    boost::asio::awaitable<void> asyncDealExceptionSession();
+
     tcp::socket socket_;
     std::string uuid_;
     CServer* server_;
-    int user_uid_;
+    std::atomic<int> user_uid_;
+    std::atomic<int> codec_;
+    // 会话固定使用的逻辑工作线程下标，-1表示尚未选定，只在会话的io线程中访问
+    int worker_index_;
+    // 是否有协程回调正在执行，期间收到的消息暂存在held_msgs_中，协程结束后按序处理
+    // 暂存超过MAX_HELD_MSGS条时关闭会话
+    bool async_running_;
+    std::deque<std::shared_ptr<LogicNode>> held_msgs_;
 
     bool b_head_pares_; // 是否解析头部
     bool b_close_;      // 是否关闭连接
 
-    std::mutex send_lock_;                          // 发送队列锁
-    std::queue<std::shared_ptr<MsgNode>> send_queue_;    // 发送队列
-
-    // 协议解析相关的节点
-    std::shared_ptr<MsgNode> recv_head_node_;
-    std::shared_ptr<RecvNode> recv_msg_node_;
-
-    //记录上次接受数据的时间
-    std::atomic<time_t> last_heartbeat_;
+    MpscQueue<SendNode> send_queue_;                // 发送队列，任意线程入队，io线程出队
+    std::atomic<int> send_pending_;                 // 已入队但尚未写完的消息数，只用于限制队列长度
+    std::atomic<bool> writing_;                     // 是否持有写权限，入队后由false变为true的生产者投递写操作
+    std::shared_ptr<SendNode> carry_node_;          // 超出上一批字节上限、留到下一批发送的消息
+    std::vector<std::shared_ptr<SendNode>> sending_nodes_;        // 正在发送的一批消息
+    std::vector<boost::asio::const_buffer> sending_buffers_;      // 正在发送的一批消息对应的缓冲区
 
-    // 异步读逻辑
-    void asyncReadHead(int total_len);
-    void asyncReadBody(int total_len);
+    // 接收缓冲区中未解析数据的范围[recv_begin_, recv_end_)
+    std::size_t recv_begin_;
+    std::size_t recv_end_;
 
-    // 辅助读取函数
-    // 读取完整长度
-    void asyncReadFull(std::size_t maxLength,
-        std::function<void(const boost::system::error_code&, std::size_t)> handler);
-    // 读取指定范围
-    void asyncReadLen(std::size_t read_len, std::size_t total_len,
-        std::function<void(const boost::system::error_code&, std::size_t)> handler);
+    // 异步读逻辑，尽可能多地读入接收缓冲区
+    void asyncRead();
+    // 解析缓冲区中所有完整的消息帧并投递，不完整的帧留待下次读取，协议错误时返回false
+    bool parseFrames();
 
     // 读写处理函数
     void handleRead(const boost::system::error_code& error, size_t bytes_transferred, std::shared_ptr<CSession> shared_self);
     void handleWrite(const boost::system::error_code& error, std::shared_ptr<CSession> _self_shared);
+    // 将消息放入发送队列，队列由空闲变为忙碌时投递写操作到会话的io线程
+    void pushSendNode(std::shared_ptr<SendNode> msgnode);
+    // 将发送队列中的消息合并为一次写操作，只在会话的io线程中执行
+    void startWrite(std::shared_ptr<CSession> self_shared);
 
-    // 接收缓冲区
-    char data_[MAX_LENGTH]; // MAX_LENGTH 建议定义在 const.h
+    // 接收缓冲区，至少能容纳一个最大长度的完整消息帧
+    char recv_buf_[RECV_BUFFER_SIZE];
 };
 
 
 // 提交给logicsystem的事务
 class LogicNode {
     friend class LogicSystem;
+    friend class LogicWorker;
+    friend class LogicNodePool;
+    friend struct LogicNodeReleaser;
+    friend class CSession;
 public:
     LogicNode(std::shared_ptr<CSession>, std::shared_ptr<RecvNode>);
 private:
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include <string>
+#include <cstdint>
 struct UserInfo {
 	UserInfo() :name(""), pwd(""), uid(0), email(""), nick(""), desc(""), sex(0), icon(""), back("") {}
 	std::string name;
@@ -35,6 +36,17 @@ struct ChatThreadInfo {
 	std::string _type;     // "private" or "group"
 	int _user1_id;    // 私聊时对应 private_chat.user1_id；群聊时设为 0
 	int _user2_id;    // 私聊时对应 private_chat.user2_id；群聊时设为 0
+	int64_t _last_msg_id;   // 按最近活跃排序时会话的最近消息id
+	bool _changed;    // 列表加载期间有了新消息的会话，在最后一页返回，客户端按thread_id合并
+};
+
+//聊天线程列表的翻页游标
+//按最近活跃排序时由上一页最后一个会话的(last_msg_id, thread_id)定位，游标会话之后有新消息也不影响翻页；
+//snapshot为第一页时已提交的最大消息id，之后有新消息的会话排序已经变化，不在翻页中返回，由最后一页一并返回
+struct ChatThreadCursor {
+	int64_t _thread_id;
+	int64_t _last_msg_id;
+	int64_t _snapshot;
 };
 
 //聊天消息信息
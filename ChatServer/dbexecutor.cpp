@@ -0,0 +1,30 @@
+﻿#include "dbexecutor.h"
+#include "configmgr.h"
+
+/******************************************************************************
+ * @file       dbexecutor.cpp
+ * @brief      阻塞的Redis/MySQL调用的执行线程池实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 读取线程池大小，未配置时默认16个线程
+static std::size_t dbThreadCount() {
+    auto thread_str = ConfigMgr::getInst()["DBExecutor"]["Threads"];
+    int count = thread_str.empty() ? 0 : atoi(thread_str.c_str());
+    return count > 0 ? count : 16;
+}
+
+DBExecutor::DBExecutor() : pool_(dbThreadCount()) {
+}
+
+DBExecutor::~DBExecutor() {
+    stop();
+}
+
+void DBExecutor::stop() {
+    pool_.stop();
+    pool_.join();
+}
@@ -0,0 +1,49 @@
+﻿#ifndef DBEXECUTOR_H
+#define DBEXECUTOR_H
+
+#include <type_traits>
+#include <boost/asio.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include "singleton.h"
+
+/******************************************************************************
+ * @file       dbexecutor.h
+ * @brief      阻塞的Redis/MySQL调用的执行线程池，配合协程使用：
+ *             调用方co_await挂起，调用在线程池中执行，完成后回到调用方的executor继续
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+namespace net = boost::asio;
+
+class DBExecutor : public Singleton<DBExecutor> {
+    friend class Singleton<DBExecutor>;
+public:
+    ~DBExecutor();
+    // 在线程池中执行func，返回可以co_await的结果
+    template <typename Func>
+    net::awaitable<std::invoke_result_t<Func>> run(Func func) {
+        using Result = std::invoke_result_t<Func>;
+        co_return co_await net::co_spawn(pool_,
+            [func = std::move(func)]() mutable -> net::awaitable<Result> {
+                co_return func();
+            }, net::use_awaitable);
+    }
+    // 在线程池中执行func，不等待结果
+    template <typename Func>
+    void post(Func func) {
+        net::post(pool_, std::move(func));
+    }
+    // 创建线程池上的strand，提交到同一个strand的任务按提交顺序依次执行
+    net::strand<net::thread_pool::executor_type> makeStrand() {
+        return net::make_strand(pool_.get_executor());
+    }
+    void stop();
+private:
+    DBExecutor();
+    net::thread_pool pool_;
+};
+
+#endif // DBEXECUTOR_H
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <thread>
 #include <cstdlib>
+#include <algorithm>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -76,4 +77,166 @@ bool DistLock::releaseLock(redisContext* context, const std::string& lockName,
         freeReplyObject(reply);
     }
     return success;
+}
+
+// 释放锁的脚本：标识匹配才删除
+static const char* RELEASE_SCRIPT = "if redis.call('get', KEYS[1]) == ARGV[1] then "
+    "return redis.call('del', KEYS[1]) else return 0 end";
+// 移交锁的脚本：标识匹配则重新设置过期时间
+static const char* RENEW_SCRIPT = "if redis.call('get', KEYS[1]) == ARGV[1] then "
+    "return redis.call('pexpire', KEYS[1], ARGV[2]) else return 0 end";
+
+net::awaitable<std::string> DistLock::asyncAcquireLock(std::shared_ptr<AsyncRedisClient> client,
+    const std::string& lockName, int lockTimeout, int acquireTimeout) {
+    std::string lockKey = "lock:" + lockName;
+    auto now = std::chrono::steady_clock::now();
+    auto deadline = now + std::chrono::seconds(acquireTimeout);
+    auto executor = co_await net::this_coro::executor;
+
+    std::shared_ptr<Waiter> waiter;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = local_locks_.find(lockKey);
+        if (iter == local_locks_.end() || now >= iter->second.expire_at) {
+            //本节点没有竞争者或原持有者已失效，由当前协程向redis获取
+            auto& local = local_locks_[lockKey];
+            local.identifier.clear();
+            local.lock_timeout = lockTimeout;
+            local.expire_at = deadline;
+        }
+        else {
+            waiter = std::make_shared<Waiter>();
+            waiter->timer = std::make_shared<net::steady_timer>(executor, deadline);
+            iter->second.waiters.push_back(waiter);
+        }
+    }
+
+    if (waiter) {
+        boost::system::error_code ec;
+        co_await waiter->timer->async_wait(net::redirect_error(net::use_awaitable, ec));
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (waiter->state == Waiter::State::Granted) {
+            co_return waiter->identifier;
+        }
+        if (waiter->state == Waiter::State::Waiting) {
+            //超时，从队列中移除
+            auto& waiters = local_locks_[lockKey].waiters;
+            waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter), waiters.end());
+            co_return "";
+        }
+        //Promoted：之前负责获取的协程超时放弃，由当前协程继续向redis获取
+        local_locks_[lockKey].expire_at = deadline;
+    }
+
+    auto identifier = co_await remoteAcquire(client, lockKey, lockTimeout, deadline);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& local = local_locks_[lockKey];
+    if (!identifier.empty()) {
+        local.identifier = identifier;
+        local.lock_timeout = lockTimeout;
+        local.expire_at = std::chrono::steady_clock::now() + std::chrono::seconds(lockTimeout);
+        co_return identifier;
+    }
+
+    //获取失败，交给下一个等待者继续尝试
+    if (local.waiters.empty()) {
+        local_locks_.erase(lockKey);
+    }
+    else {
+        auto next = local.waiters.front();
+        local.waiters.pop_front();
+        wakeLocked(next, Waiter::State::Promoted, "");
+    }
+    co_return "";
+}
+
+net::awaitable<bool> DistLock::asyncReleaseLock(std::shared_ptr<AsyncRedisClient> client,
+    const std::string& lockName, const std::string& identifier) {
+    std::string lockKey = "lock:" + lockName;
+    int lock_timeout = 0;
+    bool has_waiter = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = local_locks_.find(lockKey);
+        if (iter != local_locks_.end() && iter->second.identifier == identifier) {
+            lock_timeout = iter->second.lock_timeout;
+            has_waiter = !iter->second.waiters.empty();
+            if (!has_waiter) {
+                local_locks_.erase(iter);
+            }
+        }
+    }
+
+    if (!has_waiter) {
+        RedisCommand command{ "EVAL", RELEASE_SCRIPT, "1", lockKey, identifier };
+        boost::system::error_code ec;
+        auto result = co_await client->asyncCommand(std::move(command), net::redirect_error(net::use_awaitable, ec));
+        co_return !ec && result.type == REDIS_REPLY_INTEGER && result.integer == 1;
+    }
+
+    //本地还有等待者，续期后把同一个锁标识直接移交，省去等待者向redis的争抢
+    RedisCommand command{ "EVAL", RENEW_SCRIPT, "1", lockKey, identifier, std::to_string(lock_timeout * 1000) };
+    boost::system::error_code ec;
+    auto result = co_await client->asyncCommand(std::move(command), net::redirect_error(net::use_awaitable, ec));
+    bool renewed = !ec && result.type == REDIS_REPLY_INTEGER && result.integer == 1;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = local_locks_.find(lockKey);
+    if (iter == local_locks_.end()) {
+        co_return renewed;
+    }
+    auto& local = iter->second;
+    if (local.waiters.empty()) {
+        //等待者都已超时，锁仍在本节点手中，补一次释放
+        local_locks_.erase(iter);
+        RedisCommand del_command{ "EVAL", RELEASE_SCRIPT, "1", lockKey, identifier };
+        client->asyncCommand(std::move(del_command), [](boost::system::error_code, RedisResult) {});
+        co_return renewed;
+    }
+
+    auto next = local.waiters.front();
+    local.waiters.pop_front();
+    if (renewed) {
+        local.expire_at = std::chrono::steady_clock::now() + std::chrono::seconds(lock_timeout);
+        wakeLocked(next, Waiter::State::Granted, identifier);
+    }
+    else {
+        //锁已过期被他人拿走，下一个等待者重新向redis获取
+        local.identifier.clear();
+        wakeLocked(next, Waiter::State::Promoted, "");
+    }
+    co_return renewed;
+}
+
+net::awaitable<std::string> DistLock::remoteAcquire(std::shared_ptr<AsyncRedisClient> client,
+    const std::string& lockKey, int lockTimeout, std::chrono::steady_clock::time_point deadline) {
+    std::string identifier = generateUUID();
+    net::steady_timer timer(co_await net::this_coro::executor);
+    auto backoff = std::chrono::milliseconds(1);
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        // SET lockKey identifier NX EX lockTimeout
+        RedisCommand command{ "SET", lockKey, identifier, "NX", "EX", std::to_string(lockTimeout) };
+        boost::system::error_code ec;
+        auto result = co_await client->asyncCommand(std::move(command), net::redirect_error(net::use_awaitable, ec));
+        if (!ec && result.type == REDIS_REPLY_STATUS && result.str == "OK") {
+            co_return identifier;
+        }
+
+        //退避重试，最长间隔50毫秒，挂起期间不占用线程
+        timer.expires_after(backoff);
+        co_await timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+        backoff = std::min(backoff * 2, std::chrono::milliseconds(50));
+    }
+    co_return "";
+}
+
+void DistLock::wakeLocked(std::shared_ptr<Waiter> waiter, Waiter::State state, const std::string& identifier) {
+    waiter->state = state;
+    waiter->identifier = identifier;
+    //定时器不是线程安全的，投递到等待者的executor上让它立即到期
+    net::post(waiter->timer->get_executor(), [waiter]() {
+        waiter->timer->expires_at(net::steady_timer::time_point::min());
+    });
 }
\ No newline at end of file
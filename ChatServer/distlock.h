@@ -1,8 +1,13 @@
 ﻿#ifndef DISTLOCK_H
 #define DISTLOCK_H
 
+#include <deque>
+#include <mutex>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <hiredis.h>
+#include "../Common/asyncredis.h"
 
 /******************************************************************************
  * @file       distlock.h
@@ -23,8 +28,41 @@ public:
 
     bool releaseLock(redisContext* context, const std::string& lockName,
         const std::string& identifier);
+
+    // 协程版本：重试由定时器驱动，不占用线程和连接；
+    // 本节点已有协程持有或正在获取同名锁时在本地排队，释放时直接移交给下一个等待者
+    net::awaitable<std::string> asyncAcquireLock(std::shared_ptr<AsyncRedisClient> client,
+        const std::string& lockName, int lockTimeout, int acquireTimeout);
+    net::awaitable<bool> asyncReleaseLock(std::shared_ptr<AsyncRedisClient> client,
+        const std::string& lockName, const std::string& identifier);
 private:
     DistLock() = default;
+
+    // 本地排队的等待者
+    struct Waiter {
+        enum class State { Waiting, Granted, Promoted };
+        State state = State::Waiting;
+        std::string identifier;     // 移交得到的锁标识
+        std::shared_ptr<net::steady_timer> timer;   // 超时或被唤醒时结束等待
+    };
+
+    // 本节点上同名锁的状态，存在即表示有协程持有或正在向redis获取
+    struct LocalLock {
+        std::string identifier;     // 为空表示正在向redis获取
+        int lock_timeout = 0;
+        // 持有者的锁过期时间或获取者的放弃时间，超过后视为失效，防止持有者未释放导致本地一直排队
+        std::chrono::steady_clock::time_point expire_at;
+        std::deque<std::shared_ptr<Waiter>> waiters;
+    };
+
+    // 向redis获取锁，失败时按退避间隔重试直到deadline
+    net::awaitable<std::string> remoteAcquire(std::shared_ptr<AsyncRedisClient> client,
+        const std::string& lockKey, int lockTimeout, std::chrono::steady_clock::time_point deadline);
+    // 唤醒等待者，调用时需持有mutex_
+    void wakeLocked(std::shared_ptr<Waiter> waiter, Waiter::State state, const std::string& identifier);
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, LocalLock> local_locks_;
 };
 
 #endif // DISTLOCK_H
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "logicnodepool.h"
+
+/******************************************************************************
+ * @file       logicnodepool.cpp
+ * @brief      接收消息节点池实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 最后一个引用释放时执行：断开会话引用，把节点放回空闲链表
+struct LogicNodeReleaser {
+    std::shared_ptr<LogicNodeFreeList> free_list;
+
+    void operator()(LogicNode* node) const {
+        node->session_.reset();
+        std::lock_guard<std::mutex> lock(free_list->mutex_);
+        free_list->nodes_.push_back(node);
+    }
+};
+
+LogicNodePool::LogicNodePool() : free_list_(std::make_shared<LogicNodeFreeList>()), created_(0) {
+    free_list_->nodes_.reserve(LOGIC_NODE_POOL_SIZE);
+    free_list_->blocks_.reserve(LOGIC_NODE_POOL_SIZE);
+}
+
+LogicNodePool::~LogicNodePool() {
+}
+
+LogicNodePool& LogicNodePool::local() {
+    thread_local LogicNodePool pool;
+    return pool;
+}
+
+std::shared_ptr<LogicNode> LogicNodePool::acquire(short msg_id) {
+    LogicNode* node = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(free_list_->mutex_);
+        if (!free_list_->nodes_.empty()) {
+            node = free_list_->nodes_.back();
+            free_list_->nodes_.pop_back();
+        }
+    }
+
+    if (node == nullptr) {
+        // 池满时退化为普通分配，节点用完直接释放
+        if (created_ >= LOGIC_NODE_POOL_SIZE) {
+            return std::make_shared<LogicNode>(nullptr, std::make_shared<RecvNode>(MAX_LENGTH, msg_id));
+        }
+        node = new LogicNode(nullptr, std::make_shared<RecvNode>(MAX_LENGTH, msg_id));
+        ++created_;
+    }
+    else {
+        // 归还时在锁内入链，这里在锁内取出，逻辑线程对缓冲区的读取已经结束
+        node->recvnode_->reset(msg_id);
+    }
+    return std::shared_ptr<LogicNode>(node, LogicNodeReleaser{ free_list_ },
+        NodeBlockAllocator<LogicNode, LogicNode>(free_list_));
+}
@@ -0,0 +1,36 @@
+#ifndef LOGICNODEPOOL_H
+#define LOGICNODEPOOL_H
+
+#include <vector>
+#include <memory>
+#include "csession.h"
+#include "nodepool.h"
+
+/******************************************************************************
+ * @file       logicnodepool.h
+ * @brief      接收消息节点池，消息体直接读入池中节点，避免每条消息分配和拷贝；
+ *             节点通过shared_ptr的删除器显式归还到空闲链表，
+ *             控制块也从池中复用，稳定运行后每条消息不再有堆分配
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 空闲节点和控制块链表，io线程取出、逻辑线程归还
+using LogicNodeFreeList = NodeFreeList<LogicNode>;
+
+class LogicNodePool {
+public:
+    ~LogicNodePool();
+    // 获取当前io线程的节点池，每个io_context由一个线程驱动，即每个io_context一个池
+    static LogicNodePool& local();
+    // 取出一个空闲节点，节点缓冲区容量为MAX_LENGTH，最后一个引用释放时归还到池中
+    std::shared_ptr<LogicNode> acquire(short msg_id);
+private:
+    LogicNodePool();
+    std::shared_ptr<LogicNodeFreeList> free_list_;
+    std::size_t created_;   // 池创建的节点数，不超过LOGIC_NODE_POOL_SIZE
+};
+
+#endif // LOGICNODEPOOL_H
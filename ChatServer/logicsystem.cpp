@@ -1,4 +1,5 @@
 ﻿#include "logicsystem.h"
+#include <limits>
 #include "statusgrpcclient.h"
 #include "mysqlmgr.h"
 #include "configmgr.h"
@@ -8,6 +9,13 @@
 #include "chatgrpcclient.h"
 #include "cserver.h"
 #include "utils.h"
+#include "msgcodec.h"
+#include "../Common/jsonutil.h"
+#include "usercache.h"
+#include "peerrouter.h"
+#include "chatmsgwriter.h"
+#include "msgidallocator.h"
+#include "threadmsgcache.h"
 
 /******************************************************************************
  * @file       logicsystem.cpp
@@ -18,148 +26,208 @@
  * @history
  *****************************************************************************/
 
-LogicSystem::LogicSystem() :b_stop_(false) {
+// 好友列表版本和读取mysql之前一致时才写入快照，期间好友关系变化过则放弃，
+// 避免在变化之前读到的旧列表覆盖删除后的快照
+// KEYS: 快照, 版本  ARGV: 快照内容, 过期时间, 读取mysql之前的版本
+static const std::string FRIEND_SNAPSHOT_SCRIPT =
+    "local ver = redis.call('GET', KEYS[2]) or '' "
+    "if ver ~= ARGV[3] then return 0 end "
+    "redis.call('SET', KEYS[1], ARGV[1], 'EX', ARGV[2]) "
+    "return 1";
+
+LogicSystem::LogicSystem() {
     registerCallBacks();
-    worker_thread_ = std::thread(&LogicSystem::dealMsg, this);
+    auto worker_str = ConfigMgr::getInst()["LogicSystem"]["WorkerCount"];
+    int worker_count = worker_str.empty() ? LOGIC_WORKER_COUNT : atoi(worker_str.c_str());
+    if (worker_count <= 0) {
+        worker_count = LOGIC_WORKER_COUNT;
+    }
+    for (int i = 0; i < worker_count; ++i) {
+        workers_.push_back(std::make_unique<LogicWorker>(i, fun_callbacks_));
+    }
+    std::cout << "LogicSystem start " << worker_count << " workers" << std::endl;
 }
 
 LogicSystem::~LogicSystem() {
-    b_stop_ = true;
-    consume_.notify_one();
-    worker_thread_.join();
+    for (auto& worker : workers_) {
+        worker->stop();
+    }
 }
 
+// 投递和协程结束都在会话的io线程中执行，会话的路由状态无需加锁
 void LogicSystem::postMsgToQue(std::shared_ptr <LogicNode> msg) {
-	std::unique_lock<std::mutex> unique_lk(mutex_);
-	msg_queue_.push(msg);
-	//由0变为1则发送通知信号
-	if (msg_queue_.size() == 1) {
-		unique_lk.unlock();
-		consume_.notify_one();
+	auto& session = msg->session_;
+	//协程回调执行期间后续消息先暂存，结束后按到达顺序处理，同一会话的消息不会乱序
+	if (session->async_running_) {
+		if (session->held_msgs_.size() >= MAX_HELD_MSGS) {
+			std::cout << "session: " << session->getUuid() << " held msgs fulled, size is " << MAX_HELD_MSGS << std::endl;
+			session->close();
+			return;
+		}
+		session->held_msgs_.push_back(std::move(msg));
+		return;
+	}
+	dispatchMsg(std::move(msg));
+}
+
+// 只有心跳留在工作线程处理，它和协程回调之间没有顺序要求
+void LogicSystem::dispatchMsg(std::shared_ptr<LogicNode> msg) {
+	auto msg_id = msg->recvnode_->msg_id_;
+	auto async_iter = async_callbacks_.find(msg_id);
+	if (async_iter == async_callbacks_.end()) {
+		workers_[selectWorker(msg->session_)]->postTask(std::move(msg));
+		return;
 	}
+
+	//协程回调直接在会话的io_context上启动，阻塞调用交给DBExecutor，不占用逻辑工作线程
+	//协程会挂起，消息体需要拷贝一份，节点随即归还到节点池
+	auto session = std::move(msg->session_);
+	session->async_running_ = true;
+	net::co_spawn(session->getSocket().get_executor(),
+		async_iter->second(session, msg_id,
+			std::string(msg->recvnode_->data_, msg->recvnode_->cur_len_)),
+		[this, session, msg_id](std::exception_ptr e) {
+			//依次处理暂存的消息，遇到下一个协程回调时停下，等它结束后继续
+			session->async_running_ = false;
+			while (!session->async_running_ && !session->held_msgs_.empty()) {
+				auto held = std::move(session->held_msgs_.front());
+				session->held_msgs_.pop_front();
+				dispatchMsg(std::move(held));
+			}
+			if (!e) {
+				return;
+			}
+			try {
+				std::rethrow_exception(e);
+			}
+			catch (std::exception& ex) {
+				std::cout << "async handle msg id [" << msg_id << "] exception: " << ex.what() << std::endl;
+			}
+		});
 }
 
 void LogicSystem::setServer(std::shared_ptr<CServer> pserver) {
 	p_server_ = pserver;
 }
 
+std::vector<LogicWorkerStats> LogicSystem::getWorkerStats() {
+	std::vector<LogicWorkerStats> stats;
+	for (auto& worker : workers_) {
+		stats.push_back(worker->getStats());
+	}
+	return stats;
+}
 
-void LogicSystem::dealMsg() {
-	for (;;) {
-		std::unique_lock<std::mutex> unique_lk(mutex_);
-		//判断队列为空则用条件变量阻塞等待，并释放锁
-		while (msg_queue_.empty() && !b_stop_) {
-			consume_.wait(unique_lk);
-		}
-
-		//判断是否为关闭状态，把所有逻辑执行完后则退出循环
-		if (b_stop_) {
-			while (!msg_queue_.empty()) {
-				auto msg_node = msg_queue_.front();
-				std::cout << "recv_msg id  is " << msg_node->recvnode_->msg_id_ << std::endl;
-				auto call_back_iter = fun_callbacks_.find(msg_node->recvnode_->msg_id_);
-				if (call_back_iter == fun_callbacks_.end()) {
-					msg_queue_.pop();
-					continue;
-				}
-				// 调用该消息的回调函数
-				call_back_iter->second(msg_node->session_, msg_node->recvnode_->msg_id_,
-					std::string(msg_node->recvnode_->data_, msg_node->recvnode_->cur_len_));
-				msg_queue_.pop();
-			}
-			break;
-		}
-
-		//如果没有停服，且说明队列中有数据
-		auto msg_node = msg_queue_.front();
-		std::cout << "recv_msg id  is " << msg_node->recvnode_->msg_id_ << std::endl;
-		auto call_back_iter = fun_callbacks_.find(msg_node->recvnode_->msg_id_);
-		if (call_back_iter == fun_callbacks_.end()) {
-			msg_queue_.pop();
-			std::cout << "msg id [" << msg_node->recvnode_->msg_id_ << "] handler not found" << std::endl;
-			continue;
-		}
-		// std::function 重载了 () 运算符
-		call_back_iter->second(msg_node->session_, msg_node->recvnode_->msg_id_,
-			std::string(msg_node->recvnode_->data_, msg_node->recvnode_->cur_len_));
-		msg_queue_.pop();
+// 会话在生命周期内固定使用一个工作线程，否则登录后改按uid散列时，
+// 已在按uuid选定的线程中排队的消息可能被后发的消息超过
+// 登录后才选定的会话按uid分配，同一用户的多个连接也落在同一个工作线程上
+std::size_t LogicSystem::selectWorker(std::shared_ptr<CSession> session) {
+	if (session->worker_index_ >= 0) {
+		return session->worker_index_;
+	}
+	auto uid = session->getUserId();
+	std::size_t hash_value = 0;
+	if (uid > 0) {
+		hash_value = std::hash<int>()(uid);
+	}
+	else {
+		hash_value = std::hash<std::string>()(session->getUuid());
 	}
+	session->worker_index_ = static_cast<int>(hash_value % workers_.size());
+	return session->worker_index_;
 }
 
 void LogicSystem::registerCallBacks() {
 	// 注册聊天登录回调函数
-    fun_callbacks_[MSG_CHAT_LOGIN] = std::bind(&LogicSystem::loginHandler, this,
+    async_callbacks_[MSG_CHAT_LOGIN] = std::bind(&LogicSystem::loginHandler, this,
         std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
     // 注册搜索好友回调函数
-	fun_callbacks_[ID_SEARCH_USER_REQ] = std::bind(&LogicSystem::searchInfo, this,
+	async_callbacks_[ID_SEARCH_USER_REQ] = std::bind(&LogicSystem::searchInfo, this,
 		std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 	// 注册添加好友回调函数
-	fun_callbacks_[ID_ADD_FRIEND_REQ] = std::bind(&LogicSystem::addFriendApply, this,
+	async_callbacks_[ID_ADD_FRIEND_REQ] = std::bind(&LogicSystem::addFriendApply, this,
 		std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 	// 注册同意添加好友信息回调函数
-	fun_callbacks_[ID_AUTH_FRIEND_REQ] = std::bind(&LogicSystem::authFriendApply, this,
+	async_callbacks_[ID_AUTH_FRIEND_REQ] = std::bind(&LogicSystem::authFriendApply, this,
 		std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 	// 注册文本聊天消息回调函数
-	fun_callbacks_[ID_TEXT_CHAT_MSG_REQ] = std::bind(&LogicSystem::dealChatTextMsg, this,
+	async_callbacks_[ID_TEXT_CHAT_MSG_REQ] = std::bind(&LogicSystem::dealChatTextMsg, this,
 		std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 	// 注册心跳处理回调函数
 	fun_callbacks_[ID_HEART_BEAT_REQ] = std::bind(&LogicSystem::heartBeatHandler, this,
 		placeholders::_1, placeholders::_2, placeholders::_3);
 	// 注册加载聊天线程回调函数
-	fun_callbacks_[ID_LOAD_CHAT_THREAD_REQ] = std::bind(&LogicSystem::getUserThreadsHandler, this,
+	async_callbacks_[ID_LOAD_CHAT_THREAD_REQ] = std::bind(&LogicSystem::getUserThreadsHandler, this,
 		placeholders::_1, placeholders::_2, placeholders::_3);
 	// 注册创建私聊回调函数
-	fun_callbacks_[ID_CREATE_PRIVATE_CHAT_REQ] = std::bind(&LogicSystem::createPrivateChat, this,
+	async_callbacks_[ID_CREATE_PRIVATE_CHAT_REQ] = std::bind(&LogicSystem::createPrivateChat, this,
 		placeholders::_1, placeholders::_2, placeholders::_3);
 	// 注册加载聊天消息回调函数
-	fun_callbacks_[ID_LOAD_CHAT_MSG_REQ] = std::bind(&LogicSystem::loadChatMsg, this,
+	async_callbacks_[ID_LOAD_CHAT_MSG_REQ] = std::bind(&LogicSystem::loadChatMsg, this,
 		placeholders::_1, placeholders::_2, placeholders::_3);
 	// 注册图片聊天消息回调函数
-	fun_callbacks_[ID_IMG_CHAT_MSG_REQ] = std::bind(&LogicSystem::dealChatImgMsg, this,
+	async_callbacks_[ID_IMG_CHAT_MSG_REQ] = std::bind(&LogicSystem::dealChatImgMsg, this,
 		placeholders::_1, placeholders::_2, placeholders::_3);
 }
 
 // 聊天登录回调函数
-void LogicSystem::loginHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data) {
-	Json::Reader reader;
+net::awaitable<void> LogicSystem::loginHandler(std::shared_ptr<CSession> session, short msg_id, std::string msg_data) {
 	Json::Value root;
-	reader.parse(msg_data, root);
+	parseJson(msg_data, root);
 	auto uid = root["uid"].asInt();
 	auto token = root["token"].asString();
+	//客户端可以请求使用protobuf编码后续的高频消息，老客户端不带该字段则继续使用json
+	auto codec = root["codec"].asString();
 	std::cout << "user login uid is  " << uid << " user token  is "
 		<< token << endl;
 
 	Json::Value  rtvalue;
 	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
+		std::string return_str = toJsonString(rtvalue);
 		session->send(return_str, MSG_CHAT_LOGIN_RSP);
 		});
 
+	auto db = DBExecutor::getInstance();
+	auto redis = RedisMgr::getInstance();
 
-	//从redis获取用户token是否正确
+	//token、缓存的用户信息、好友列表快照及其版本用一次MGET取回
 	std::string uid_str = std::to_string(uid);
 	std::string token_key = USERTOKENPREFIX + uid_str;
-	std::string token_value = "";
-	bool success = RedisMgr::getInstance()->get(token_key, token_value);
-	if (!success) {
+	std::string base_key = USER_BASE_INFO + uid_str;
+	std::string friend_key = FRIEND_LIST_PREFIX + uid_str;
+	std::string friend_ver_key = FRIEND_VERSION_PREFIX + uid_str;
+	std::vector<std::string> login_keys{ token_key, base_key, friend_key, friend_ver_key };
+	std::vector<std::optional<std::string>> login_values;
+	bool success = co_await redis->asyncMGet(login_keys, login_values);
+	//从redis获取用户token是否正确
+	if (!success || !login_values[0]) {
 		rtvalue["error"] = ErrorCodes::UidInvalid;
-		return;
+		co_return;
 	}
 
-	if (token_value != token) {
+	if (*login_values[0] != token) {
 		rtvalue["error"] = ErrorCodes::TokenInvalid;
-		return;
+		co_return;
 	}
 
 	rtvalue["error"] = ErrorCodes::Success;
 
-
-	std::string base_key = USER_BASE_INFO + uid_str;
 	auto user_info = std::make_shared<UserInfo>();
-	bool b_base = getBaseInfo(base_key, uid, user_info);
-	if (!b_base) {
-		rtvalue["error"] = ErrorCodes::UidInvalid;
-		return;
+	if (UserCache::getInstance()->get(uid, *user_info)) {
+		//进程内缓存命中
+	}
+	else if (login_values[1]) {
+		parseBaseInfo(*login_values[1], user_info);
+	}
+	else {
+		//redis中没有则查询mysql
+		bool b_base = co_await db->run([this, base_key, uid, &user_info]() {
+			return loadBaseInfo(base_key, uid, user_info);
+			});
+		if (!b_base) {
+			rtvalue["error"] = ErrorCodes::UidInvalid;
+			co_return;
+		}
 	}
 	rtvalue["uid"] = uid;
 	rtvalue["pwd"] = user_info->pwd;
@@ -173,7 +241,7 @@ void LogicSystem::loginHandler(std::shared_ptr<CSession> session, const short& m
 
 	//从数据库获取申请列表
 	std::vector<std::shared_ptr<ApplyInfo>> apply_list;
-	auto b_apply = getFriendApplyInfo(uid, apply_list);
+	auto b_apply = co_await MysqlMgr::getInstance()->asyncGetApplyList(uid, apply_list, 0, 10);
 	if (b_apply) {
 		for (auto& apply : apply_list) {
 			Json::Value obj;
@@ -188,43 +256,69 @@ void LogicSystem::loginHandler(std::shared_ptr<CSession> session, const short& m
 		}
 	}
 
-	//获取好友列表
-	std::vector<std::shared_ptr<UserInfo>> friend_list;
-	bool b_friend_list = getFriendList(uid, friend_list);
-	for (auto& friend_ele : friend_list) {
-		Json::Value obj;
-		obj["name"] = friend_ele->name;
-		obj["uid"] = friend_ele->uid;
-		obj["icon"] = friend_ele->icon;
-		obj["nick"] = friend_ele->nick;
-		obj["sex"] = friend_ele->sex;
-		obj["desc"] = friend_ele->desc;
-		obj["back"] = friend_ele->back;
-		rtvalue["friend_list"].append(obj);
+	//获取好友列表，优先使用redis中的快照
+	Json::Value friend_snapshot;
+	if (login_values[2] && parseJson(*login_values[2], friend_snapshot) && friend_snapshot.isArray()) {
+		if (!friend_snapshot.empty()) {
+			rtvalue["friend_list"] = friend_snapshot;
+		}
+	}
+	else {
+		//快照不存在则分页从mysql加载，并写回快照
+		friend_snapshot = Json::Value(Json::arrayValue);
+		bool b_friend = true;
+		int after_uid = 0;
+		for (;;) {
+			std::vector<std::shared_ptr<UserInfo>> friend_list;
+			b_friend = co_await MysqlMgr::getInstance()->asyncGetFriendList(uid, friend_list,
+				after_uid, FRIEND_LIST_PAGE_SIZE);
+			if (!b_friend) {
+				break;
+			}
+			for (auto& friend_ele : friend_list) {
+				Json::Value obj;
+				obj["name"] = friend_ele->name;
+				obj["uid"] = friend_ele->uid;
+				obj["icon"] = friend_ele->icon;
+				obj["nick"] = friend_ele->nick;
+				obj["sex"] = friend_ele->sex;
+				obj["desc"] = friend_ele->desc;
+				obj["back"] = friend_ele->back;
+				friend_snapshot.append(obj);
+			}
+			if (friend_list.size() < FRIEND_LIST_PAGE_SIZE) {
+				break;
+			}
+			after_uid = friend_list.back()->uid;
+		}
+		if (!friend_snapshot.empty()) {
+			rtvalue["friend_list"] = friend_snapshot;
+		}
+		//加载失败时不写快照，避免缓存不完整的列表；版本在加载前随MGET读取
+		if (b_friend) {
+			std::vector<RedisCommand> commands{ { "EVAL", FRIEND_SNAPSHOT_SCRIPT, "2", friend_key, friend_ver_key,
+				toJsonString(friend_snapshot), std::to_string(FRIEND_LIST_TTL), login_values[3].value_or("") } };
+			std::vector<RedisResult> results;
+			co_await redis->asyncPipeline(std::move(commands), results);
+		}
 	}
 
 	auto server_name = ConfigMgr::getInst().getValue("SelfServer", "Name");
-	{
-		//此处添加分布式锁，让该线程独占登录
-		//拼接用户ip对应的key
-		auto lock_key = LOCK_PREFIX + uid_str;
-		auto identifier = RedisMgr::getInstance()->acquireLock(lock_key, LOCK_TIME_OUT, ACQUIRE_TIME_OUT);
-		//利用defer解锁
-		Defer defer2([this, identifier, lock_key]() {
-			RedisMgr::getInstance()->releaseLock(lock_key, identifier);
-			});
+	//此处添加分布式锁，让该协程独占登录
+	//拼接用户ip对应的key
+	auto lock_key = LOCK_PREFIX + uid_str;
+	auto identifier = co_await redis->asyncAcquireLock(lock_key, LOCK_TIME_OUT, ACQUIRE_TIME_OUT);
+	//析构函数中不能co_await，异常先暂存，解锁后再抛出
+	std::exception_ptr eptr;
+	try {
 		//此处判断该用户是否在别处或者本服务器登录
-
 		std::string uid_ip_value = "";
 		auto uid_ip_key = USERIPPREFIX + uid_str;
-		bool b_ip = RedisMgr::getInstance()->get(uid_ip_key, uid_ip_value);
+		bool b_ip = co_await redis->asyncGet(uid_ip_key, uid_ip_value);
 		//说明用户已经登录了，此处应该踢掉之前的用户登录状态
 		if (b_ip) {
-			//获取当前服务器ip信息
-			auto& cfg = ConfigMgr::getInst();
-			auto self_name = cfg["SelfServer"]["Name"];
 			//如果之前登录的服务器和当前相同，则直接在本服务器踢掉
-			if (uid_ip_value == self_name) {
+			if (uid_ip_value == server_name) {
 				//查找旧有的连接
 				auto old_session = UserMgr::getInstance()->getSession(uid);
 
@@ -237,58 +331,68 @@ void LogicSystem::loginHandler(std::shared_ptr<CSession> session, const short& m
 
 			}
 			else {
-				//如果不是本服务器，则通知grpc通知其他服务器踢掉
-				//发送通知
+				//如果不是本服务器，则通知其他服务器踢掉，不等待对端处理完成
 				KickUserReq kick_req;
 				kick_req.set_uid(uid);
-				ChatGrpcClient::getInstance()->notifyKickUser(uid_ip_value, kick_req);
+				PeerRouter::getInstance()->notifyKickUser(uid_ip_value, kick_req);
 			}
 		}
 
-		//session绑定用户uid
+		//session绑定用户uid，尚未选定的工作线程在登录完成后按uid选定
 		session->setUserId(uid);
-		//为用户设置登录ip server的名字
-		std::string  ipkey = USERIPPREFIX + uid_str;
-		RedisMgr::getInstance()->set(ipkey, server_name);
+		if (codec == "protobuf") {
+			session->setCodec(CODEC_PROTOBUF);
+			rtvalue["codec"] = codec;
+		}
 		//uid和session绑定管理,方便以后踢人操作
 		UserMgr::getInstance()->setUserSession(uid, session);
+		//登录服务器的名字和session id用一次MSET写入
 		std::string  uid_session_key = USER_SESSION_PREFIX + uid_str;
-		RedisMgr::getInstance()->set(uid_session_key, session->getUuid());
-
+		std::vector<std::pair<std::string, std::string>> login_kvs{
+			{ uid_ip_key, server_name }, { uid_session_key, session->getUuid() } };
+		co_await redis->asyncMSet(login_kvs);
+	}
+	catch (...) {
+		eptr = std::current_exception();
+	}
+	co_await redis->asyncReleaseLock(lock_key, identifier);
+	if (eptr) {
+		std::rethrow_exception(eptr);
 	}
 
-	return;
+	co_return;
 }
 
 // 查找好友回调函数：根据用户uid查询具体信息
-void LogicSystem::searchInfo(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data) {
-	Json::Reader reader;
+net::awaitable<void> LogicSystem::searchInfo(std::shared_ptr<CSession> session, short msg_id, std::string msg_data) {
 	Json::Value root;
-	reader.parse(msg_data, root);
+	parseJson(msg_data, root);
 	auto uid_str = root["uid"].asString();
 	std::cout << "user SearchInfo uid is  " << uid_str << std::endl;
 
 	Json::Value rtvalue;
 
 	Defer deder([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
+		std::string return_str = toJsonString(rtvalue);
 		session->send(return_str, ID_SEARCH_USER_RSP);
 		});
 
-	bool b_digit = isPureDigit(uid_str);
-	if (b_digit) {
-		getUserByUid(uid_str, rtvalue);
-	}
-	else {
-		getUserByName(uid_str, rtvalue);
-	}
+	//依次查进程内缓存、redis和mysql，在DBExecutor中执行
+	co_await DBExecutor::getInstance()->run([this, &uid_str, &rtvalue]() {
+		bool b_digit = isPureDigit(uid_str);
+		if (b_digit) {
+			getUserByUid(uid_str, rtvalue);
+		}
+		else {
+			getUserByName(uid_str, rtvalue);
+		}
+		});
 }
 
 // 添加好友回调函数
-void LogicSystem::addFriendApply(std::shared_ptr<CSession> session, const short& msg_id, const string& msg_data) {
-	Json::Reader reader;
+net::awaitable<void> LogicSystem::addFriendApply(std::shared_ptr<CSession> session, short msg_id, std::string msg_data) {
 	Json::Value root;
-	reader.parse(msg_data, root);
+	parseJson(msg_data, root);
 	auto uid = root["uid"].asInt();
 	auto desc = root["applyname"].asString();
 	auto bakname = root["bakname"].asString();
@@ -299,20 +403,23 @@ void LogicSystem::addFriendApply(std::shared_ptr<CSession> session, const short&
 	Json::Value  rtvalue;
 	rtvalue["error"] = ErrorCodes::Success;
 	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
+		std::string return_str = toJsonString(rtvalue);
 		session->send(return_str, ID_ADD_FRIEND_RSP);
 		});
 
+	auto db = DBExecutor::getInstance();
 	//先更新数据库
-	MysqlMgr::getInstance()->addFriendApply(uid, touid, desc, bakname);
+	co_await db->run([uid, touid, &desc, &bakname]() {
+		MysqlMgr::getInstance()->addFriendApply(uid, touid, desc, bakname);
+		});
 
 	//查询redis 查找touid对应的server ip
 	auto to_str = std::to_string(touid);
 	auto to_ip_key = USERIPPREFIX + to_str;
 	std::string to_ip_value = "";
-	bool b_ip = RedisMgr::getInstance()->get(to_ip_key, to_ip_value);
+	bool b_ip = co_await RedisMgr::getInstance()->asyncGet(to_ip_key, to_ip_value);
 	if (!b_ip) {
-		return;
+		co_return;
 	}
 
 
@@ -322,7 +429,9 @@ void LogicSystem::addFriendApply(std::shared_ptr<CSession> session, const short&
 
 	std::string base_key = USER_BASE_INFO + std::to_string(uid);
 	auto apply_info = std::make_shared<UserInfo>();
-	bool b_info = getBaseInfo(base_key, uid, apply_info);
+	bool b_info = co_await db->run([this, &base_key, uid, &apply_info]() {
+		return getBaseInfo(base_key, uid, apply_info);
+		});
 
 	//直接通知对方有申请消息
 	if (to_ip_value == self_name) {
@@ -339,11 +448,11 @@ void LogicSystem::addFriendApply(std::shared_ptr<CSession> session, const short&
 				notify["sex"] = apply_info->sex;
 				notify["nick"] = apply_info->nick;
 			}
-			std::string return_str = notify.toStyledString();
+			std::string return_str = toJsonString(notify);
 			session->send(return_str, ID_NOTIFY_ADD_FRIEND_REQ);
 		}
 
-		return;
+		co_return;
 	}
 
 
@@ -358,17 +467,17 @@ void LogicSystem::addFriendApply(std::shared_ptr<CSession> session, const short&
 		add_req.set_nick(apply_info->nick);
 	}
 
-	//发送通知
-	ChatGrpcClient::getInstance()->notifyAddFriend(to_ip_value, add_req);
-
+	//发送通知，grpc模式下是阻塞调用
+	co_await db->run([&to_ip_value, &add_req]() {
+		PeerRouter::getInstance()->notifyAddFriend(to_ip_value, add_req);
+		});
 }
 
 // 同意好友申请信息回调函数
-void LogicSystem::authFriendApply(std::shared_ptr<CSession> session, const short& msg_id, const string& msg_data) {
+net::awaitable<void> LogicSystem::authFriendApply(std::shared_ptr<CSession> session, short msg_id, std::string msg_data) {
 
-	Json::Reader reader;
 	Json::Value root;
-	reader.parse(msg_data, root);
+	parseJson(msg_data, root);
 
 	auto uid = root["fromuid"].asInt();
 	auto touid = root["touid"].asInt();
@@ -379,8 +488,11 @@ void LogicSystem::authFriendApply(std::shared_ptr<CSession> session, const short
 	rtvalue["error"] = ErrorCodes::Success;
 	auto user_info = std::make_shared<UserInfo>();
 
+	auto db = DBExecutor::getInstance();
 	std::string base_key = USER_BASE_INFO + std::to_string(touid);
-	bool b_info = getBaseInfo(base_key, touid, user_info);
+	bool b_info = co_await db->run([this, &base_key, touid, &user_info]() {
+		return getBaseInfo(base_key, touid, user_info);
+		});
 	if (b_info) {
 		rtvalue["name"] = user_info->name;
 		rtvalue["nick"] = user_info->nick;
@@ -394,7 +506,7 @@ void LogicSystem::authFriendApply(std::shared_ptr<CSession> session, const short
 
 
 	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
+		std::string return_str = toJsonString(rtvalue);
 		session->send(return_str, ID_AUTH_FRIEND_RSP);
 		});
 
@@ -404,15 +516,34 @@ void LogicSystem::authFriendApply(std::shared_ptr<CSession> session, const short
 	std::vector<std::shared_ptr<AddFriendMsg>> chat_datas;
 
 	//更新数据库添加好友
-	MysqlMgr::getInstance()->addFriend(uid, touid, back_name, chat_datas);
+	co_await db->run([uid, touid, &back_name, &chat_datas]() {
+		bool b_add = MysqlMgr::getInstance()->addFriend(uid, touid, back_name, chat_datas);
+		if (!b_add) {
+			return;
+		}
+		//好友通知消息直接写入了mysql，删除会话的消息缓存
+		if (!chat_datas.empty()) {
+			ThreadMsgCache::getInstance()->invalidate(chat_datas.front()->thread_id());
+		}
+		//双方的好友列表都变了，先递增版本使正在加载的旧列表无法写回，再删除快照
+		std::vector<RedisCommand> commands;
+		for (auto friend_uid : { uid, touid }) {
+			auto ver_key = FRIEND_VERSION_PREFIX + std::to_string(friend_uid);
+			commands.push_back({ "INCR", ver_key });
+			commands.push_back({ "EXPIRE", ver_key, std::to_string(FRIEND_VERSION_TTL) });
+			commands.push_back({ "DEL", FRIEND_LIST_PREFIX + std::to_string(friend_uid) });
+		}
+		std::vector<RedisResult> results;
+		RedisMgr::getInstance()->pipeline(commands, results);
+		});
 
 	//查询redis 查找touid对应的server ip
 	auto to_str = std::to_string(touid);
 	auto to_ip_key = USERIPPREFIX + to_str;
 	std::string to_ip_value = "";
-	bool b_ip = RedisMgr::getInstance()->get(to_ip_key, to_ip_value);
+	bool b_ip = co_await RedisMgr::getInstance()->asyncGet(to_ip_key, to_ip_value);
 	if (!b_ip) {
-		return;
+		co_return;
 	}
 
 	auto& cfg = ConfigMgr::getInst();
@@ -428,7 +559,9 @@ void LogicSystem::authFriendApply(std::shared_ptr<CSession> session, const short
 			notify["touid"] = touid;
 			std::string base_key = USER_BASE_INFO + std::to_string(uid);
 			auto user_info = std::make_shared<UserInfo>();
-			bool b_info = getBaseInfo(base_key, uid, user_info);
+			bool b_info = co_await db->run([this, &base_key, uid, &user_info]() {
+				return getBaseInfo(base_key, uid, user_info);
+				});
 			if (b_info) {
 				notify["name"] = user_info->name;
 				notify["nick"] = user_info->nick;
@@ -451,11 +584,11 @@ void LogicSystem::authFriendApply(std::shared_ptr<CSession> session, const short
 				rtvalue["chat_datas"].append(chat);
 			}
 
-			std::string return_str = notify.toStyledString();
+			std::string return_str = toJsonString(notify);
 			session->send(return_str, ID_NOTIFY_AUTH_FRIEND_REQ);
 		}
 
-		return;
+		co_return;
 	}
 
 
@@ -474,32 +607,44 @@ void LogicSystem::authFriendApply(std::shared_ptr<CSession> session, const short
 		chat["msg_content"] = chat_data->msgcontent();
 		rtvalue["chat_datas"].append(chat);
 	}
-	//发送通知
-	ChatGrpcClient::getInstance()->notifyAuthFriend(to_ip_value, auth_req);
+	//发送通知，grpc模式下是阻塞调用
+	co_await db->run([&to_ip_value, &auth_req]() {
+		PeerRouter::getInstance()->notifyAuthFriend(to_ip_value, auth_req);
+		});
 }
 
 // 发送信息回调函数
-void LogicSystem::dealChatTextMsg(std::shared_ptr<CSession> session, const short& msg_id, const string& msg_data) {
-	Json::Reader reader;
-	Json::Value root;
-	reader.parse(msg_data, root);
-
-	auto uid = root["fromuid"].asInt();
-	auto touid = root["touid"].asInt();
+net::awaitable<void> LogicSystem::dealChatTextMsg(std::shared_ptr<CSession> session, short msg_id, std::string msg_data) {
+	//按会话协商的编码解析请求
+	ClientTextChatMsgReq req;
+	if (session->getCodec() == CODEC_PROTOBUF) {
+		if (!req.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
+			std::cout << "parse text chat msg failed" << std::endl;
+			co_return;
+		}
+	}
+	else {
+		Json::Value root;
+		parseJson(msg_data, root);
+		req.set_fromuid(root["fromuid"].asInt());
+		req.set_touid(root["touid"].asInt());
+		req.set_thread_id(root["thread_id"].asInt());
+		for (const auto& txt_obj : root["text_array"]) {
+			auto* item = req.add_text_array();
+			item->set_content(txt_obj["content"].asString());
+			item->set_unique_id(txt_obj["unique_id"].asString());
+		}
+	}
 
-	const Json::Value  arrays = root["text_array"];
+	auto uid = req.fromuid();
+	auto touid = req.touid();
+	auto thread_id = req.thread_id();
 
-	Json::Value  rtvalue;
-	rtvalue["error"] = ErrorCodes::Success;
-	rtvalue["fromuid"] = uid;
-	rtvalue["touid"] = touid;
-	auto thread_id = root["thread_id"].asInt();
-	rtvalue["thread_id"] = thread_id;
 	std::vector<std::shared_ptr<ChatMessage>> chat_datas;
 	auto timestamp = getCurrentTimestamp();
-	for (const auto& txt_obj : arrays) {
-		auto content = txt_obj["content"].asString();
-		auto unique_id = txt_obj["unique_id"].asString();
+	for (const auto& txt_obj : req.text_array()) {
+		const auto& content = txt_obj.content();
+		const auto& unique_id = txt_obj.unique_id();
 		std::cout << "content is " << content << std::endl;
 		std::cout << "unique_id is " << unique_id << std::endl;
 		auto chat_msg = std::make_shared<ChatMessage>();
@@ -514,22 +659,40 @@ void LogicSystem::dealChatTextMsg(std::shared_ptr<CSession> session, const short
 		chat_datas.push_back(chat_msg);
 	}
 
-	//插入数据库
-	MysqlMgr::getInstance()->addChatMsg(chat_datas);
+	//启用写后持久化时只分配id并写入本地日志，由后台线程成批落库
+	auto db = DBExecutor::getInstance();
+	bool b_saved = co_await db->run([&chat_datas]() {
+		auto writer = ChatMsgWriter::getInstance();
+		bool saved = writer->enabled() ? writer->append(chat_datas)
+			: MysqlMgr::getInstance()->addChatMsg(chat_datas);
+		if (saved) {
+			ThreadMsgCache::getInstance()->append(chat_datas);
+		}
+		return saved;
+		});
 
+	ClientTextChatMsgRsp rsp;
+	rsp.set_error(ErrorCodes::Success);
+	rsp.set_fromuid(uid);
+	rsp.set_touid(touid);
+	rsp.set_thread_id(thread_id);
+	if (!b_saved) {
+		//没有保存成功的消息不转发
+		rsp.set_error(ErrorCodes::SaveChatFailed);
+		session->send(encodeTextChatMsg(session->getCodec(), rsp), ID_TEXT_CHAT_MSG_RSP);
+		co_return;
+	}
 	for (const auto& chat_data : chat_datas) {
-		Json::Value  chat_msg;
-		chat_msg["message_id"] = chat_data->message_id;
-		chat_msg["unique_id"] = chat_data->unique_id;
-		chat_msg["content"] = chat_data->content;
-		chat_msg["status"] = chat_data->status;
-		chat_msg["chat_time"] = chat_data->chat_time;
-		rtvalue["chat_datas"].append(chat_msg);
+		auto* chat_msg = rsp.add_chat_datas();
+		chat_msg->set_message_id(chat_data->message_id);
+		chat_msg->set_unique_id(chat_data->unique_id);
+		chat_msg->set_content(chat_data->content);
+		chat_msg->set_status(chat_data->status);
+		chat_msg->set_chat_time(chat_data->chat_time);
 	}
 
-	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
-		session->send(return_str, ID_TEXT_CHAT_MSG_RSP);
+	Defer defer([this, &rsp, session]() {
+		session->send(encodeTextChatMsg(session->getCodec(), rsp), ID_TEXT_CHAT_MSG_RSP);
 		});
 
 
@@ -537,23 +700,22 @@ void LogicSystem::dealChatTextMsg(std::shared_ptr<CSession> session, const short
 	auto to_str = std::to_string(touid);
 	auto to_ip_key = USERIPPREFIX + to_str;
 	std::string to_ip_value = "";
-	bool b_ip = RedisMgr::getInstance()->get(to_ip_key, to_ip_value);
+	bool b_ip = co_await RedisMgr::getInstance()->asyncGet(to_ip_key, to_ip_value);
 	if (!b_ip) {
-		return;
+		co_return;
 	}
 
 	auto& cfg = ConfigMgr::getInst();
 	auto self_name = cfg["SelfServer"]["Name"];
 	// 如果对方在本服务器，直接通知对方有认证通过消息
 	if (to_ip_value == self_name) {
-		auto session = UserMgr::getInstance()->getSession(touid);
-		if (session) {
-			//在内存中则直接发送通知对方
-			std::string return_str = rtvalue.toStyledString();
-			session->send(return_str, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
+		auto to_session = UserMgr::getInstance()->getSession(touid);
+		if (to_session) {
+			//在内存中则直接按对方协商的编码发送通知
+			to_session->send(encodeTextChatMsg(to_session->getCodec(), rsp), ID_NOTIFY_TEXT_CHAT_MSG_REQ);
 		}
 
-		return;
+		co_return;
 	}
 
 
@@ -570,37 +732,55 @@ void LogicSystem::dealChatTextMsg(std::shared_ptr<CSession> session, const short
 	}
 
 
-	//发送通知 todo...
-	ChatGrpcClient::getInstance()->notifyTextChatMsg(to_ip_value, text_msg_req, rtvalue);
+	//发送通知，发布订阅模式下和同一时刻发往该服务器的其他通知合并发布，grpc模式下是阻塞调用
+	co_await db->run([&to_ip_value, &text_msg_req]() {
+		PeerRouter::getInstance()->notifyTextChatMsg(to_ip_value, text_msg_req);
+		});
 }
 
 // 心跳处理回调函数
-void LogicSystem::heartBeatHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data) {
-	Json::Reader reader;
+void LogicSystem::heartBeatHandler(std::shared_ptr<CSession> session, const short& msg_id, std::string_view msg_data) {
+	if (session->getCodec() == CODEC_PROTOBUF) {
+		//时间轮已在收到数据时刷新，这里只负责回复，解析失败的帧不回复
+		ClientHeartBeatReq req;
+		if (!req.ParseFromArray(msg_data.data(), static_cast<int>(msg_data.size()))) {
+			std::cout << "parse heart beat msg failed" << std::endl;
+			return;
+		}
+		std::cout << "receive heart beat msg, uid is " << req.fromuid() << std::endl;
+		ClientHeartBeatRsp rsp;
+		rsp.set_error(ErrorCodes::Success);
+		session->send(rsp.SerializeAsString(), ID_HEARTBEAT_RSP);
+		return;
+	}
+
 	Json::Value root;
-	reader.parse(msg_data, root);
+	if (!parseJson(msg_data, root)) {
+		std::cout << "parse heart beat msg failed" << std::endl;
+		return;
+	}
 	auto uid = root["fromuid"].asInt();
 	std::cout << "receive heart beat msg, uid is " << uid << std::endl;
 	Json::Value  rtvalue;
 	rtvalue["error"] = ErrorCodes::Success;
-	session->send(rtvalue.toStyledString(), ID_HEARTBEAT_RSP);
+	session->send(toJsonString(rtvalue), ID_HEARTBEAT_RSP);
 }
 
 // 加载聊天线程记录
-void LogicSystem::getUserThreadsHandler(std::shared_ptr<CSession> session, const short& msg_id, const string& msg_data) {
+net::awaitable<void> LogicSystem::getUserThreadsHandler(std::shared_ptr<CSession> session, short msg_id, std::string msg_data) {
 	//从数据库加chat_threads记录
-	Json::Reader reader;
 	Json::Value root;
-	reader.parse(msg_data, root);
+	parseJson(msg_data, root);
 	auto uid = root["uid"].asInt();
-	int last_id = root["thread_id"].asInt();
+	//游标由上一页回复中的next_last_id、next_last_msg_id和snapshot组成，第一页全为0
+	ChatThreadCursor cursor{ root["thread_id"].asInt(), root["last_msg_id"].asInt64(), root["snapshot"].asInt64() };
 	std::cout << "get uid  threads  " << uid << std::endl;
 
 	Json::Value  rtvalue;
 	rtvalue["error"] = ErrorCodes::Success;
 	rtvalue["uid"] = uid;
 	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
+		std::string return_str = toJsonString(rtvalue);
 		session->send(return_str, ID_LOAD_CHAT_THREAD_RSP);
 		});
 
@@ -608,15 +788,18 @@ void LogicSystem::getUserThreadsHandler(std::shared_ptr<CSession> session, const
 
 	int page_size = 10;
 	bool load_more = false;
-	int64_t next_last_id = 0;
-	bool res = getUserThreads(uid, last_id, page_size, threads, load_more, next_last_id);
+	bool res = co_await DBExecutor::getInstance()->run([this, uid, &cursor, page_size, &threads, &load_more]() {
+		return getUserThreads(uid, cursor, page_size, threads, load_more);
+		});
 	if (!res) {
 		rtvalue["error"] = ErrorCodes::UidInvalid;
-		return;
+		co_return;
 	}
 
 	rtvalue["load_more"] = load_more;
-	rtvalue["next_last_id"] = (int)next_last_id;
+	rtvalue["next_last_id"] = (int)cursor._thread_id;
+	rtvalue["next_last_msg_id"] = (Json::Int64)cursor._last_msg_id;
+	rtvalue["snapshot"] = (Json::Int64)cursor._snapshot;
 	//整理threads数据写入json返回
 	for (auto& thread : threads) {
 		Json::Value thread_value;
@@ -624,15 +807,15 @@ void LogicSystem::getUserThreadsHandler(std::shared_ptr<CSession> session, const
 		thread_value["type"] = thread->_type;
 		thread_value["user1_id"] = thread->_user1_id;
 		thread_value["user2_id"] = thread->_user2_id;
+		thread_value["changed"] = thread->_changed;
 		rtvalue["threads"].append(thread_value);
 	}
 }
 
 // 创建私聊回调函数
-void LogicSystem::createPrivateChat(std::shared_ptr<CSession> session, const short& msg_id, const string& msg_data) {
-	Json::Reader reader;
+net::awaitable<void> LogicSystem::createPrivateChat(std::shared_ptr<CSession> session, short msg_id, std::string msg_data) {
 	Json::Value root;
-	reader.parse(msg_data, root);
+	parseJson(msg_data, root);
 	auto uid = root["uid"].asInt();
 	auto other_id = root["other_id"].asInt();
 
@@ -642,25 +825,26 @@ void LogicSystem::createPrivateChat(std::shared_ptr<CSession> session, const sho
 	rtvalue["other_id"] = other_id;
 
 	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
+		std::string return_str = toJsonString(rtvalue);
 		session->send(return_str, ID_LOAD_CHAT_THREAD_RSP);
 		});
 
 	int thread_id = 0;
-	bool res = MysqlMgr::getInstance()->createPrivateChat(uid, other_id, thread_id);
+	bool res = co_await DBExecutor::getInstance()->run([uid, other_id, &thread_id]() {
+		return MysqlMgr::getInstance()->createPrivateChat(uid, other_id, thread_id);
+		});
 	if (!res) {
 		rtvalue["error"] = ErrorCodes::CreatChatFailed;
-		return;
+		co_return;
 	}
 
 	rtvalue["thread_id"] = thread_id;
 }
 
 // 加载聊天消息回调函数
-void LogicSystem::loadChatMsg(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data) {
-	Json::Reader reader;
+net::awaitable<void> LogicSystem::loadChatMsg(std::shared_ptr<CSession> session, short msg_id, std::string msg_data) {
 	Json::Value root;
-	reader.parse(msg_data, root);
+	parseJson(msg_data, root);
 	auto thread_id = root["thread_id"].asInt();
 	auto message_id = root["message_id"].asInt();
 
@@ -669,15 +853,40 @@ void LogicSystem::loadChatMsg(std::shared_ptr<CSession> session, const short& ms
 	rtvalue["thread_id"] = thread_id;
 
 	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
+		std::string return_str = toJsonString(rtvalue);
 		session->send(return_str, ID_LOAD_CHAT_MSG_RSP);
 		});
 
 	int page_size = 10;
-	std::shared_ptr<PageResult> res = MysqlMgr::getInstance()->loadChatMsg(thread_id, message_id, page_size);
+	std::shared_ptr<PageResult> res = co_await DBExecutor::getInstance()->run([thread_id, message_id, page_size]()
+		-> std::shared_ptr<PageResult> {
+		//启用写后持久化时各服务器分批落库，小id可能晚于大id提交，
+		//只返回已提交水位线之内的消息，游标不会越过之后才落库的消息
+		int max_message_id = std::numeric_limits<int>::max();
+		auto allocator = MsgIdAllocator::getInstance();
+		if (allocator->enabled()) {
+			auto committed_id = allocator->committedId();
+			if (committed_id < 0) {
+				return nullptr;
+			}
+			max_message_id = static_cast<int>(std::min<int64_t>(committed_id, max_message_id));
+		}
+
+		//游标在最近消息的缓存窗口内时不查mysql
+		auto cache = ThreadMsgCache::getInstance();
+		bool b_window = true;
+		std::shared_ptr<PageResult> res = cache->load(thread_id, message_id, max_message_id, page_size, b_window);
+		if (!res) {
+			res = MysqlMgr::getInstance()->loadChatMsg(thread_id, message_id, max_message_id, page_size);
+			if (res && !b_window) {
+				cache->fill(thread_id);
+			}
+		}
+		return res;
+		});
 	if (!res) {
 		rtvalue["error"] = ErrorCodes::LoadChatFailed;
-		return;
+		co_return;
 	}
 
 	rtvalue["last_message_id"] = res->next_cursor;
@@ -699,11 +908,10 @@ void LogicSystem::loadChatMsg(std::shared_ptr<CSession> session, const short& ms
 }
 
 // 收到图片信息发送回调函数
-void LogicSystem::dealChatImgMsg(std::shared_ptr<CSession> session,
-	const short& msg_id, const string& msg_data) {
-	Json::Reader reader;
+net::awaitable<void> LogicSystem::dealChatImgMsg(std::shared_ptr<CSession> session,
+	short msg_id, std::string msg_data) {
 	Json::Value root;
-	reader.parse(msg_data, root);
+	parseJson(msg_data, root);
 
 	auto uid = root["fromuid"].asInt();
 	auto touid = root["touid"].asInt();
@@ -739,60 +947,97 @@ void LogicSystem::dealChatImgMsg(std::shared_ptr<CSession> session,
 	chat_msg->status = MsgStatus::UN_UPLOAD;
 	chat_msg->msg_type = int(ChatMsgType::PIC);
 
-	//插入数据库
-	MysqlMgr::getInstance()->addChatMsg(chat_msg);
-
-	rtvalue["message_id"] = chat_msg->message_id;
 	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
+		std::string return_str = toJsonString(rtvalue);
 		session->send(return_str, ID_IMG_CHAT_MSG_RSP);
 		});
+
+	//插入数据库，启用写后持久化时由后台线程落库
+	std::vector<std::shared_ptr<ChatMessage>> chat_datas{ chat_msg };
+	bool b_saved = co_await DBExecutor::getInstance()->run([&chat_datas, &chat_msg]() {
+		auto writer = ChatMsgWriter::getInstance();
+		bool saved = false;
+		if (writer->enabled()) {
+			saved = writer->append(chat_datas);
+		}
+		else {
+			saved = MysqlMgr::getInstance()->addChatMsg(chat_msg);
+		}
+		if (saved) {
+			ThreadMsgCache::getInstance()->append(chat_datas);
+		}
+		return saved;
+		});
+	if (!b_saved) {
+		rtvalue["error"] = ErrorCodes::SaveChatFailed;
+		co_return;
+	}
+
+	rtvalue["message_id"] = chat_msg->message_id;
 }
 
 
 // 获取用户的信息
 bool LogicSystem::getBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo) {
-	//优先查redis中查询用户信息
+	//优先查进程内缓存
+	if (UserCache::getInstance()->get(uid, *userinfo)) {
+		return true;
+	}
+
+	//再查redis中查询用户信息
 	std::string info_str = "";
 	bool b_base = RedisMgr::getInstance()->get(base_key, info_str);
 	if (b_base) {
-		Json::Reader reader;
-		Json::Value root;
-		reader.parse(info_str, root);
-		userinfo->uid = root["uid"].asInt();
-		userinfo->name = root["name"].asString();
-		userinfo->pwd = root["pwd"].asString();
-		userinfo->email = root["email"].asString();
-		userinfo->nick = root["nick"].asString();
-		userinfo->desc = root["desc"].asString();
-		userinfo->sex = root["sex"].asInt();
-		userinfo->icon = root["icon"].asString();
-		std::cout << "user login uid is  " << userinfo->uid << " name  is "
-			<< userinfo->name << " pwd is " << userinfo->pwd << " email is " << userinfo->email << std::endl;
+		parseBaseInfo(info_str, userinfo);
+		return true;
 	}
-	else {
-		//redis中没有则查询mysql
-		//查询数据库
-		std::shared_ptr<UserInfo> user_info = nullptr;
-		user_info = MysqlMgr::getInstance()->getUser(uid);
-		if (user_info == nullptr) {
-			return false;
-		}
 
-		userinfo = user_info;
+	//redis中没有则查询mysql
+	return loadBaseInfo(base_key, uid, userinfo);
+}
+
+// 解析redis中缓存的用户信息
+void LogicSystem::parseBaseInfo(const std::string& info_str, std::shared_ptr<UserInfo>& userinfo) {
+	Json::Value root;
+	parseJson(info_str, root);
+	userinfo->uid = root["uid"].asInt();
+	userinfo->name = root["name"].asString();
+	userinfo->pwd = root["pwd"].asString();
+	userinfo->email = root["email"].asString();
+	userinfo->nick = root["nick"].asString();
+	userinfo->desc = root["desc"].asString();
+	userinfo->sex = root["sex"].asInt();
+	userinfo->icon = root["icon"].asString();
+	std::cout << "user login uid is  " << userinfo->uid << " name  is "
+		<< userinfo->name << " pwd is " << userinfo->pwd << " email is " << userinfo->email << std::endl;
+	UserCache::getInstance()->put(*userinfo);
+}
 
-		//将数据库内容写入redis缓存
-		Json::Value redis_root;
-		redis_root["uid"] = uid;
-		redis_root["pwd"] = userinfo->pwd;
-		redis_root["name"] = userinfo->name;
-		redis_root["email"] = userinfo->email;
-		redis_root["nick"] = userinfo->nick;
-		redis_root["desc"] = userinfo->desc;
-		redis_root["sex"] = userinfo->sex;
-		redis_root["icon"] = userinfo->icon;
-		RedisMgr::getInstance()->set(base_key, redis_root.toStyledString());
+// 从mysql加载用户信息并写入redis缓存
+bool LogicSystem::loadBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo) {
+	//查询数据库
+	std::shared_ptr<UserInfo> user_info = nullptr;
+	user_info = MysqlMgr::getInstance()->getUser(uid);
+	if (user_info == nullptr) {
+		return false;
 	}
+
+	userinfo = user_info;
+
+	//将数据库内容写入redis缓存
+	Json::Value redis_root;
+	redis_root["uid"] = uid;
+	redis_root["pwd"] = userinfo->pwd;
+	redis_root["name"] = userinfo->name;
+	redis_root["email"] = userinfo->email;
+	redis_root["nick"] = userinfo->nick;
+	redis_root["desc"] = userinfo->desc;
+	redis_root["sex"] = userinfo->sex;
+	redis_root["icon"] = userinfo->icon;
+	UserCache::getInstance()->noteLocalWrite(base_key);
+	RedisMgr::getInstance()->set(base_key, toJsonString(redis_root));
+	UserCache::getInstance()->put(*userinfo);
+	return true;
 }
 
 // 检验字符串是否由纯数字组成
@@ -810,59 +1055,14 @@ void LogicSystem::getUserByUid(std::string uid_str, Json::Value& rtvalue) {
 	rtvalue["error"] = ErrorCodes::Success;
 
 	std::string base_key = USER_BASE_INFO + uid_str;
-
-	//优先查redis中查询用户信息
-	std::string info_str = "";
-	bool b_base = RedisMgr::getInstance()->get(base_key, info_str);
-	if (b_base) {
-		Json::Reader reader;
-		Json::Value root;
-		reader.parse(info_str, root);
-		auto uid = root["uid"].asInt();
-		auto name = root["name"].asString();
-		auto pwd = root["pwd"].asString();
-		auto email = root["email"].asString();
-		auto nick = root["nick"].asString();
-		auto desc = root["desc"].asString();
-		auto sex = root["sex"].asInt();
-		auto icon = root["icon"].asString();
-		std::cout << "user  uid is  " << uid << " name  is "
-			<< name << " pwd is " << pwd << " email is " << email << " icon is " << icon << std::endl;
-
-		rtvalue["uid"] = uid;
-		rtvalue["pwd"] = pwd;
-		rtvalue["name"] = name;
-		rtvalue["email"] = email;
-		rtvalue["nick"] = nick;
-		rtvalue["desc"] = desc;
-		rtvalue["sex"] = sex;
-		rtvalue["icon"] = icon;
-		return;
-	}
-
 	auto uid = std::stoi(uid_str);
-	//redis中没有则查询mysql
-	//查询数据库
-	std::shared_ptr<UserInfo> user_info = nullptr;
-	user_info = MysqlMgr::getInstance()->getUser(uid);
-	if (user_info == nullptr) {
+	//依次查进程内缓存、redis和mysql
+	auto user_info = std::make_shared<UserInfo>();
+	if (!getBaseInfo(base_key, uid, user_info)) {
 		rtvalue["error"] = ErrorCodes::UidInvalid;
 		return;
 	}
 
-	//将数据库内容写入redis缓存
-	Json::Value redis_root;
-	redis_root["uid"] = user_info->uid;
-	redis_root["pwd"] = user_info->pwd;
-	redis_root["name"] = user_info->name;
-	redis_root["email"] = user_info->email;
-	redis_root["nick"] = user_info->nick;
-	redis_root["desc"] = user_info->desc;
-	redis_root["sex"] = user_info->sex;
-	redis_root["icon"] = user_info->icon;
-
-	RedisMgr::getInstance()->set(base_key, redis_root.toStyledString());
-
 	//返回数据
 	rtvalue["uid"] = user_info->uid;
 	rtvalue["pwd"] = user_info->pwd;
@@ -880,13 +1080,25 @@ void LogicSystem::getUserByName(std::string name, Json::Value& rtvalue) {
 
 	std::string base_key = NAME_INFO + name;
 
-	//优先查redis中查询用户信息
+	//优先查进程内缓存
+	UserInfo cached;
+	if (UserCache::getInstance()->getByName(name, cached)) {
+		rtvalue["uid"] = cached.uid;
+		rtvalue["pwd"] = cached.pwd;
+		rtvalue["name"] = cached.name;
+		rtvalue["email"] = cached.email;
+		rtvalue["nick"] = cached.nick;
+		rtvalue["desc"] = cached.desc;
+		rtvalue["sex"] = cached.sex;
+		return;
+	}
+
+	//再查redis中查询用户信息
 	std::string info_str = "";
 	bool b_base = RedisMgr::getInstance()->get(base_key, info_str);
 	if (b_base) {
-		Json::Reader reader;
 		Json::Value root;
-		reader.parse(info_str, root);
+		parseJson(info_str, root);
 		auto uid = root["uid"].asInt();
 		auto name = root["name"].asString();
 		auto pwd = root["pwd"].asString();
@@ -926,7 +1138,10 @@ void LogicSystem::getUserByName(std::string name, Json::Value& rtvalue) {
 	redis_root["desc"] = user_info->desc;
 	redis_root["sex"] = user_info->sex;
 
-	RedisMgr::getInstance()->set(base_key, redis_root.toStyledString());
+	UserCache::getInstance()->noteLocalWrite(base_key);
+	RedisMgr::getInstance()->set(base_key, toJsonString(redis_root));
+	//mysql中的是完整信息，可以放入缓存
+	UserCache::getInstance()->put(*user_info);
 
 	//返回数据
 	rtvalue["uid"] = user_info->uid;
@@ -951,11 +1166,10 @@ bool LogicSystem::getFriendList(int self_id, std::vector<std::shared_ptr<UserInf
 
 // 获取用户聊天线程
 bool LogicSystem::getUserThreads(int64_t userId,
-	int64_t lastId,
+	ChatThreadCursor& cursor,
 	int      pageSize,
 	std::vector<std::shared_ptr<ChatThreadInfo>>& threads,
-	bool& loadMore,
-	int64_t& nextLastId) {
-	return MysqlMgr::getInstance()->getUserThreads(userId, lastId, pageSize,
-		threads, loadMore, nextLastId);
+	bool& loadMore) {
+	return MysqlMgr::getInstance()->getUserThreads(userId, cursor, pageSize,
+		threads, loadMore);
 }
\ No newline at end of file
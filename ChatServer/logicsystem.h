@@ -14,6 +14,8 @@
 #include "const.h"
 #include "data.h"
 #include "csession.h"
+#include "logicworker.h"
+#include "dbexecutor.h"
 
 /******************************************************************************
  * @file       logicsystem.h
@@ -26,9 +28,9 @@
 
 class CServer;
 
-using FunCallBack = std::function<void(std::shared_ptr<CSession>,
-	const short& msg_id,
-	const std::string& msg_data)>;
+// 协程形式的处理回调，在会话所属的io_context上执行，遇到Redis/MySQL调用时挂起而不阻塞线程
+using AsyncFunCallBack = std::function<net::awaitable<void>(std::shared_ptr<CSession>,
+	short msg_id, std::string msg_data)>;
 
 class LogicSystem :public Singleton<LogicSystem> {
 	friend class Singleton<LogicSystem>;
@@ -37,41 +39,41 @@ public:
 	// 将消息放入处理队列中
 	void postMsgToQue(std::shared_ptr <LogicNode> msg);
 	void setServer(std::shared_ptr<CServer> pserver);
+	// 获取各个工作线程的运行统计
+	std::vector<LogicWorkerStats> getWorkerStats();
 private:
 	LogicSystem();
-	// 线程工作函数
-	void dealMsg();
+	// 按回调类型分发消息：普通回调投递到工作线程，协程回调在会话的io_context上启动
+	void dispatchMsg(std::shared_ptr<LogicNode> msg);
+	// 获取会话固定的工作线程，首次选定时按用户uid（未登录时使用session uuid）散列，之后不再改变
+	std::size_t selectWorker(std::shared_ptr<CSession> session);
 	// 注册处理回调函数
 	void registerCallBacks();
-	// 聊天登录回调函数
-	void loginHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
-	// 查找好友回调函数
-	void searchInfo(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
-	// 添加好友回调函数
-	void addFriendApply(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
-	// 同意好友申请信息回调函数
-	void authFriendApply(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
-	// 收到文字信息发送回调函数
-	void dealChatTextMsg(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
+	// 聊天登录回调函数（协程）
+	net::awaitable<void> loginHandler(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
+	// 查找好友回调函数（协程）
+	net::awaitable<void> searchInfo(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
+	// 添加好友回调函数（协程）
+	net::awaitable<void> addFriendApply(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
+	// 同意好友申请信息回调函数（协程）
+	net::awaitable<void> authFriendApply(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
+	// 收到文字信息发送回调函数（协程）
+	net::awaitable<void> dealChatTextMsg(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
 	// 心跳处理回调函数
-	void heartBeatHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
-	// 加载聊天记录回调函数
-	void getUserThreadsHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
-	// 创建私聊回调函数
-	void createPrivateChat(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
-	// 加载聊天消息回调函数
-	void loadChatMsg(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
-	// 收到图片信息发送回调函数
-	void dealChatImgMsg(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
+	void heartBeatHandler(std::shared_ptr<CSession> session, const short& msg_id, std::string_view msg_data);
+	// 加载聊天记录回调函数（协程）
+	net::awaitable<void> getUserThreadsHandler(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
+	// 创建私聊回调函数（协程）
+	net::awaitable<void> createPrivateChat(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
+	// 加载聊天消息回调函数（协程）
+	net::awaitable<void> loadChatMsg(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
+	// 收到图片信息发送回调函数（协程）
+	net::awaitable<void> dealChatImgMsg(std::shared_ptr<CSession> session, short msg_id, std::string msg_data);
 
-	std::thread worker_thread_;
-	// 消息处理队列
-	std::queue<std::shared_ptr<LogicNode>> msg_queue_;
-	std::mutex mutex_;
-	std::condition_variable consume_;
-
-	bool b_stop_;
+	// 逻辑工作线程池
+	std::vector<std::unique_ptr<LogicWorker>> workers_;
 	std::map<short, FunCallBack> fun_callbacks_;
+	std::map<short, AsyncFunCallBack> async_callbacks_;
 	std::shared_ptr<CServer> p_server_;
 
 	// 存在内存中的用户数据
@@ -79,6 +81,10 @@ private:
 
 	// 获取用户的信息
 	bool getBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo);
+	// 解析redis中缓存的用户信息
+	void parseBaseInfo(const std::string& info_str, std::shared_ptr<UserInfo>& userinfo);
+	// redis中没有缓存时从mysql加载用户信息并写入redis
+	bool loadBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo);
 	// 检验字符串是否由纯数字组成
 	bool isPureDigit(const std::string& str);
 	// 根据uid查找用户
@@ -89,9 +95,9 @@ private:
 	bool getFriendApplyInfo(int to_uid, std::vector<std::shared_ptr<ApplyInfo>>& list);
 	// 获取好友列表信息
 	bool getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo>>& user_list);
-	// 获取用户聊天线程
-	bool getUserThreads(int64_t userId, int64_t lastId, int pageSize, std::vector<std::shared_ptr<ChatThreadInfo>>& threads,
-		bool& loadMore, int64_t& nextLastId);
+	// 获取用户聊天线程，返回时游标指向本页最后一个会话
+	bool getUserThreads(int64_t userId, ChatThreadCursor& cursor, int pageSize,
+		std::vector<std::shared_ptr<ChatThreadInfo>>& threads, bool& loadMore);
 };
 
 #endif // LOGICSYSTEM_H
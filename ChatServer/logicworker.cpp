@@ -0,0 +1,115 @@
+﻿#include "logicworker.h"
+#include <chrono>
+#include <iostream>
+
+/******************************************************************************
+ * @file       logicworker.cpp
+ * @brief      逻辑工作线程类实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+LogicWorker::LogicWorker(int index, const std::map<short, FunCallBack>& callbacks)
+    : index_(index), fun_callbacks_(callbacks), task_queue_(LOGIC_NODE_POOL_SIZE), b_stop_(false),
+    handled_count_(0), total_latency_us_(0), max_latency_us_(0) {
+    worker_thread_ = std::thread(&LogicWorker::dealMsg, this);
+}
+
+LogicWorker::~LogicWorker() {
+    stop();
+}
+
+void LogicWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (b_stop_) {
+            return;
+        }
+        b_stop_ = true;
+    }
+    consume_.notify_one();
+    if (worker_thread_.joinable()) {
+        worker_thread_.join();
+    }
+}
+
+void LogicWorker::postTask(std::shared_ptr<LogicNode> task) {
+    std::unique_lock<std::mutex> unique_lk(mutex_);
+    if (task_queue_.full()) {
+        task_queue_.set_capacity(task_queue_.capacity() * 2);
+    }
+    task_queue_.push_back(std::move(task));
+    //由0变为1则发送通知信号
+    if (task_queue_.size() == 1) {
+        unique_lk.unlock();
+        consume_.notify_one();
+    }
+}
+
+LogicWorkerStats LogicWorker::getStats() {
+    LogicWorkerStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.queue_depth = task_queue_.size();
+    }
+    stats.handled_count = handled_count_;
+    stats.total_latency_us = total_latency_us_;
+    stats.max_latency_us = max_latency_us_;
+    return stats;
+}
+
+void LogicWorker::dealMsg() {
+    for (;;) {
+        std::unique_lock<std::mutex> unique_lk(mutex_);
+        //判断队列为空则用条件变量阻塞等待，并释放锁
+        while (task_queue_.empty() && !b_stop_) {
+            consume_.wait(unique_lk);
+        }
+
+        //判断是否为关闭状态，把所有逻辑执行完后则退出循环
+        if (b_stop_ && task_queue_.empty()) {
+            break;
+        }
+
+        //取出队首消息后释放锁，处理期间不阻塞投递
+        auto task = std::move(task_queue_.front());
+        task_queue_.pop_front();
+        unique_lk.unlock();
+
+        handleTask(task);
+        //节点会归还到节点池中，不再持有会话
+        task->session_.reset();
+    }
+}
+
+void LogicWorker::handleTask(std::shared_ptr<LogicNode> task) {
+    auto msg_id = task->recvnode_->msg_id_;
+    std::cout << "worker [" << index_ << "] recv_msg id  is " << msg_id << std::endl;
+    auto call_back_iter = fun_callbacks_.find(msg_id);
+    if (call_back_iter == fun_callbacks_.end()) {
+        std::cout << "msg id [" << msg_id << "] handler not found" << std::endl;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        // std::function 重载了 () 运算符
+        call_back_iter->second(task->session_, msg_id,
+            std::string_view(task->recvnode_->data_, task->recvnode_->cur_len_));
+    }
+    catch (std::exception& e) {
+        std::cout << "worker [" << index_ << "] handle msg id [" << msg_id
+            << "] exception: " << e.what() << std::endl;
+    }
+    auto cost = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    handled_count_++;
+    total_latency_us_ += cost;
+    uint64_t prev_max = max_latency_us_;
+    while (static_cast<uint64_t>(cost) > prev_max &&
+        !max_latency_us_.compare_exchange_weak(prev_max, cost)) {
+    }
+}
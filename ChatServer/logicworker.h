@@ -0,0 +1,66 @@
+﻿#ifndef LOGICWORKER_H
+#define LOGICWORKER_H
+
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <string_view>
+#include <condition_variable>
+#include <boost/circular_buffer.hpp>
+#include "csession.h"
+
+/******************************************************************************
+ * @file       logicworker.h
+ * @brief      逻辑工作线程类，每个工作线程拥有独立的消息队列
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// msg_data指向池中节点的缓冲区，只在回调执行期间有效
+using FunCallBack = std::function<void(std::shared_ptr<CSession>,
+    const short& msg_id,
+    std::string_view msg_data)>;
+
+// 工作线程的运行统计
+struct LogicWorkerStats {
+    std::size_t queue_depth = 0;    // 当前队列中等待处理的消息数
+    uint64_t handled_count = 0;     // 已处理的消息数
+    uint64_t total_latency_us = 0;  // 累计处理耗时（微秒）
+    uint64_t max_latency_us = 0;    // 单条消息的最大处理耗时（微秒）
+};
+
+class LogicWorker {
+public:
+    LogicWorker(int index, const std::map<short, FunCallBack>& callbacks);
+    ~LogicWorker();
+    // 将消息放入本线程的处理队列中
+    void postTask(std::shared_ptr<LogicNode> task);
+    // 获取运行统计
+    LogicWorkerStats getStats();
+    // 停止线程，处理完队列中剩余的消息后退出
+    void stop();
+private:
+    // 线程工作函数
+    void dealMsg();
+    // 调用消息对应的回调函数并统计耗时
+    void handleTask(std::shared_ptr<LogicNode> task);
+
+    int index_;
+    const std::map<short, FunCallBack>& fun_callbacks_;
+    std::thread worker_thread_;
+    // 环形队列，满时容量翻倍，稳定运行后入队出队不再分配内存
+    boost::circular_buffer<std::shared_ptr<LogicNode>> task_queue_;
+    std::mutex mutex_;
+    std::condition_variable consume_;
+    bool b_stop_;
+
+    std::atomic<uint64_t> handled_count_;
+    std::atomic<uint64_t> total_latency_us_;
+    std::atomic<uint64_t> max_latency_us_;
+};
+
+#endif // LOGICWORKER_H
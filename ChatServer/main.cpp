@@ -7,6 +7,9 @@
 #include "redismgr.h"
 #include "chatserviceimpl.h"
 #include "logicSystem.h"
+#include "dbexecutor.h"
+#include "peerrouter.h"
+#include "chatmsgwriter.h"
 
 bool bstop = false;
 // 管理退出
@@ -24,11 +27,18 @@ int main() {
 			RedisMgr::getInstance()->hDel(LOGIN_COUNT, server_name);
 			RedisMgr::getInstance()->close();
 			});
+		//重放上次未落库的聊天消息并启动后台写库线程
+		if (!ChatMsgWriter::getInstance()->start()) {
+			std::cerr << "start chat msg writer failed" << std::endl;
+			return 1;
+		}
 
 		boost::asio::io_context  io_context;
 		auto port_str = cfg["SelfServer"]["Port"];
+		//开启后每个io线程各自监听端口
+		bool reuse_port = cfg["SelfServer"]["ReusePort"] == "true";
 		//创建Cserver智能指针
-		auto pointer_server = std::make_shared<CServer>(io_context, atoi(port_str.c_str()));
+		auto pointer_server = std::make_shared<CServer>(io_context, atoi(port_str.c_str()), reuse_port);
 		//定义一个GrpcServer
 		std::string server_address(cfg["SelfServer"]["Host"] + ":" + cfg["SelfServer"]["RPCPort"]);
 		ChatServiceImpl service;
@@ -37,6 +47,8 @@ int main() {
 		builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
 		builder.RegisterService(&service);
 		service.RegisterServer(pointer_server);
+		//发布订阅模式下订阅本服务器的频道，收到的通知交给service处理
+		PeerRouter::getInstance()->start(&service);
 		// 构建并启动gRPC服务器
 		std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
 		std::cout << "RPC Server listening on " << server_address << std::endl;
@@ -60,6 +72,12 @@ int main() {
 		io_context.run();
 
 		grpc_server_thread.join();
+		//发出剩余的跨服务器通知
+		PeerRouter::getInstance()->stop();
+		//把队列中的聊天消息写入数据库
+		ChatMsgWriter::getInstance()->stop();
+		//等待执行线程池中未完成的数据库调用结束
+		DBExecutor::getInstance()->stop();
 	}
 	catch (std::exception& e) {
 		std::cerr << "Exception: " << e.what() << endl;
@@ -0,0 +1,108 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/******************************************************************************
+ * @file       mpscqueue.h
+ * @brief      无锁多生产者单消费者队列模板类（侵入式链表，Vyukov算法）
+ *             push可在任意线程调用，pop只能由唯一的消费者线程调用；
+ *             链接指针在元素自身中，入队出队都不分配内存
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 入队元素的基类，元素类型T需要派生自MpscNode<T>
+// 元素在队列中时由mpsc_self_持有引用，出队时交还给调用方；同一时刻只能在一个队列中
+template <typename T>
+class MpscNode {
+    template <typename U>
+    friend class MpscQueue;
+public:
+    MpscNode() : mpsc_next_(nullptr) {
+    }
+    MpscNode(const MpscNode&) = delete;
+    MpscNode& operator=(const MpscNode&) = delete;
+private:
+    std::atomic<MpscNode*> mpsc_next_;
+    std::shared_ptr<T> mpsc_self_;
+};
+
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {
+    }
+
+    ~MpscQueue() {
+        std::shared_ptr<T> value;
+        while (pop(value)) {
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // 入队，任意线程均可调用
+    void push(std::shared_ptr<T> value) {
+        Node* node = value.get();
+        node->mpsc_self_ = std::move(value);
+        pushNode(node);
+    }
+
+    // 出队，只能由消费者线程调用
+    // 队列为空，或者有生产者尚未完成链接时返回false，此时稍后重试即可
+    bool pop(std::shared_ptr<T>& value) {
+        Node* tail = tail_;
+        Node* next = tail->mpsc_next_.load(std::memory_order_acquire);
+        // 跳过占位节点
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return false;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->mpsc_next_.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            tail_ = next;
+            value = std::move(tail->mpsc_self_);
+            return true;
+        }
+
+        // tail不是最后一个节点，说明有生产者交换了head_但还没有链接next
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        // 只剩最后一个节点，放回占位节点后才能把它取出
+        pushNode(&stub_);
+        next = tail->mpsc_next_.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            value = std::move(tail->mpsc_self_);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    using Node = MpscNode<T>;
+
+    void pushNode(Node* node) {
+        node->mpsc_next_.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->mpsc_next_.store(node, std::memory_order_release);
+    }
+
+    std::atomic<Node*> head_;   // 生产者端
+    Node* tail_;                // 消费者端
+    Node stub_;                 // 占位节点
+};
+
+#endif // MPSCQUEUE_H
@@ -0,0 +1,34 @@
+#include "msgcodec.h"
+#include <json/json.h>
+#include "../Common/jsonutil.h"
+
+/******************************************************************************
+ * @file       msgcodec.cpp
+ * @brief      客户端长连接消息体的编解码实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+std::string encodeTextChatMsg(int codec, const message::ClientTextChatMsgRsp& rsp) {
+    if (codec == CODEC_PROTOBUF) {
+        return rsp.SerializeAsString();
+    }
+
+    Json::Value rtvalue;
+    rtvalue["error"] = rsp.error();
+    rtvalue["fromuid"] = rsp.fromuid();
+    rtvalue["touid"] = rsp.touid();
+    rtvalue["thread_id"] = rsp.thread_id();
+    for (const auto& chat_data : rsp.chat_datas()) {
+        Json::Value chat_msg;
+        chat_msg["message_id"] = chat_data.message_id();
+        chat_msg["unique_id"] = chat_data.unique_id();
+        chat_msg["content"] = chat_data.content();
+        chat_msg["status"] = chat_data.status();
+        chat_msg["chat_time"] = chat_data.chat_time();
+        rtvalue["chat_datas"].append(chat_msg);
+    }
+    return toJsonString(rtvalue);
+}
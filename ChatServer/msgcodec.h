@@ -0,0 +1,20 @@
+#ifndef MSGCODEC_H
+#define MSGCODEC_H
+
+#include <string>
+#include "const.h"
+#include "message.pb.h"
+
+/******************************************************************************
+ * @file       msgcodec.h
+ * @brief      客户端长连接消息体的编解码，按会话协商的编码方式（MsgCodec）输出json或protobuf
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 序列化文本聊天回包和通知，json格式的字段与原有协议保持一致
+std::string encodeTextChatMsg(int codec, const message::ClientTextChatMsgRsp& rsp);
+
+#endif // MSGCODEC_H
@@ -0,0 +1,153 @@
+﻿#include "msgidallocator.h"
+#include "configmgr.h"
+#include "redismgr.h"
+#include "const.h"
+#include <limits>
+
+/******************************************************************************
+ * @file       msgidallocator.cpp
+ * @brief      聊天消息id分配器实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 计数器小于已知的最大id时（首次使用或redis数据丢失）先抬高到该值，再领取；
+// 领取和登记在同一个脚本中完成，水位线不会越过已分配但还没登记的id
+// KEYS: 计数器, 本服务器的未落库集合, 服务器集合  ARGV: 数量, 下界, 登记过期时间, 服务器名
+static const std::string ALLOCATE_SCRIPT =
+    "local cur = tonumber(redis.call('GET', KEYS[1]) or '0') "
+    "if cur < tonumber(ARGV[2]) then redis.call('SET', KEYS[1], ARGV[2]) end "
+    "local last = redis.call('INCRBY', KEYS[1], ARGV[1]) "
+    "local first = last - tonumber(ARGV[1]) + 1 "
+    "redis.call('ZADD', KEYS[2], first, first) "
+    "redis.call('EXPIRE', KEYS[2], ARGV[3]) "
+    "redis.call('SADD', KEYS[3], ARGV[4]) "
+    "return last";
+
+// 清除本服务器上次运行的登记，换成重放日志中的分配
+// KEYS: 本服务器的未落库集合, 服务器集合  ARGV: 登记过期时间, 服务器名, 之后为各分配的第一个id
+static const std::string RESTORE_SCRIPT =
+    "redis.call('DEL', KEYS[1]) "
+    "for i = 3, #ARGV do redis.call('ZADD', KEYS[1], ARGV[i], ARGV[i]) end "
+    "if #ARGV >= 3 then redis.call('EXPIRE', KEYS[1], ARGV[1]) redis.call('SADD', KEYS[2], ARGV[2]) end "
+    "return 1";
+
+// 所有服务器中最小的未落库id之前的都已提交，没有未落库的分配时为计数器的当前值；
+// 过期的登记集合已被redis删除，不再参与计算
+// KEYS: 计数器, 服务器集合  ARGV: 未落库集合的前缀
+static const std::string COMMITTED_SCRIPT =
+    "local low = nil "
+    "for _, name in ipairs(redis.call('SMEMBERS', KEYS[2])) do "
+    "  local first = redis.call('ZRANGE', ARGV[1] .. name, 0, 0, 'WITHSCORES') "
+    "  if first[2] and (not low or tonumber(first[2]) < low) then low = tonumber(first[2]) end "
+    "end "
+    "if low then return low - 1 end "
+    "return tonumber(redis.call('GET', KEYS[1]) or '0')";
+
+MsgIdAllocator::MsgIdAllocator() : enabled_(ConfigMgr::getInst()["MsgWriter"]["Enabled"] == "true"),
+    pending_ttl_(60), floor_(0) {
+    auto ttl_str = ConfigMgr::getInst()["MsgWriter"]["PendingTTL"];
+    if (!ttl_str.empty() && atoi(ttl_str.c_str()) > 0) {
+        pending_ttl_ = atoi(ttl_str.c_str());
+    }
+    server_name_ = ConfigMgr::getInst()["SelfServer"]["Name"];
+    pending_key_ = CHAT_MSG_PENDING_PREFIX + server_name_;
+}
+
+MsgIdAllocator::~MsgIdAllocator() {
+}
+
+bool MsgIdAllocator::enabled() const {
+    return enabled_;
+}
+
+void MsgIdAllocator::init(int64_t floor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    floor_ = std::max(floor_, floor);
+}
+
+int64_t MsgIdAllocator::allocate(int count) {
+    if (count <= 0) {
+        return 0;
+    }
+    int64_t floor = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        floor = floor_;
+    }
+
+    std::vector<RedisCommand> commands{
+        { "EVAL", ALLOCATE_SCRIPT, "3", CHAT_MSG_ID_KEY, pending_key_, CHAT_MSG_WRITERS_KEY,
+          std::to_string(count), std::to_string(floor), std::to_string(pending_ttl_), server_name_ } };
+    std::vector<RedisResult> results;
+    if (!RedisMgr::getInstance()->pipeline(commands, results) || results.empty()
+        || results[0].type != REDIS_REPLY_INTEGER) {
+        std::cout << "allocate chat msg id failed" << std::endl;
+        return 0;
+    }
+
+    //ChatMessage和客户端协议中的message_id都是int，超出范围时拒绝保存
+    int64_t last = results[0].integer;
+    if (last > std::numeric_limits<int>::max()) {
+        std::cout << "chat msg id " << last << " exceeds int range" << std::endl;
+        release({ last - count + 1 });
+        return 0;
+    }
+    return last - count + 1;
+}
+
+bool MsgIdAllocator::release(const std::vector<int64_t>& first_ids) {
+    if (first_ids.empty()) {
+        return true;
+    }
+    RedisCommand command{ "ZREM", pending_key_ };
+    for (auto first_id : first_ids) {
+        command.push_back(std::to_string(first_id));
+    }
+    std::vector<RedisCommand> commands{ std::move(command) };
+    std::vector<RedisResult> results;
+    return RedisMgr::getInstance()->pipeline(commands, results) && !results.empty()
+        && results[0].type == REDIS_REPLY_INTEGER;
+}
+
+bool MsgIdAllocator::restore(const std::vector<int64_t>& first_ids) {
+    RedisCommand command{ "EVAL", RESTORE_SCRIPT, "2", pending_key_, CHAT_MSG_WRITERS_KEY,
+        std::to_string(pending_ttl_), server_name_ };
+    for (auto first_id : first_ids) {
+        command.push_back(std::to_string(first_id));
+    }
+    std::vector<RedisCommand> commands{ std::move(command) };
+    std::vector<RedisResult> results;
+    if (!RedisMgr::getInstance()->pipeline(commands, results) || results.empty()
+        || results[0].type != REDIS_REPLY_INTEGER) {
+        std::cout << "restore pending chat msg ids failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MsgIdAllocator::keepAlive() {
+    //集合为空时redis已删除该键，EXPIRE返回0，无需处理
+    std::vector<RedisCommand> commands{ { "EXPIRE", pending_key_, std::to_string(pending_ttl_) } };
+    std::vector<RedisResult> results;
+    return RedisMgr::getInstance()->pipeline(commands, results) && !results.empty()
+        && results[0].type == REDIS_REPLY_INTEGER;
+}
+
+int64_t MsgIdAllocator::committedId() {
+    std::vector<RedisCommand> commands{
+        { "EVAL", COMMITTED_SCRIPT, "2", CHAT_MSG_ID_KEY, CHAT_MSG_WRITERS_KEY, CHAT_MSG_PENDING_PREFIX } };
+    std::vector<RedisResult> results;
+    if (!RedisMgr::getInstance()->pipeline(commands, results) || results.empty()
+        || results[0].type != REDIS_REPLY_INTEGER) {
+        std::cout << "query committed chat msg id failed" << std::endl;
+        return -1;
+    }
+    return results[0].integer;
+}
+
+int MsgIdAllocator::pendingTTL() const {
+    return pending_ttl_;
+}
@@ -0,0 +1,57 @@
+﻿#ifndef MSGIDALLOCATOR_H
+#define MSGIDALLOCATOR_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "singleton.h"
+
+/******************************************************************************
+ * @file       msgidallocator.h
+ * @brief      聊天消息id分配器：所有聊天服务器共享redis中的同一个计数器，
+ *             每个请求的一批消息用一次INCRBY领取连续的id，
+ *             id的先后和消息到达的先后一致，可以继续作为排序键和翻页游标；
+ *             启用后所有chat_message的插入都必须显式使用这里分配的id，
+ *             否则自增列生成的id会和已分配但还没落库的id冲突；
+ *             消息分配id后由各服务器分批落库，小id可能晚于大id提交，
+ *             每次分配都登记在本服务器的未落库集合中，落库后撤销，
+ *             翻页只读取所有服务器最小的未落库id之前的消息，游标不会越过还没提交的消息
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+class MsgIdAllocator : public Singleton<MsgIdAllocator> {
+    friend class Singleton<MsgIdAllocator>;
+public:
+    ~MsgIdAllocator();
+    // 配置[MsgWriter] Enabled=true时启用
+    bool enabled() const;
+    // 之后分配的id都大于floor（启动时传入数据库和本地日志中的最大id）
+    void init(int64_t floor);
+    // 分配count个连续的id并登记为未落库，返回第一个，失败或超出chat_message的id范围时返回0
+    int64_t allocate(int count = 1);
+    // 以第一个id撤销已经全部落库（或放弃）的分配
+    bool release(const std::vector<int64_t>& first_ids);
+    // 启动时用重放的日志重建本服务器的登记，上次运行留下的登记一并清除
+    bool restore(const std::vector<int64_t>& first_ids);
+    // 续期本服务器的登记；进程异常退出后登记在过期后失效，不会永远挡住翻页
+    bool keepAlive();
+    // 小于等于返回值的id都已落库或已放弃，失败返回-1
+    int64_t committedId();
+    // 登记的过期时间（秒），写线程按它的三分之一续期
+    int pendingTTL() const;
+private:
+    MsgIdAllocator();
+
+    bool enabled_;
+    int pending_ttl_;
+    std::string pending_key_;   // 本服务器的未落库集合
+    std::string server_name_;
+    std::mutex mutex_;
+    int64_t floor_;     // 已知已经使用过的最大id
+};
+
+#endif // MSGIDALLOCATOR_H
@@ -15,9 +15,23 @@ msg_id_(msg_id) {
 
 }
 
+void RecvNode::reset(short msg_id) {
+    msg_id_ = msg_id;
+    cur_len_ = 0;
+}
+
 
 SendNode::SendNode(const char* msg, short max_len, short msg_id) :MsgNode(max_len + HEAD_TOTAL_LEN)
-, msg_id_(msg_id) {
+, capacity_(max_len + HEAD_TOTAL_LEN), msg_id_(msg_id) {
+    reset(msg, max_len, msg_id);
+}
+
+SendNode::SendNode(short capacity) :MsgNode(capacity), capacity_(capacity), msg_id_(0) {
+}
+
+void SendNode::reset(const char* msg, short max_len, short msg_id) {
+    msg_id_ = msg_id;
+    total_len_ = max_len + HEAD_TOTAL_LEN;
     //先发送id, 转为网络字节序
     short msg_id_host = boost::asio::detail::socket_ops::host_to_network_short(msg_id);
     memcpy(data_, &msg_id_host, HEAD_ID_LEN);
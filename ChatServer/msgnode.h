@@ -3,6 +3,7 @@
 
 #include <cstring>
 #include <iostream>
+#include "mpscqueue.h"
 
 /******************************************************************************
  * @file       msgnode.h
@@ -37,17 +38,26 @@ public:
 
 class RecvNode :public MsgNode {
     friend class LogicSystem;
+    friend class LogicWorker;
 public:
     RecvNode(short max_len, short msg_id);
+    // 复用节点时重置消息id和长度，缓冲区内容由下一次读取覆盖
+    void reset(short msg_id);
 private:
     short msg_id_;
 };
 
-class SendNode :public MsgNode {
+// 发送节点，直接作为会话发送队列（MpscQueue）的链表节点
+class SendNode :public MsgNode, public MpscNode<SendNode> {
     friend class LogicSystem;
 public:
     SendNode(const char* msg, short max_len, short msg_id);
+    // 节点池使用：预先分配capacity字节的缓冲区，之后由reset写入消息
+    explicit SendNode(short capacity);
+    // 写入消息头和消息体，复用节点时调用，头部加消息体不能超过缓冲区容量
+    void reset(const char* msg, short max_len, short msg_id);
 private:
+    short capacity_;
     short msg_id_;
 };
 
@@ -1,14 +1,25 @@
 ﻿#include "mysqldao.h"
 #include "configmgr.h"
-#include <queue>
+#include "msgidallocator.h"
+#include <map>
+#include <list>
+#include <deque>
+#include <array>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
 #include <iostream>
+#include <algorithm>
 
 #include <cppconn/driver.h>
 #include <cppconn/exception.h>
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
 #include <cppconn/prepared_statement.h>
+#include <cppconn/datatype.h>
 #include <mysql_driver.h>
 #include <mysql_connection.h>
 
@@ -21,71 +32,411 @@
  * @history
  *****************************************************************************/
 
-// mysql连接池
-class MysqlPool {
+// 每个连接最多缓存的预处理语句数，多行INSERT按行数生成不同的语句，需要限制数量
+static const std::size_t STMT_CACHE_CAPACITY = 64;
+
+// 池中的连接，按SQL文本缓存预处理语句，同一条语句只在服务端prepare一次
+// 连接同一时刻只借给一个调用方，缓存不需要加锁
+class SqlConnection {
 public:
-    MysqlPool(const std::string& url, const std::string& user, const std::string& pass, const std::string& schema, int poolSize)
-        : url_(url), user_(user), pass_(pass), schema_(schema), poolSize_(poolSize), b_stop_(false) {
+    explicit SqlConnection(std::unique_ptr<sql::Connection> con)
+        : con_(std::move(con)), last_oper_time_(std::chrono::steady_clock::now()), broken_(false) {}
+
+    ~SqlConnection() {
+        //语句需在连接之前释放
+        stmts_.clear();
+        lru_.clear();
+    }
+
+    // 取缓存的预处理语句，不存在时创建；语句归连接所有，调用方不要释放
+    sql::PreparedStatement* prepare(const std::string& query) {
+        auto iter = stmts_.find(query);
+        if (iter != stmts_.end()) {
+            lru_.splice(lru_.begin(), lru_, iter->second.lru_iter);
+            iter->second.stmt->clearParameters();
+            return iter->second.stmt.get();
+        }
+
+        std::unique_ptr<sql::PreparedStatement> stmt(con_->prepareStatement(query));
+        if (stmts_.size() >= STMT_CACHE_CAPACITY) {
+            stmts_.erase(lru_.back());
+            lru_.pop_back();
+        }
+        lru_.push_front(query);
+        auto* raw = stmt.get();
+        stmts_.emplace(query, CachedStmt{ std::move(stmt), lru_.begin() });
+        return raw;
+    }
+
+    // 行数可变的语句（多行INSERT、IN列表）每种行数都是不同的SQL，只有常见的行数进缓存，
+    // 其余的由holder持有、用完即释放，避免一次性的语句挤掉缓存中的热点语句
+    sql::PreparedStatement* prepare(const std::string& query, bool cacheable,
+        std::unique_ptr<sql::PreparedStatement>& holder) {
+        if (cacheable) {
+            return prepare(query);
+        }
+        holder.reset(con_->prepareStatement(query));
+        return holder.get();
+    }
+
+    // 连接级错误（客户端错误码2000~2999，或SQLSTATE为08开头的连接异常）说明连接已不可用，标记损坏
+    void checkBroken(const sql::SQLException& e) {
+        std::string state = e.getSQLState();
+        if ((e.getErrorCode() >= 2000 && e.getErrorCode() < 3000) || state.compare(0, 2, "08") == 0) {
+            markBroken();
+        }
+    }
+
+    // 标记连接损坏，缓存的语句随之失效，归还时连接池直接关闭该连接
+    void markBroken() {
+        broken_ = true;
+        stmts_.clear();
+        lru_.clear();
+    }
+
+    bool isBroken() const {
+        return broken_;
+    }
+
+    // 归还时记录时间，检查线程据此判断空闲时长
+    void touch() {
+        last_oper_time_ = std::chrono::steady_clock::now();
+    }
+
+    std::chrono::steady_clock::time_point lastOperTime() const {
+        return last_oper_time_;
+    }
+
+    // 执行SELECT 1检查连接是否可用
+    bool ping() {
         try {
-            for (int i = 0; i < poolSize_; ++i) {
-                sql::mysql::MySQL_Driver* driver = sql::mysql::get_mysql_driver_instance();
-                std::unique_ptr<sql::Connection> con(driver->connect(url_, user_, pass_));
-                con->setSchema(schema_);
-                pool_.push(std::move(con));
-            }
+            std::unique_ptr<sql::Statement> stmt(con_->createStatement());
+            std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT 1"));
+            return true;
         }
         catch (sql::SQLException& e) {
-            // 处理异常
-            std::cout << "mysql pool init failed" << std::endl;
+            std::cout << "Error keeping connection alive: " << e.what() << std::endl;
+            return false;
         }
     }
 
-    std::unique_ptr<sql::Connection> getConnection() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        cond_.wait(lock, [this] {
-            if (b_stop_) {
-                return true;
+    // 以下转发给底层连接，一次性的语句仍直接prepareStatement
+    sql::PreparedStatement* prepareStatement(const sql::SQLString& query) {
+        return con_->prepareStatement(query);
+    }
+
+    sql::Statement* createStatement() {
+        return con_->createStatement();
+    }
+
+    void setAutoCommit(bool autoCommit) {
+        con_->setAutoCommit(autoCommit);
+    }
+
+    void commit() {
+        con_->commit();
+    }
+
+    // 回滚失败说明连接已不可用，在catch中调用，不再抛出
+    void rollback() {
+        try {
+            con_->rollback();
+        }
+        catch (sql::SQLException& e) {
+            std::cout << "mysql rollback failed, error is " << e.what() << std::endl;
+            markBroken();
+        }
+    }
+
+private:
+    struct CachedStmt {
+        std::unique_ptr<sql::PreparedStatement> stmt;
+        std::list<std::string>::iterator lru_iter;
+    };
+
+    std::unique_ptr<sql::Connection> con_;
+    std::chrono::steady_clock::time_point last_oper_time_;
+    bool broken_;   // 出现过连接级错误
+    std::list<std::string> lru_;    // 最近使用的在前
+    std::unordered_map<std::string, CachedStmt> stmts_;
+};
+
+// 连接池的大小和检查参数
+struct MysqlPoolOptions {
+    int min_size = 5;                   // 常驻连接数
+    int max_size = 16;                  // 连接数上限，不够时按需新建
+    int checkout_timeout_ms = 3000;     // 借连接的最长等待时间，超时返回空
+    int keepalive_sec = 60;             // 空闲超过该时间的连接用SELECT 1检查
+    int idle_timeout_sec = 300;         // 超出常驻数的连接空闲超过该时间后关闭
+};
+
+// 借连接等待时间直方图的桶上限（毫秒），最后一个桶收集更长的等待
+static constexpr std::array<int64_t, 7> WAIT_BUCKETS_MS = { 1, 5, 10, 50, 100, 500, 1000 };
+
+// mysql连接池：预先建立min_size个连接，不够时增长到max_size，
+// 后台线程定期检查空闲连接、关闭多余的连接并补足常驻数
+class MysqlPool {
+public:
+    MysqlPool(const std::string& name, const std::string& url, const std::string& user, const std::string& pass,
+        const std::string& schema, const MysqlPoolOptions& options)
+        : name_(name), url_(url), user_(user), pass_(pass), schema_(schema), options_(options),
+        total_(0), b_stop_(false), failures_(0), reported_(0) {
+        for (auto& count : wait_counts_) {
+            count = 0;
+        }
+        for (int i = 0; i < options_.min_size; ++i) {
+            auto con = connect();
+            if (!con) {
+                //不足的部分由检查线程补足
+                break;
             }
-            return !pool_.empty(); });
-        if (b_stop_) {
-            return nullptr;
+            pool_.push_back(std::move(con));
+            ++total_;
         }
-        std::unique_ptr<sql::Connection> con(std::move(pool_.front()));
-        pool_.pop();
+
+        check_thread_ = std::thread([this]() {
+            int count = 0;
+            std::unique_lock<std::mutex> lock(check_mutex_);
+            while (!b_stop_) {
+                check_cond_.wait_for(lock, std::chrono::seconds(1));
+                if (b_stop_ || ++count < CHECK_INTERVAL_SEC) {
+                    continue;
+                }
+                count = 0;
+                lock.unlock();
+                checkConnection();
+                reportWait();
+                lock.lock();
+            }
+            });
+    }
+
+    // 借出连接，空闲连接用完且未达上限时新建，否则等待；超时或池已关闭返回空
+    std::unique_ptr<SqlConnection> getConnection() {
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::milliseconds(options_.checkout_timeout_ms);
+        std::unique_ptr<SqlConnection> con;
+        bool b_create = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (;;) {
+                if (b_stop_) {
+                    return nullptr;
+                }
+                //后进先出，多余的连接留在队首空闲，便于检查线程回收
+                if (!pool_.empty()) {
+                    con = std::move(pool_.back());
+                    pool_.pop_back();
+                    break;
+                }
+                if (total_ < options_.max_size) {
+                    ++total_;
+                    b_create = true;
+                    break;
+                }
+                if (cond_.wait_until(lock, deadline) == std::cv_status::timeout
+                    && pool_.empty() && total_ >= options_.max_size) {
+                    break;
+                }
+            }
+        }
+
+        if (b_create) {
+            //建立连接较慢，不持有锁
+            con = connect();
+            if (!con) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --total_;
+                cond_.notify_one();
+            }
+        }
+
+        recordWait(std::chrono::steady_clock::now() - start, con != nullptr);
         return con;
     }
 
-    void returnConnection(std::unique_ptr<sql::Connection> con) {
+    // 归还连接，损坏的连接直接关闭，空出的名额由借连接时新建或检查线程补足
+    void returnConnection(std::unique_ptr<SqlConnection> con) {
         std::unique_lock<std::mutex> lock(mutex_);
         if (b_stop_) {
             return;
         }
-        pool_.push(std::move(con));
+        if (con->isBroken()) {
+            --total_;
+            cond_.notify_one();
+            lock.unlock();
+            std::cout << "mysql " << name_ << " connection broken, drop it" << std::endl;
+            con.reset();
+            return;
+        }
+        con->touch();
+        pool_.push_back(std::move(con));
         cond_.notify_one();
     }
 
     void Close() {
-        b_stop_ = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            b_stop_ = true;
+        }
         cond_.notify_all();
+        {
+            std::lock_guard<std::mutex> lock(check_mutex_);
+            check_cond_.notify_all();
+        }
+        if (check_thread_.joinable()) {
+            check_thread_.join();
+        }
     }
 
     ~MysqlPool() {
+        Close();
         std::unique_lock<std::mutex> lock(mutex_);
-        while (!pool_.empty()) {
-            pool_.pop();
-        }
+        pool_.clear();
     }
 
 private:
+    // 检查线程的运行间隔（秒）
+    static const int CHECK_INTERVAL_SEC = 5;
+
+    std::unique_ptr<SqlConnection> connect() {
+        try {
+            sql::mysql::MySQL_Driver* driver = sql::mysql::get_mysql_driver_instance();
+            std::unique_ptr<sql::Connection> con(driver->connect(url_, user_, pass_));
+            con->setSchema(schema_);
+            return std::make_unique<SqlConnection>(std::move(con));
+        }
+        catch (sql::SQLException& e) {
+            std::cout << "mysql " << name_ << " connect failed, error is " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    // 检查空闲连接：多余的关闭，其余的SELECT 1保活，失效的丢弃，最后补足常驻数
+    void checkConnection() {
+        auto now = std::chrono::steady_clock::now();
+        std::vector<std::unique_ptr<SqlConnection>> idle_cons;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto iter = pool_.begin(); iter != pool_.end();) {
+                auto idle = now - (*iter)->lastOperTime();
+                if (idle < std::chrono::seconds(options_.keepalive_sec)) {
+                    ++iter;
+                    continue;
+                }
+                if (total_ > options_.min_size && idle >= std::chrono::seconds(options_.idle_timeout_sec)) {
+                    --total_;
+                }
+                else {
+                    idle_cons.push_back(std::move(*iter));
+                }
+                iter = pool_.erase(iter);
+            }
+        }
+
+        //检查期间这些连接不在池中，但仍计入total_
+        std::vector<std::unique_ptr<SqlConnection>> healthy_cons;
+        for (auto& con : idle_cons) {
+            if (con->ping()) {
+                con->touch();
+                healthy_cons.push_back(std::move(con));
+            }
+            else {
+                std::cout << "mysql " << name_ << " connection lost, drop it" << std::endl;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            total_ -= static_cast<int>(idle_cons.size() - healthy_cons.size());
+            for (auto& con : healthy_cons) {
+                pool_.push_front(std::move(con));
+                cond_.notify_one();
+            }
+            if (b_stop_) {
+                return;
+            }
+        }
+
+        //补足常驻连接
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (b_stop_ || total_ >= options_.min_size) {
+                    return;
+                }
+                ++total_;
+            }
+            auto con = connect();
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!con) {
+                --total_;
+                return;
+            }
+            pool_.push_back(std::move(con));
+            cond_.notify_one();
+        }
+    }
+
+    void recordWait(std::chrono::steady_clock::duration wait, bool b_success) {
+        if (!b_success) {
+            ++failures_;
+            return;
+        }
+        auto wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(wait).count();
+        std::size_t bucket = 0;
+        while (bucket < WAIT_BUCKETS_MS.size() && wait_ms > WAIT_BUCKETS_MS[bucket]) {
+            ++bucket;
+        }
+        ++wait_counts_[bucket];
+    }
+
+    // 有新的借出时输出累计的等待时间直方图，用于观察连接池是否不够用
+    void reportWait() {
+        uint64_t total = failures_;
+        std::string histogram;
+        for (std::size_t i = 0; i < wait_counts_.size(); ++i) {
+            uint64_t count = wait_counts_[i];
+            total += count;
+            histogram += (i < WAIT_BUCKETS_MS.size() ? " <=" + std::to_string(WAIT_BUCKETS_MS[i]) + "ms:"
+                : " >" + std::to_string(WAIT_BUCKETS_MS.back()) + "ms:") + std::to_string(count);
+        }
+        if (total == reported_) {
+            return;
+        }
+        reported_ = total;
+
+        int size = 0;
+        int idle = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size = total_;
+            idle = static_cast<int>(pool_.size());
+        }
+        std::cout << "mysql " << name_ << " pool size " << size << " idle " << idle
+            << ", checkout wait" << histogram << " failed:" << failures_ << std::endl;
+    }
+
+    std::string name_;
     std::string url_;
     std::string user_;
     std::string pass_;
     std::string schema_;
-    int poolSize_;
-    std::queue<std::unique_ptr<sql::Connection>> pool_;
+    MysqlPoolOptions options_;
+    int total_;     // 已建立的连接数，包括借出的
+    std::deque<std::unique_ptr<SqlConnection>> pool_;
     std::mutex mutex_;
     std::condition_variable cond_;
     std::atomic<bool> b_stop_;
+
+    std::thread check_thread_;
+    std::mutex check_mutex_;
+    std::condition_variable check_cond_;
+
+    // 借连接等待时间直方图，多一个桶收集超过最大上限的等待
+    std::array<std::atomic<uint64_t>, WAIT_BUCKETS_MS.size() + 1> wait_counts_;
+    std::atomic<uint64_t> failures_;    // 等待超时或新建连接失败的次数
+    uint64_t reported_;     // 上次输出时的借出总数，只在检查线程中访问
 };
 
 // RAII 类
@@ -106,20 +457,36 @@ public:
     }
 
     // 获取内部连接指针
-    sql::Connection* get() {
+    SqlConnection* get() {
         return con_.get();
     }
 
+    // 连接级错误时标记连接损坏，归还时丢弃
+    void checkBroken(const sql::SQLException& e) {
+        if (con_) {
+            con_->checkBroken(e);
+        }
+    }
+
     // 禁用拷贝，确保连接归还逻辑唯一
     MysqlConnGuard(const MysqlConnGuard&) = delete;
     MysqlConnGuard& operator=(const MysqlConnGuard&) = delete;
 
 private:
     std::unique_ptr<MysqlPool>& pool_;
-    std::unique_ptr<sql::Connection> con_;
+    std::unique_ptr<SqlConnection> con_;
 };
 
 
+// 读取[Mysql]中的正整数配置，未配置时保留默认值
+static void readPoolOption(const std::string& key, int& value) {
+    auto value_str = ConfigMgr::getInst()["Mysql"][key];
+    int parsed = value_str.empty() ? 0 : atoi(value_str.c_str());
+    if (parsed > 0) {
+        value = parsed;
+    }
+}
+
 MysqlDAO::MysqlDAO() {
     auto& cfg = ConfigMgr::getInst();
     const auto& host = cfg["Mysql"]["Host"];
@@ -127,11 +494,38 @@ MysqlDAO::MysqlDAO() {
     const auto& pwd = cfg["Mysql"]["Passwd"];
     const auto& schema = cfg["Mysql"]["Schema"];
     const auto& user = cfg["Mysql"]["User"];
-    pool_.reset(new MysqlPool(host + ":" + port, user, pwd, schema, 5));
+    MysqlPoolOptions options;
+    readPoolOption("PoolMinSize", options.min_size);
+    readPoolOption("PoolMaxSize", options.max_size);
+    readPoolOption("CheckoutTimeoutMs", options.checkout_timeout_ms);
+    readPoolOption("KeepAliveSec", options.keepalive_sec);
+    readPoolOption("IdleTimeoutSec", options.idle_timeout_sec);
+    options.max_size = std::max(options.max_size, options.min_size);
+    pool_.reset(new MysqlPool("primary", host + ":" + port, user, pwd, schema, options));
+    thread_index_ = cfg["Mysql"]["ThreadIndex"] == "true";
+
+    //配置了只读从库时，只读查询走从库，未配置的项沿用主库的
+    const auto& replica_host = cfg["MysqlReplica"]["Host"];
+    if (!replica_host.empty()) {
+        auto replica_value = [&cfg](const std::string& key) {
+            auto value = cfg["MysqlReplica"][key];
+            return value.empty() ? cfg["Mysql"][key] : value;
+            };
+        replica_pool_.reset(new MysqlPool("replica", replica_host + ":" + replica_value("Port"),
+            replica_value("User"), replica_value("Passwd"), replica_value("Schema"), options));
+    }
+}
+
+// 只读查询使用的连接池，没有从库时就是主库
+std::unique_ptr<MysqlPool>& MysqlDAO::readPool() {
+    return replica_pool_ ? replica_pool_ : pool_;
 }
 
 MysqlDAO::~MysqlDAO() {
     pool_->Close();
+    if (replica_pool_) {
+        replica_pool_->Close();
+    }
 }
 
 // 用户注册登记
@@ -165,6 +559,7 @@ int MysqlDAO::regUser(const std::string& name, const std::string& email, const s
         return -1;
     }
     catch (sql::SQLException& e) {
+        guard.checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -200,6 +595,7 @@ bool MysqlDAO::checkEmail(const std::string& name, const std::string& email) {
         }
     }
     catch (sql::SQLException& e) {
+        guard.checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -230,6 +626,7 @@ bool MysqlDAO::updatePwd(const std::string& name, const std::string& newpwd) {
         return true;
     }
     catch (sql::SQLException& e) {
+        guard.checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -271,6 +668,7 @@ bool MysqlDAO::checkPwd(const std::string& name, const std::string& pwd, UserInf
         return true;
     }
     catch (sql::SQLException& e) {
+        guard.checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -280,12 +678,15 @@ bool MysqlDAO::checkPwd(const std::string& name, const std::string& pwd, UserInf
 
 // 获取用户信息
 std::shared_ptr<UserInfo> MysqlDAO::getUser(int uid) {
-    MysqlConnGuard guard(pool_);
+    MysqlConnGuard guard(readPool());
     try {
         auto con = guard.get();
+        if (con == nullptr) {
+            return nullptr;
+        }
 
         // 准备SQL语句
-        std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement("SELECT * FROM user WHERE uid = ?"));
+        auto* pstmt = con->prepare("SELECT * FROM user WHERE uid = ?");
         pstmt->setInt(1, uid); // 将uid替换为你要查询的uid
 
         // 执行查询
@@ -307,6 +708,7 @@ std::shared_ptr<UserInfo> MysqlDAO::getUser(int uid) {
         return user_ptr;
     }
     catch (sql::SQLException& e) {
+        guard.checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -315,18 +717,18 @@ std::shared_ptr<UserInfo> MysqlDAO::getUser(int uid) {
 }
 
 std::shared_ptr<UserInfo> MysqlDAO::getUser(std::string name) {
-    auto con = pool_->getConnection();
+    auto con = readPool()->getConnection();
     if (con == nullptr) {
         return nullptr;
     }
 
     Defer defer([this, &con]() {
-        pool_->returnConnection(std::move(con));
+        readPool()->returnConnection(std::move(con));
         });
 
     try {
         // 准备SQL语句
-        std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement("SELECT * FROM user WHERE name = ?"));
+        auto* pstmt = con->prepare("SELECT * FROM user WHERE name = ?");
         pstmt->setString(1, name); // 将uid替换为你要查询的uid
 
         // 执行查询
@@ -347,6 +749,7 @@ std::shared_ptr<UserInfo> MysqlDAO::getUser(std::string name) {
         return user_ptr;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -386,6 +789,7 @@ bool MysqlDAO::addFriendApply(const int& from, const int& to,
         return true;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -422,6 +826,7 @@ bool MysqlDAO::authFriendApply(const int& from, const int& to) {
         return true;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -432,7 +837,89 @@ bool MysqlDAO::authFriendApply(const int& from, const int& to) {
     return true;
 }
 
+// 用户会话索引user_thread_index(user_id, thread_id, last_msg_id)，
+// 按(user_id, last_msg_id, thread_id)建索引，会话列表按最近活跃排序时只需一次索引范围扫描
+// 新建私聊时为双方各插入一行
+static void addThreadIndex(SqlConnection* con, int64_t thread_id, int user1_id, int user2_id) {
+    auto* pstmt = con->prepare(
+        "INSERT IGNORE INTO user_thread_index (user_id, thread_id, last_msg_id) VALUES (?, ?, 0), (?, ?, 0)"
+    );
+    pstmt->setInt(1, user1_id);
+    pstmt->setInt64(2, thread_id);
+    pstmt->setInt(3, user2_id);
+    pstmt->setInt64(4, thread_id);
+    pstmt->executeUpdate();
+}
+
+// 会话有新消息时更新成员的最近消息id，按thread_id索引更新
+static void touchThreadIndex(SqlConnection* con, int64_t thread_id, int64_t last_msg_id) {
+    auto* pstmt = con->prepare(
+        "UPDATE user_thread_index SET last_msg_id = GREATEST(last_msg_id, ?) WHERE thread_id = ?"
+    );
+    pstmt->setInt64(1, last_msg_id);
+    pstmt->setInt64(2, thread_id);
+    pstmt->executeUpdate();
+}
+
+// 一批消息按会话合并，每个会话只更新一次
+static void touchThreadIndex(SqlConnection* con, const std::vector<std::shared_ptr<ChatMessage>>& chat_datas) {
+    std::map<int64_t, int64_t> last_ids;
+    for (auto& msg : chat_datas) {
+        auto& last_id = last_ids[msg->thread_id];
+        last_id = std::max<int64_t>(last_id, msg->message_id);
+    }
+    for (auto& [thread_id, last_id] : last_ids) {
+        touchThreadIndex(con, thread_id, last_id);
+    }
+}
+
 // 添加联系人好友
+// 插入一条好友相关的通知消息，返回消息id，失败返回0
+// 启用写后持久化时id由分配器分配并显式写入，避免和已分配但还没落库的id冲突；
+// 分配的id记入allocs，由调用方在事务结束后撤销未落库登记
+static int64_t insertNoticeMsg(SqlConnection* con, int64_t thread_id, int sender_id, int recv_id,
+    const std::string& content, std::vector<int64_t>& allocs) {
+    int64_t message_id = 0;
+    auto allocator = MsgIdAllocator::getInstance();
+    if (allocator->enabled()) {
+        message_id = allocator->allocate();
+        if (message_id == 0) {
+            return 0;
+        }
+        allocs.push_back(message_id);
+    }
+
+    auto* msgStmt = con->prepare(
+        "INSERT INTO chat_message(message_id, thread_id, sender_id, recv_id, content, created_at, updated_at, status) "
+        "VALUES (?, ?, ?, ?, ?, NOW(), NOW(), ?)"
+    );
+    //NULL由自增列生成id
+    if (message_id > 0) {
+        msgStmt->setInt64(1, message_id);
+    }
+    else {
+        msgStmt->setNull(1, sql::DataType::BIGINT);
+    }
+    msgStmt->setInt64(2, thread_id);
+    msgStmt->setInt(3, sender_id);
+    msgStmt->setInt(4, recv_id);
+    msgStmt->setString(5, content);
+    msgStmt->setInt(6, 2);
+
+    if (msgStmt->executeUpdate() < 0) {
+        return 0;
+    }
+    if (message_id > 0) {
+        return message_id;
+    }
+
+    std::unique_ptr<sql::Statement> stmt(con->createStatement());
+    std::unique_ptr<sql::ResultSet> rs(
+        stmt->executeQuery("SELECT LAST_INSERT_ID()")
+    );
+    return rs->next() ? rs->getInt64(1) : 0;
+}
+
 bool MysqlDAO::addFriend(const int& from, const int& to, std::string back_name,
     std::vector<std::shared_ptr<AddFriendMsg>>& chat_datas) {
     auto con = pool_->getConnection();
@@ -443,6 +930,11 @@ bool MysqlDAO::addFriend(const int& from, const int& to, std::string back_name,
     Defer defer([this, &con]() {
         pool_->returnConnection(std::move(con));
         });
+    //事务提交或回滚之后再撤销通知消息id的登记
+    std::vector<int64_t> notice_allocs;
+    Defer release_defer([&notice_allocs]() {
+        MsgIdAllocator::getInstance()->release(notice_allocs);
+        });
 
     try {
         // 开始事务
@@ -582,34 +1074,16 @@ bool MysqlDAO::addFriend(const int& from, const int& to, std::string back_name,
                 con->rollback();
                 return false;
             }
+            if (thread_index_) {
+                addThreadIndex(con.get(), threadId, from, to);
+            }
         }
 
         // 6. 插入初始消息（申请描述）
         if (!apply_desc.empty())
         {
-            std::unique_ptr<sql::PreparedStatement> msgStmt(con->prepareStatement(
-                "INSERT INTO chat_message(thread_id, sender_id, recv_id, content, created_at, updated_at, status) "
-                "VALUES (?, ?, ?, ?, NOW(), NOW(), ?)"
-            ));
-
-            msgStmt->setInt64(1, threadId);
-            msgStmt->setInt(2, to);
-            msgStmt->setInt(3, from);
-            msgStmt->setString(4, apply_desc);
-            msgStmt->setInt(5, 2);
-
-            if (msgStmt->executeUpdate() < 0) {
-                con->rollback();
-                return false;
-            }
-
-            std::unique_ptr<sql::Statement> stmt(con->createStatement());
-            std::unique_ptr<sql::ResultSet> rs(
-                stmt->executeQuery("SELECT LAST_INSERT_ID()")
-            );
-
-            if (rs->next()) {
-                auto messageId = rs->getInt64(1);
+            auto messageId = insertNoticeMsg(con.get(), threadId, to, from, apply_desc, notice_allocs);
+            if (messageId > 0) {
                 auto tx_data = std::make_shared<AddFriendMsg>();
                 tx_data->set_sender_id(to);
                 tx_data->set_msg_id(messageId);
@@ -628,29 +1102,8 @@ bool MysqlDAO::addFriend(const int& from, const int& to, std::string back_name,
 
         // 7. 插入成为好友的消息
         {
-            std::unique_ptr<sql::PreparedStatement> msgStmt(con->prepareStatement(
-                "INSERT INTO chat_message(thread_id, sender_id, recv_id, content, created_at, updated_at, status) "
-                "VALUES (?, ?, ?, ?, NOW(), NOW(), ?)"
-            ));
-
-            msgStmt->setInt64(1, threadId);
-            msgStmt->setInt(2, from);
-            msgStmt->setInt(3, to);
-            msgStmt->setString(4, "We are friends now!");
-            msgStmt->setInt(5, 2);
-
-            if (msgStmt->executeUpdate() < 0) {
-                con->rollback();
-                return false;
-            }
-
-            std::unique_ptr<sql::Statement> stmt(con->createStatement());
-            std::unique_ptr<sql::ResultSet> rs(
-                stmt->executeQuery("SELECT LAST_INSERT_ID()")
-            );
-
-            if (rs->next()) {
-                auto messageId = rs->getInt64(1);
+            auto messageId = insertNoticeMsg(con.get(), threadId, from, to, "We are friends now!", notice_allocs);
+            if (messageId > 0) {
                 auto tx_data = std::make_shared<AddFriendMsg>();
                 tx_data->set_sender_id(from);
                 tx_data->set_msg_id(messageId);
@@ -659,6 +1112,9 @@ bool MysqlDAO::addFriend(const int& from, const int& to, std::string back_name,
                 tx_data->set_unique_id("");
                 tx_data->set_status(2);
                 chat_datas.push_back(tx_data);
+                if (thread_index_) {
+                    touchThreadIndex(con.get(), threadId, messageId);
+                }
             }
             else {
                 con->rollback();
@@ -673,6 +1129,7 @@ bool MysqlDAO::addFriend(const int& from, const int& to, std::string back_name,
         return true;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         // 如果发生错误，回滚事务
         if (con) {
             con->rollback();
@@ -696,13 +1153,13 @@ bool MysqlDAO::addFriend(const int& from, const int& to, std::string back_name,
 
 // 获取好友请求列表
 bool MysqlDAO::getApplyList(int touid, std::vector<std::shared_ptr<ApplyInfo>>& applyList, int begin, int limit) {
-    auto con = pool_->getConnection();
+    auto con = readPool()->getConnection();
     if (con == nullptr) {
         return false;
     }
 
     Defer defer([this, &con]() {
-        pool_->returnConnection(std::move(con));
+        readPool()->returnConnection(std::move(con));
         });
 
 
@@ -730,6 +1187,7 @@ bool MysqlDAO::getApplyList(int touid, std::vector<std::shared_ptr<ApplyInfo>>&
         return true;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -738,7 +1196,8 @@ bool MysqlDAO::getApplyList(int touid, std::vector<std::shared_ptr<ApplyInfo>>&
 }
 
 // 获取用户好友列表
-bool MysqlDAO::getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo> >& user_info_list) {
+bool MysqlDAO::getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo> >& user_info_list,
+    int after_uid, int limit) {
 
     auto con = pool_->getConnection();
     if (con == nullptr) {
@@ -751,29 +1210,39 @@ bool MysqlDAO::getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo>
 
 
     try {
-        // 准备SQL语句, 根据起始id和限制条数返回列表
-        std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement("select * from friend where self_id = ? "));
-
-        pstmt->setInt(1, self_id); // 将uid替换为你要查询的uid
+        // 联表一次取回好友的用户信息，按好友uid翻页，不再逐个查询user表
+        std::string query = "SELECT f.friend_id, u.name, u.email, u.nick, u.`desc`, u.sex, u.icon "
+            "FROM friend f JOIN user u ON u.uid = f.friend_id "
+            "WHERE f.self_id = ? AND f.friend_id > ? ORDER BY f.friend_id";
+        if (limit > 0) {
+            query += " LIMIT ?";
+        }
+        auto* pstmt = con->prepare(query);
+        pstmt->setInt(1, self_id);
+        pstmt->setInt(2, after_uid);
+        if (limit > 0) {
+            pstmt->setInt(3, limit);
+        }
 
         // 执行查询
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
         // 遍历结果集
         while (res->next()) {
-            auto friend_id = res->getInt("friend_id");
-            auto back = res->getString("back");
-            //再一次查询friend_id对应的信息
-            auto user_info = getUser(friend_id);
-            if (user_info == nullptr) {
-                continue;
-            }
-
+            auto user_info = std::make_shared<UserInfo>();
+            user_info->uid = res->getInt("friend_id");
+            user_info->name = res->getString("name");
+            user_info->email = res->getString("email");
+            user_info->nick = res->getString("nick");
+            user_info->desc = res->getString("desc");
+            user_info->sex = res->getInt("sex");
+            user_info->icon = res->getString("icon");
             user_info->back = user_info->name;
             user_info_list.push_back(user_info);
         }
         return true;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what();
         std::cerr << " (MySQL error code: " << e.getErrorCode();
         std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
@@ -783,58 +1252,105 @@ bool MysqlDAO::getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo>
     return true;
 }
 
-// 获取用户从lastid开始的聊天线程
+// 获取用户从游标开始的聊天线程
 bool MysqlDAO::getUserThreads(
     int64_t userId,
-    int64_t lastId,
+    ChatThreadCursor& cursor,
     int      pageSize,
     std::vector<std::shared_ptr<ChatThreadInfo>>& threads,
-    bool& loadMore,
-    int64_t& nextLastId) {
+    bool& loadMore) {
     // 初始状态
     loadMore = false;
-    nextLastId = lastId;
     threads.clear();
 
-    auto con = pool_->getConnection();
+    // 启用写后持久化时快照取自已提交水位线，它按主库计算，列表也改读主库
+    auto allocator = MsgIdAllocator::getInstance();
+    auto& pool = (thread_index_ && allocator->enabled()) ? pool_ : readPool();
+    auto con = pool->getConnection();
     if (!con) {
         return false;
     }
-    Defer defer([this, &con]() {
-        pool_->returnConnection(std::move(con));
+    Defer defer([&pool, &con]() {
+        pool->returnConnection(std::move(con));
         });
     auto& conn = con;
 
     try {
-        // 准备分页查询：CTE + UNION ALL + ORDER + LIMIT N+1
-        std::string sql =
-            "WITH all_threads AS ( "
-            "  SELECT thread_id, 'private' AS type, user1_id, user2_id "
-            "    FROM private_chat "
-            "   WHERE (user1_id = ? OR user2_id = ?) "
-            "     AND thread_id > ? "
-            "  UNION ALL "
-            "  SELECT thread_id, 'group'   AS type, 0 AS user1_id, 0 AS user2_id "
-            "    FROM group_chat_member "
-            "   WHERE user_id   = ? "
-            "     AND thread_id > ? "
-            ") "
-            "SELECT thread_id, type, user1_id, user2_id "
-            "  FROM all_threads "
-            " ORDER BY thread_id "
-            " LIMIT ?;";
-
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            conn->prepareStatement(sql));
+        sql::PreparedStatement* pstmt = nullptr;
+        if (thread_index_) {
+            // 第一页记下快照：小于等于它的消息都已提交，之后会话的last_msg_id只会变得更大
+            if (cursor._thread_id == 0) {
+                if (allocator->enabled()) {
+                    cursor._snapshot = allocator->committedId();
+                    if (cursor._snapshot < 0) {
+                        return false;
+                    }
+                }
+                else {
+                    std::unique_ptr<sql::Statement> stmt(conn->createStatement());
+                    std::unique_ptr<sql::ResultSet> rs(
+                        stmt->executeQuery("SELECT COALESCE(MAX(message_id), 0) FROM chat_message")
+                    );
+                    cursor._snapshot = rs->next() ? rs->getInt64(1) : 0;
+                }
+            }
 
-        // 绑定参数：? 对应 (userId, userId, lastId, userId, lastId, pageSize+1)
-        int idx = 1;
-        pstmt->setInt64(idx++, userId);              // private.user1_id
-        pstmt->setInt64(idx++, userId);              // private.user2_id
-        pstmt->setInt64(idx++, lastId);              // private.thread_id > lastId
-        pstmt->setInt64(idx++, userId);              // group.user_id
-        pstmt->setInt64(idx++, lastId);              // group.thread_id > lastId
-        pstmt->setInt(idx++, pageSize + 1);          // LIMIT pageSize+1
+            // 按最近活跃倒序：(last_msg_id, thread_id)上的索引范围扫描，只列出快照时的排序，
+            // 游标直接使用上一页最后一个会话当时的位置，游标会话之后有新消息不会让翻页回到开头
+            std::string sql =
+                "SELECT t.thread_id, t.last_msg_id, IF(p.thread_id IS NULL, 'group', 'private') AS type, "
+                "       COALESCE(p.user1_id, 0) AS user1_id, COALESCE(p.user2_id, 0) AS user2_id "
+                "  FROM user_thread_index t "
+                "  LEFT JOIN private_chat p ON p.thread_id = t.thread_id "
+                " WHERE t.user_id = ? AND t.last_msg_id <= ? ";
+            if (cursor._thread_id > 0) {
+                sql += "   AND (t.last_msg_id < ? "
+                    "        OR (t.last_msg_id = ? AND t.thread_id < ?)) ";
+            }
+            sql += " ORDER BY t.last_msg_id DESC, t.thread_id DESC "
+                " LIMIT ?";
+
+            pstmt = conn->prepare(sql);
+            int idx = 1;
+            pstmt->setInt64(idx++, userId);
+            pstmt->setInt64(idx++, cursor._snapshot);
+            if (cursor._thread_id > 0) {
+                pstmt->setInt64(idx++, cursor._last_msg_id);
+                pstmt->setInt64(idx++, cursor._last_msg_id);
+                pstmt->setInt64(idx++, cursor._thread_id);
+            }
+            pstmt->setInt(idx++, pageSize + 1);          // LIMIT pageSize+1
+        }
+        else {
+            // 准备分页查询：CTE + UNION ALL + ORDER + LIMIT N+1
+            std::string sql =
+                "WITH all_threads AS ( "
+                "  SELECT thread_id, 'private' AS type, user1_id, user2_id "
+                "    FROM private_chat "
+                "   WHERE (user1_id = ? OR user2_id = ?) "
+                "     AND thread_id > ? "
+                "  UNION ALL "
+                "  SELECT thread_id, 'group'   AS type, 0 AS user1_id, 0 AS user2_id "
+                "    FROM group_chat_member "
+                "   WHERE user_id   = ? "
+                "     AND thread_id > ? "
+                ") "
+                "SELECT thread_id, type, user1_id, user2_id "
+                "  FROM all_threads "
+                " ORDER BY thread_id "
+                " LIMIT ?;";
+
+            pstmt = conn->prepare(sql);
+
+            // 绑定参数：? 对应 (userId, userId, thread_id, userId, thread_id, pageSize+1)
+            int idx = 1;
+            pstmt->setInt64(idx++, userId);              // private.user1_id
+            pstmt->setInt64(idx++, userId);              // private.user2_id
+            pstmt->setInt64(idx++, cursor._thread_id);   // private.thread_id > thread_id
+            pstmt->setInt64(idx++, userId);              // group.user_id
+            pstmt->setInt64(idx++, cursor._thread_id);   // group.thread_id > thread_id
+            pstmt->setInt(idx++, pageSize + 1);          // LIMIT pageSize+1
+        }
 
         // 执行
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
@@ -847,6 +1363,7 @@ bool MysqlDAO::getUserThreads(
             cti->_type = res->getString("type");
             cti->_user1_id = res->getInt64("user1_id");
             cti->_user2_id = res->getInt64("user2_id");
+            cti->_last_msg_id = thread_index_ ? res->getInt64("last_msg_id") : 0;
             tmp.push_back(cti);
         }
 
@@ -856,15 +1373,42 @@ bool MysqlDAO::getUserThreads(
             tmp.pop_back();  // 丢掉第 pageSize+1 条
         }
 
-        // 如果还有数据，更新 nextLastId 为最后一条的 thread_id
+        // 如果还有数据，游标移到最后一条
         if (!tmp.empty()) {
-            nextLastId = tmp.back()->_thread_id;
+            cursor._thread_id = tmp.back()->_thread_id;
+            cursor._last_msg_id = tmp.back()->_last_msg_id;
+        }
+
+        // 最后一页附带快照之后有新消息的会话，它们已移到列表顶部，翻页中没有返回
+        if (thread_index_ && !loadMore) {
+            auto* changedStmt = conn->prepare(
+                "SELECT t.thread_id, t.last_msg_id, IF(p.thread_id IS NULL, 'group', 'private') AS type, "
+                "       COALESCE(p.user1_id, 0) AS user1_id, COALESCE(p.user2_id, 0) AS user2_id "
+                "  FROM user_thread_index t "
+                "  LEFT JOIN private_chat p ON p.thread_id = t.thread_id "
+                " WHERE t.user_id = ? AND t.last_msg_id > ? "
+                " ORDER BY t.last_msg_id DESC, t.thread_id DESC"
+            );
+            changedStmt->setInt64(1, userId);
+            changedStmt->setInt64(2, cursor._snapshot);
+            std::unique_ptr<sql::ResultSet> changedRes(changedStmt->executeQuery());
+            while (changedRes->next()) {
+                auto cti = std::make_shared<ChatThreadInfo>();
+                cti->_thread_id = changedRes->getInt64("thread_id");
+                cti->_type = changedRes->getString("type");
+                cti->_user1_id = changedRes->getInt64("user1_id");
+                cti->_user2_id = changedRes->getInt64("user2_id");
+                cti->_last_msg_id = changedRes->getInt64("last_msg_id");
+                cti->_changed = true;
+                tmp.push_back(cti);
+            }
         }
 
         // 移入输出向量
         threads = std::move(tmp);
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what()
             << " (MySQL error code: " << e.getErrorCode()
             << ", SQLState: " << e.getSQLState() << ")\n";
@@ -933,12 +1477,16 @@ bool MysqlDAO::createPrivateChat(int user1_id, int user2_id, int& thread_id) {
         pstmt_insert_private->setInt64(2, uid1);
         pstmt_insert_private->setInt64(3, uid2);
         pstmt_insert_private->executeUpdate();
+        if (thread_index_) {
+            addThreadIndex(conn.get(), thread_id, uid1, uid2);
+        }
 
         // 提交事务
         conn->commit();
         return true;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what() << std::endl;
         conn->rollback();
         return false;
@@ -947,13 +1495,16 @@ bool MysqlDAO::createPrivateChat(int user1_id, int user2_id, int& thread_id) {
 }
 
 // 加载聊天消息
-std::shared_ptr<PageResult> MysqlDAO::loadChatMsg(int thread_id, int last_message_id, int page_size) {
-    auto con = pool_->getConnection();
+// 启用写后持久化时max_message_id为已提交的水位线，水位线按主库的提交计算，
+// 从库可能还没复制到水位线之下的消息，此时改读主库
+std::shared_ptr<PageResult> MysqlDAO::loadChatMsg(int thread_id, int last_message_id, int max_message_id, int page_size) {
+    auto& pool = MsgIdAllocator::getInstance()->enabled() ? pool_ : readPool();
+    auto con = pool->getConnection();
     if (!con) {
         return nullptr;
     }
-    Defer defer([this, &con]() {
-        pool_->returnConnection(std::move(con));
+    Defer defer([&pool, &con]() {
+        pool->returnConnection(std::move(con));
         });
     auto& conn = con;
 
@@ -968,17 +1519,17 @@ std::shared_ptr<PageResult> MysqlDAO::loadChatMsg(int thread_id, int last_messag
         FROM chat_message
         WHERE thread_id = ?
           AND message_id > ?
+          AND message_id <= ?
         ORDER BY message_id ASC
         LIMIT ?
 		)";
 
         uint32_t fetch_limit = page_size + 1;
-        auto pstmt = std::unique_ptr<sql::PreparedStatement>(
-            conn->prepareStatement(sql)
-        );
+        auto* pstmt = conn->prepare(sql);
         pstmt->setInt(1, thread_id);
         pstmt->setInt(2, last_message_id);
-        pstmt->setInt(3, fetch_limit);
+        pstmt->setInt(3, max_message_id);
+        pstmt->setInt(4, fetch_limit);
 
         auto rs = std::unique_ptr<sql::ResultSet>(pstmt->executeQuery());
 
@@ -1011,6 +1562,7 @@ std::shared_ptr<PageResult> MysqlDAO::loadChatMsg(int thread_id, int last_messag
         return page_res;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what() << std::endl;
         //conn->rollback();
         return nullptr;
@@ -1019,8 +1571,59 @@ std::shared_ptr<PageResult> MysqlDAO::loadChatMsg(int thread_id, int last_messag
 
 }
 
+// 加载会话最近的消息，用于建立消息缓存窗口；窗口声明下界之上的消息完整，
+// 只能读主库，副本的复制延迟会让窗口缺少刚写入的消息
+bool MysqlDAO::loadLatestChatMsg(int thread_id, int limit, std::vector<ChatMessage>& messages) {
+    auto con = pool_->getConnection();
+    if (!con) {
+        return false;
+    }
+    Defer defer([this, &con]() {
+        pool_->returnConnection(std::move(con));
+        });
+
+    try {
+        auto* pstmt = con->prepare(
+            "SELECT message_id, thread_id, sender_id, recv_id, content, created_at, status, msg_type "
+            "FROM chat_message WHERE thread_id = ? ORDER BY message_id DESC LIMIT ?"
+        );
+        pstmt->setInt(1, thread_id);
+        pstmt->setInt(2, limit);
+
+        auto rs = std::unique_ptr<sql::ResultSet>(pstmt->executeQuery());
+        while (rs->next()) {
+            ChatMessage msg;
+            msg.message_id = rs->getUInt64("message_id");
+            msg.thread_id = rs->getUInt64("thread_id");
+            msg.sender_id = rs->getUInt64("sender_id");
+            msg.recv_id = rs->getUInt64("recv_id");
+            msg.content = rs->getString("content");
+            msg.chat_time = rs->getString("created_at");
+            msg.status = rs->getInt("status");
+            msg.msg_type = rs->getInt("msg_type");
+            messages.push_back(std::move(msg));
+        }
+        return true;
+    }
+    catch (sql::SQLException& e) {
+        con->checkBroken(e);
+        std::cerr << "SQLException: " << e.what() << std::endl;
+        return false;
+    }
+}
+
 // 添加聊天消息
+// 一条INSERT最多插入的消息数，避免语句超过max_allowed_packet
+static const std::size_t CHAT_MSG_INSERT_BATCH = 500;
+
+// 批量插入聊天消息，每批一条多行INSERT，整体在一个事务中
+// 多行INSERT的自增id是连续的（simple insert，innodb_autoinc_lock_mode为0/1，
+// 或为2但没有并发的INSERT ... SELECT/LOAD DATA），LAST_INSERT_ID()返回第一行的id，
+// 其余按auto_increment_increment递增推算
 bool MysqlDAO::addChatMsg(std::vector<std::shared_ptr<ChatMessage>>& chat_datas) {
+    if (chat_datas.empty()) {
+        return true;
+    }
     auto con = pool_->getConnection();
     if (!con) {
         return false;
@@ -1034,47 +1637,61 @@ bool MysqlDAO::addChatMsg(std::vector<std::shared_ptr<ChatMessage>>& chat_datas)
     try {
         //关闭自动提交，以手动管理事务
         conn->setAutoCommit(false);
-        auto pstmt = std::unique_ptr<sql::PreparedStatement>(
-            conn->prepareStatement(
-                "INSERT INTO chat_message "
-                "(thread_id, sender_id, recv_id, content, created_at, updated_at, status,msg_type) "
-                "VALUES (?, ?, ?, ?, ?, ?, ?,?)"
-            )
+        std::unique_ptr<sql::Statement> keyStmt(
+            conn->createStatement()
         );
 
-        for (auto& msg : chat_datas) {
-            // 普通字段
-            pstmt->setUInt64(1, msg->thread_id);
-            pstmt->setUInt64(2, msg->sender_id);
-            pstmt->setUInt64(3, msg->recv_id);
-            pstmt->setString(4, msg->content);
-
-            pstmt->setString(5, msg->chat_time);  // created_at
-            pstmt->setString(6, msg->chat_time);  // updated_at
-
-            pstmt->setInt(7, msg->status);
-            pstmt->setInt(8, msg->msg_type);
+        for (std::size_t begin = 0; begin < chat_datas.size(); begin += CHAT_MSG_INSERT_BATCH) {
+            auto count = std::min(CHAT_MSG_INSERT_BATCH, chat_datas.size() - begin);
+            std::string insert_sql = "INSERT INTO chat_message "
+                "(thread_id, sender_id, recv_id, content, created_at, updated_at, status,msg_type) VALUES ";
+            for (std::size_t i = 0; i < count; ++i) {
+                insert_sql += (i == 0 ? "(?, ?, ?, ?, ?, ?, ?,?)" : ",(?, ?, ?, ?, ?, ?, ?,?)");
+            }
+            //只缓存单条和整批两种语句
+            std::unique_ptr<sql::PreparedStatement> oneoff;
+            auto* pstmt = conn->prepare(insert_sql, count == 1 || count == CHAT_MSG_INSERT_BATCH, oneoff);
+
+            for (std::size_t i = 0; i < count; ++i) {
+                auto& msg = chat_datas[begin + i];
+                int base = static_cast<int>(i) * 8;
+                // 普通字段
+                pstmt->setUInt64(base + 1, msg->thread_id);
+                pstmt->setUInt64(base + 2, msg->sender_id);
+                pstmt->setUInt64(base + 3, msg->recv_id);
+                pstmt->setString(base + 4, msg->content);
+
+                pstmt->setString(base + 5, msg->chat_time);  // created_at
+                pstmt->setString(base + 6, msg->chat_time);  // updated_at
+
+                pstmt->setInt(base + 7, msg->status);
+                pstmt->setInt(base + 8, msg->msg_type);
+            }
             pstmt->executeUpdate();
 
-            // 2. 取 LAST_INSERT_ID()
-            std::unique_ptr<sql::Statement> keyStmt(
-                conn->createStatement()
-            );
+            // 取第一行的id和自增步长，一次查询
             std::unique_ptr<sql::ResultSet> rs(
-                keyStmt->executeQuery("SELECT LAST_INSERT_ID()")
+                keyStmt->executeQuery("SELECT LAST_INSERT_ID(), @@auto_increment_increment")
             );
-            if (rs->next()) {
-                msg->message_id = rs->getUInt64(1);
+            if (!rs->next()) {
+                conn->rollback();
+                return false;
             }
-            else {
-                continue;
+            auto first_id = rs->getUInt64(1);
+            auto step = rs->getUInt64(2);
+            for (std::size_t i = 0; i < count; ++i) {
+                chat_datas[begin + i]->message_id = first_id + i * step;
             }
         }
+        if (thread_index_) {
+            touchThreadIndex(conn.get(), chat_datas);
+        }
 
         conn->commit();
         return true;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what() << std::endl;
         conn->rollback();
         return false;
@@ -1096,12 +1713,10 @@ bool MysqlDAO::addChatMsg(std::shared_ptr<ChatMessage> chat_data) {
     try {
         //关闭自动提交，以手动管理事务
         conn->setAutoCommit(false);
-        auto pstmt = std::unique_ptr<sql::PreparedStatement>(
-            conn->prepareStatement(
-                "INSERT INTO chat_message "
-                "(thread_id, sender_id, recv_id, content, created_at, updated_at, status,msg_type) "
-                "VALUES (?, ?, ?, ?, ?, ?, ?,?)"
-            )
+        auto* pstmt = conn->prepare(
+            "INSERT INTO chat_message "
+            "(thread_id, sender_id, recv_id, content, created_at, updated_at, status,msg_type) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?,?)"
         );
 
         // 绑定参数
@@ -1126,17 +1741,147 @@ bool MysqlDAO::addChatMsg(std::shared_ptr<ChatMessage> chat_data) {
         if (rs->next()) {
             chat_data->message_id = rs->getUInt64(1);
         }
+        if (thread_index_) {
+            touchThreadIndex(conn.get(), chat_data->thread_id, chat_data->message_id);
+        }
 
         conn->commit();
         return true;
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "SQLException: " << e.what() << std::endl;
         conn->rollback();
         return false;
     }
 }
 
+// 按已分配的message_id批量插入，每批一条多行INSERT IGNORE，整体在一个事务中
+bool MysqlDAO::insertChatMsgs(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas, bool& b_transient) {
+    b_transient = true;
+    if (chat_datas.empty()) {
+        return true;
+    }
+    auto con = pool_->getConnection();
+    if (!con) {
+        return false;
+    }
+    Defer defer([this, &con]() {
+        pool_->returnConnection(std::move(con));
+        });
+    auto& conn = con;
+
+    try {
+        //关闭自动提交，以手动管理事务
+        conn->setAutoCommit(false);
+        std::size_t inserted = 0;
+        for (std::size_t begin = 0; begin < chat_datas.size(); begin += CHAT_MSG_INSERT_BATCH) {
+            auto count = std::min(CHAT_MSG_INSERT_BATCH, chat_datas.size() - begin);
+            std::string insert_sql = "INSERT IGNORE INTO chat_message "
+                "(message_id, thread_id, sender_id, recv_id, content, created_at, updated_at, status,msg_type) VALUES ";
+            for (std::size_t i = 0; i < count; ++i) {
+                insert_sql += (i == 0 ? "(?, ?, ?, ?, ?, ?, ?, ?,?)" : ",(?, ?, ?, ?, ?, ?, ?, ?,?)");
+            }
+            //只缓存单条和整批两种语句
+            std::unique_ptr<sql::PreparedStatement> oneoff;
+            auto* pstmt = conn->prepare(insert_sql, count == 1 || count == CHAT_MSG_INSERT_BATCH, oneoff);
+
+            for (std::size_t i = 0; i < count; ++i) {
+                auto& msg = chat_datas[begin + i];
+                int base = static_cast<int>(i) * 9;
+                pstmt->setUInt64(base + 1, msg->message_id);
+                pstmt->setUInt64(base + 2, msg->thread_id);
+                pstmt->setUInt64(base + 3, msg->sender_id);
+                pstmt->setUInt64(base + 4, msg->recv_id);
+                pstmt->setString(base + 5, msg->content);
+                pstmt->setString(base + 6, msg->chat_time);  // created_at
+                pstmt->setString(base + 7, msg->chat_time);  // updated_at
+                pstmt->setInt(base + 8, msg->status);
+                pstmt->setInt(base + 9, msg->msg_type);
+            }
+            inserted += pstmt->executeUpdate();
+        }
+        if (thread_index_) {
+            touchThreadIndex(conn.get(), chat_datas);
+        }
+
+        conn->commit();
+        if (inserted != chat_datas.size()) {
+            std::cout << "insert chat msgs ignored " << chat_datas.size() - inserted << " existing message ids" << std::endl;
+        }
+        return true;
+    }
+    catch (sql::SQLException& e) {
+        con->checkBroken(e);
+        std::cerr << "SQLException: " << e.what() << std::endl;
+        conn->rollback();
+        //1213死锁、1205锁等待超时和连接错误重试即可恢复，其余是行数据本身的问题
+        b_transient = con->isBroken() || e.getErrorCode() == 1213 || e.getErrorCode() == 1205;
+        return false;
+    }
+}
+
+// 批量更新消息状态
+bool MysqlDAO::updateChatMsgStatus(const std::vector<int>& message_ids, int status) {
+    if (message_ids.empty()) {
+        return true;
+    }
+    auto con = pool_->getConnection();
+    if (!con) {
+        return false;
+    }
+    Defer defer([this, &con]() {
+        pool_->returnConnection(std::move(con));
+        });
+
+    try {
+        std::string update_sql = "UPDATE chat_message SET status = ? WHERE message_id IN (";
+        for (std::size_t i = 0; i < message_ids.size(); ++i) {
+            update_sql += (i == 0 ? "?" : ",?");
+        }
+        update_sql += ")";
+        std::unique_ptr<sql::PreparedStatement> oneoff;
+        auto* pstmt = con->prepare(update_sql, message_ids.size() == 1, oneoff);
+        pstmt->setInt(1, status);
+        for (std::size_t i = 0; i < message_ids.size(); ++i) {
+            pstmt->setInt(static_cast<int>(i) + 2, message_ids[i]);
+        }
+        pstmt->executeUpdate();
+        return true;
+    }
+    catch (sql::SQLException& e) {
+        con->checkBroken(e);
+        std::cerr << "SQLException: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+int64_t MysqlDAO::getMaxChatMsgId() {
+    auto con = pool_->getConnection();
+    if (!con) {
+        return -1;
+    }
+    Defer defer([this, &con]() {
+        pool_->returnConnection(std::move(con));
+        });
+
+    try {
+        std::unique_ptr<sql::Statement> stmt(con->createStatement());
+        std::unique_ptr<sql::ResultSet> rs(
+            stmt->executeQuery("SELECT COALESCE(MAX(message_id), 0) FROM chat_message")
+        );
+        if (rs->next()) {
+            return rs->getInt64(1);
+        }
+        return 0;
+    }
+    catch (sql::SQLException& e) {
+        con->checkBroken(e);
+        std::cerr << "SQLException: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
 // 获取聊天信息
 std::shared_ptr<ChatMessage> MysqlDAO::getChatMsg(int message_id) {
     auto con = pool_->getConnection();
@@ -1151,12 +1896,10 @@ std::shared_ptr<ChatMessage> MysqlDAO::getChatMsg(int message_id) {
     auto& conn = con;
 
     try {
-        auto pstmt = std::unique_ptr<sql::PreparedStatement>(
-            conn->prepareStatement(
-                "SELECT message_id, thread_id, sender_id, recv_id, "
-                "content, created_at, updated_at, status , msg_type"
-                "FROM chat_message WHERE message_id = ?"
-            )
+        auto* pstmt = conn->prepare(
+            "SELECT message_id, thread_id, sender_id, recv_id, "
+            "content, created_at, updated_at, status , msg_type"
+            "FROM chat_message WHERE message_id = ?"
         );
 
         pstmt->setUInt64(1, message_id);
@@ -1180,6 +1923,7 @@ std::shared_ptr<ChatMessage> MysqlDAO::getChatMsg(int message_id) {
 
     }
     catch (sql::SQLException& e) {
+        con->checkBroken(e);
         std::cerr << "GetChatMessageById SQLException: " << e.what() << std::endl;
         return nullptr;
     }
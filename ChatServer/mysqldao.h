@@ -45,22 +45,37 @@ public:
     bool addFriend(const int& from, const int& to, std::string back_name, std::vector<std::shared_ptr<AddFriendMsg>>& chat_datas);
     // 获取好友请求列表
     bool getApplyList(int touid, std::vector<std::shared_ptr<ApplyInfo>>& applyList, int begin, int limit);
-    // 获取用户好友列表
-    bool getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo> >& user_info_list);
-    // 获取用户从lastid开始的聊天线程
-    bool getUserThreads(int64_t userId, int64_t lastId, int pageSize, std::vector<std::shared_ptr<ChatThreadInfo>>& threads,
-        bool& loadMore, int64_t& nextLastId);
+    // 获取用户好友列表，按好友uid从after_uid之后取limit条，limit为0时取全部
+    bool getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo> >& user_info_list,
+        int after_uid = 0, int limit = 0);
+    // 获取用户从游标开始的聊天线程，返回时游标指向本页最后一个会话
+    bool getUserThreads(int64_t userId, ChatThreadCursor& cursor, int pageSize,
+        std::vector<std::shared_ptr<ChatThreadInfo>>& threads, bool& loadMore);
     // 创建私聊
     bool createPrivateChat(int user1_id, int user2_id, int& thread_id);
-    // 加载聊天消息
-    std::shared_ptr<PageResult> loadChatMsg(int threadId, int lastId, int pageSize);
+    // 加载聊天消息，只读取message_id不超过maxId的
+    std::shared_ptr<PageResult> loadChatMsg(int threadId, int lastId, int maxId, int pageSize);
+    // 加载会话最近的limit条消息，按message_id从新到旧
+    bool loadLatestChatMsg(int threadId, int limit, std::vector<ChatMessage>& messages);
     // 添加聊天消息
     bool addChatMsg(std::vector<std::shared_ptr<ChatMessage>>& chat_datas);
     bool addChatMsg(std::shared_ptr<ChatMessage> chat_data);
+    // 按已分配的message_id批量插入聊天消息，已存在的id忽略（日志重放可能重复）
+    // 失败时b_transient表示原因是否为连接不可用、死锁或锁等待超时，原样重试即可；否则是数据本身的错误
+    bool insertChatMsgs(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas, bool& b_transient);
+    // 批量更新消息状态
+    bool updateChatMsgStatus(const std::vector<int>& message_ids, int status);
+    // 获取当前最大的消息id，失败返回-1
+    int64_t getMaxChatMsgId();
     // 获取聊天信息
     std::shared_ptr<ChatMessage> getChatMsg(int message_id);
 private:
+    // 只读查询使用的连接池，没有配置从库时返回主库的
+    std::unique_ptr<MysqlPool>& readPool();
+
     std::unique_ptr<MysqlPool> pool_;
+    std::unique_ptr<MysqlPool> replica_pool_;   // 只读从库，可选
+    bool thread_index_;     // 是否维护并使用user_thread_index表
 };
 
 #endif // MYSQLDAO_H
\ No newline at end of file
@@ -66,18 +66,18 @@ bool MysqlMgr::getApplyList(int touid,
 }
 
 // 获取用户好友列表
-bool MysqlMgr::getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo> >& user_info) {
-    return dao_.getFriendList(self_id, user_info);
+bool MysqlMgr::getFriendList(int self_id, std::vector<std::shared_ptr<UserInfo> >& user_info,
+    int after_uid, int limit) {
+    return dao_.getFriendList(self_id, user_info, after_uid, limit);
 }
 
 // 获取用户聊天线程
 bool MysqlMgr::getUserThreads(int64_t userId,
-    int64_t lastId,
+    ChatThreadCursor& cursor,
     int      pageSize,
     std::vector<std::shared_ptr<ChatThreadInfo>>& threads,
-    bool& loadMore,
-    int64_t& nextLastId) {
-    return dao_.getUserThreads(userId, lastId, pageSize, threads, loadMore, nextLastId);
+    bool& loadMore) {
+    return dao_.getUserThreads(userId, cursor, pageSize, threads, loadMore);
 }
 
 // 创建私聊
@@ -86,8 +86,12 @@ bool MysqlMgr::createPrivateChat(int user1_id, int user2_id, int& thread_id) {
 }
 
 // 加载聊天消息
-std::shared_ptr<PageResult> MysqlMgr::loadChatMsg(int threadId, int lastId, int pageSize) {
-    return dao_.loadChatMsg(threadId, lastId, pageSize);
+std::shared_ptr<PageResult> MysqlMgr::loadChatMsg(int threadId, int lastId, int maxId, int pageSize) {
+    return dao_.loadChatMsg(threadId, lastId, maxId, pageSize);
+}
+
+bool MysqlMgr::loadLatestChatMsg(int threadId, int limit, std::vector<ChatMessage>& messages) {
+    return dao_.loadLatestChatMsg(threadId, limit, messages);
 }
 
 // 添加聊天消息
@@ -99,7 +103,42 @@ bool MysqlMgr::addChatMsg(std::shared_ptr<ChatMessage> chat_data) {
     return dao_.addChatMsg(chat_data);
 }
 
+bool MysqlMgr::insertChatMsgs(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas, bool& b_transient) {
+    return dao_.insertChatMsgs(chat_datas, b_transient);
+}
+
+bool MysqlMgr::updateChatMsgStatus(const std::vector<int>& message_ids, int status) {
+    return dao_.updateChatMsgStatus(message_ids, status);
+}
+
+int64_t MysqlMgr::getMaxChatMsgId() {
+    return dao_.getMaxChatMsgId();
+}
+
 // 获取聊天信息
 std::shared_ptr<ChatMessage> MysqlMgr::getChatMsg(int message_id) {
     return dao_.getChatMsg(message_id);
-}
\ No newline at end of file
+}
+
+// 协程版本的获取用户信息
+net::awaitable<std::shared_ptr<UserInfo>> MysqlMgr::asyncGetUser(int uid) {
+    co_return co_await DBExecutor::getInstance()->run([this, uid]() {
+        return dao_.getUser(uid);
+        });
+}
+
+// 协程版本的获取用户好友请求列表
+net::awaitable<bool> MysqlMgr::asyncGetApplyList(int touid,
+    std::vector<std::shared_ptr<ApplyInfo>>& applyList, int begin, int limit) {
+    co_return co_await DBExecutor::getInstance()->run([this, touid, &applyList, begin, limit]() {
+        return dao_.getApplyList(touid, applyList, begin, limit);
+        });
+}
+
+// 协程版本的获取用户好友列表
+net::awaitable<bool> MysqlMgr::asyncGetFriendList(int self_id, std::vector<std::shared_ptr<UserInfo> >& user_info,
+    int after_uid, int limit) {
+    co_return co_await DBExecutor::getInstance()->run([this, self_id, &user_info, after_uid, limit]() {
+        return dao_.getFriendList(self_id, user_info, after_uid, limit);
+        });
+}
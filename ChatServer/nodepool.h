@@ -0,0 +1,90 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <mutex>
+#include <memory>
+#include <vector>
+
+/******************************************************************************
+ * @file       nodepool.h
+ * @brief      节点池的公共部分：空闲节点链表和shared_ptr控制块分配器，
+ *             接收节点池（LogicNodePool）和发送节点池（SendNodePool）共用
+ *
+ * @author     lueying
+ * @date       2026/10/18
+ * @history
+ *****************************************************************************/
+
+// 取出和归还可能在不同线程，两端都在mutex_下操作，锁内只有指针的进出
+// 由池和借出的节点共同持有，池所在线程退出后借出的节点仍可安全归还
+template <typename Node>
+class NodeFreeList {
+public:
+    ~NodeFreeList() {
+        for (auto* node : nodes_) {
+            delete node;
+        }
+        for (auto* block : blocks_) {
+            ::operator delete(block);
+        }
+    }
+
+    std::mutex mutex_;
+    std::vector<Node*> nodes_;
+    // 控制块的大小由标准库决定，第一次分配时记录，之后同样大小的块复用
+    std::size_t block_bytes_ = 0;
+    std::vector<void*> blocks_;
+};
+
+// 为shared_ptr的控制块分配内存，释放的块留在链表中给下一个节点使用
+template <typename T, typename Node>
+struct NodeBlockAllocator {
+    using value_type = T;
+
+    explicit NodeBlockAllocator(std::shared_ptr<NodeFreeList<Node>> list) : free_list(std::move(list)) {
+    }
+    template <typename U>
+    NodeBlockAllocator(const NodeBlockAllocator<U, Node>& other) : free_list(other.free_list) {
+    }
+
+    T* allocate(std::size_t n) {
+        auto bytes = n * sizeof(T);
+        {
+            std::lock_guard<std::mutex> lock(free_list->mutex_);
+            if (free_list->block_bytes_ == 0) {
+                free_list->block_bytes_ = bytes;
+            }
+            if (bytes == free_list->block_bytes_ && !free_list->blocks_.empty()) {
+                auto* block = free_list->blocks_.back();
+                free_list->blocks_.pop_back();
+                return static_cast<T*>(block);
+            }
+        }
+        return static_cast<T*>(::operator new(bytes));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        auto bytes = n * sizeof(T);
+        {
+            std::lock_guard<std::mutex> lock(free_list->mutex_);
+            if (bytes == free_list->block_bytes_) {
+                free_list->blocks_.push_back(p);
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const NodeBlockAllocator<U, Node>& other) const {
+        return free_list == other.free_list;
+    }
+    template <typename U>
+    bool operator!=(const NodeBlockAllocator<U, Node>& other) const {
+        return free_list != other.free_list;
+    }
+
+    std::shared_ptr<NodeFreeList<Node>> free_list;
+};
+
+#endif // NODEPOOL_H
@@ -0,0 +1,388 @@
+﻿#include "peerrouter.h"
+#include "configmgr.h"
+#include "redismgr.h"
+#include "chatgrpcclient.h"
+#include "chatserviceimpl.h"
+
+/******************************************************************************
+ * @file       peerrouter.cpp
+ * @brief      聊天服务器之间的通知转发实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 服务器订阅的频道名
+static std::string peerChannel(const std::string& server) {
+    return "peer_" + server;
+}
+
+// 读取正整数配置，未配置时使用默认值
+static std::size_t peerRouterConfig(const std::string& key, int default_value) {
+    auto value_str = ConfigMgr::getInst()["PeerRouter"][key];
+    int value = value_str.empty() ? 0 : atoi(value_str.c_str());
+    return value > 0 ? value : default_value;
+}
+
+// PeerLink流的客户端，回调都投递到PeerRouter的线程上处理
+// 发起时加一个hold，只有PeerRouter关闭流时才释放，保证此前对流的操作都合法
+class PeerStream : public grpc::ClientBidiReactor<message::PeerNotifyBatch, message::PeerNotifyAck> {
+public:
+    PeerStream(PeerRouter* router, std::string server) : router_(router), server_(std::move(server)) {
+    }
+
+    void OnWriteDone(bool ok) override {
+        net::post(router_->ioc_, [router = router_, server = server_, self = this, ok]() {
+            router->onStreamWriteDone(server, self, ok);
+            });
+    }
+
+    void OnReadDone(bool ok) override {
+        net::post(router_->ioc_, [router = router_, server = server_, self = this, ok, seq = ack_.seq()]() {
+            router->onStreamAck(server, self, ok, seq);
+            });
+    }
+
+    // 之后不会再有回调，排在已投递的回调之后释放
+    void OnDone(const grpc::Status& status) override {
+        if (!status.ok()) {
+            std::cout << "peer link to " << server_ << " closed, error is " << status.error_message() << std::endl;
+        }
+        net::post(router_->ioc_, [self = this]() {
+            delete self;
+            });
+    }
+
+    ClientContext context_;
+    message::PeerNotifyAck ack_;
+    // 正在写入的批次，流关闭后也要保持到写操作结束
+    std::shared_ptr<message::PeerNotifyBatch> writing_batch_;
+private:
+    PeerRouter* router_;
+    std::string server_;
+};
+
+// 未配置或无法识别的模式按grpc处理
+static std::string peerRouterMode() {
+    return ConfigMgr::getInst()["PeerRouter"]["Mode"];
+}
+
+PeerRouter::PeerRouter() : mode_(peerRouterMode() == "pubsub" ? Mode::PubSub
+        : peerRouterMode() == "stream" ? Mode::Stream : Mode::Grpc),
+    max_batch_(peerRouterConfig("MaxBatch", 64)), stream_window_(peerRouterConfig("StreamWindow", 8)),
+    self_name_(ConfigMgr::getInst()["SelfServer"]["Name"]), service_(nullptr),
+    work_(net::make_work_guard(ioc_)), deliver_strand_(DBExecutor::getInstance()->makeStrand()),
+    flush_posted_(false) {
+    thread_ = std::thread([this]() {
+        ioc_.run();
+        });
+}
+
+PeerRouter::~PeerRouter() {
+    stop();
+}
+
+bool PeerRouter::enabled() const {
+    return mode_ != Mode::Grpc;
+}
+
+void PeerRouter::start(ChatServiceImpl* service) {
+    service_ = service;
+    if (mode_ != Mode::PubSub) {
+        return;
+    }
+    std::vector<std::string> channels{ peerChannel(self_name_) };
+    //回调在redis的io线程上，只拷贝数据；投递会阻塞地查询用户信息，和PeerLink流一样放到DBExecutor，
+    //经由strand依次处理，不占用本线程的攒批和发送，批次之间也不乱序
+    RedisMgr::getInstance()->subscribe(channels, {}, [this](const std::string& channel, const std::string& message) {
+        net::post(deliver_strand_, [this, message]() {
+            message::PeerNotifyBatch batch;
+            if (!batch.ParseFromString(message)) {
+                std::cout << "peer router received invalid batch" << std::endl;
+                return;
+            }
+            deliver(batch);
+            });
+        });
+    std::cout << "peer router subscribed " << peerChannel(self_name_) << std::endl;
+}
+
+// 发出剩余的批次，等待在途的发布和补发结束；窗口外还没写入流的批次随进程退出丢弃
+void PeerRouter::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    net::post(ioc_, [this]() {
+        flush();
+        });
+    work_.reset();
+    thread_.join();
+}
+
+void PeerRouter::notifyAddFriend(const std::string& server, const message::AddFriendReq& req) {
+    if (mode_ == Mode::Grpc) {
+        ChatGrpcClient::getInstance()->notifyAddFriend(server, req);
+        return;
+    }
+    message::PeerNotify notify;
+    *notify.mutable_add_friend() = req;
+    post(server, std::move(notify));
+}
+
+void PeerRouter::notifyAuthFriend(const std::string& server, const message::AuthFriendReq& req) {
+    if (mode_ == Mode::Grpc) {
+        ChatGrpcClient::getInstance()->notifyAuthFriend(server, req);
+        return;
+    }
+    message::PeerNotify notify;
+    *notify.mutable_auth_friend() = req;
+    post(server, std::move(notify));
+}
+
+void PeerRouter::notifyTextChatMsg(const std::string& server, const message::TextChatMsgReq& req) {
+    if (mode_ == Mode::Grpc) {
+        ChatGrpcClient::getInstance()->notifyTextChatMsg(server, req);
+        return;
+    }
+    message::PeerNotify notify;
+    *notify.mutable_text_chat_msg() = req;
+    post(server, std::move(notify));
+}
+
+void PeerRouter::notifyKickUser(const std::string& server, const message::KickUserReq& req) {
+    if (mode_ == Mode::Grpc) {
+        ChatGrpcClient::getInstance()->notifyKickUser(server, req);
+        return;
+    }
+    message::PeerNotify notify;
+    *notify.mutable_kick_user() = req;
+    post(server, std::move(notify));
+}
+
+// 满的批次不单独投递，和后面的批次一起由同一次flush按顺序发出，
+// 否则单独投递的满批次会排在更早投递的flush之后，同一服务器的通知乱序
+void PeerRouter::post(const std::string& server, message::PeerNotify notify) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& batches = pending_[server];
+    if (batches.empty() || static_cast<std::size_t>(batches.back()->notifies_size()) >= max_batch_) {
+        auto batch = std::make_shared<message::PeerNotifyBatch>();
+        batch->set_from_server(self_name_);
+        batches.push_back(std::move(batch));
+    }
+    *batches.back()->add_notifies() = std::move(notify);
+    //flush执行前提交的通知都会合并进同一次发布，流只在本线程上操作
+    if (!flush_posted_) {
+        flush_posted_ = true;
+        net::post(ioc_, [this]() {
+            flush();
+            });
+    }
+}
+
+void PeerRouter::flush() {
+    std::unordered_map<std::string, std::deque<BatchPtr>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.swap(pending_);
+        flush_posted_ = false;
+    }
+    for (auto& [server, batches] : pending) {
+        for (auto& batch : batches) {
+            publish(server, std::move(batch));
+        }
+    }
+}
+
+void PeerRouter::publish(const std::string& server, BatchPtr batch) {
+    if (mode_ == Mode::Stream) {
+        sendByStream(server, std::move(batch));
+        return;
+    }
+
+    RedisCommand command{ "PUBLISH", peerChannel(server), batch->SerializeAsString() };
+    RedisMgr::getInstance()->asyncClient()->asyncCommand(std::move(command), net::bind_executor(ioc_,
+        [this, server, batch](boost::system::error_code ec, RedisResult result) {
+            //返回的是收到消息的订阅者数量，为0说明对端没有订阅（未启用或未连上redis）
+            if (!ec && result.type == REDIS_REPLY_INTEGER && result.integer > 0) {
+                return;
+            }
+            std::cout << "peer router publish to " << server << " failed, fallback to grpc, count is "
+                << batch->notifies_size() << std::endl;
+            fallback(server, batch);
+        }));
+}
+
+void PeerRouter::fallback(const std::string& server, BatchPtr batch) {
+    for (auto& notify : batch->notifies()) {
+        sendByGrpc(server, notify);
+    }
+}
+
+void PeerRouter::sendByGrpc(const std::string& server, const message::PeerNotify& notify) {
+    auto client = ChatGrpcClient::getInstance();
+    switch (notify.body_case()) {
+    case message::PeerNotify::kAddFriend:
+        client->notifyAddFriend(server, notify.add_friend());
+        break;
+    case message::PeerNotify::kAuthFriend:
+        client->notifyAuthFriend(server, notify.auth_friend());
+        break;
+    case message::PeerNotify::kTextChatMsg:
+        client->notifyTextChatMsg(server, notify.text_chat_msg());
+        break;
+    case message::PeerNotify::kKickUser:
+        client->notifyKickUser(server, notify.kick_user());
+        break;
+    default:
+        break;
+    }
+}
+
+void PeerRouter::deliver(const message::PeerNotifyBatch& batch) {
+    if (service_ == nullptr) {
+        return;
+    }
+
+    //和grpc服务端共用处理逻辑
+    for (auto& notify : batch.notifies()) {
+        switch (notify.body_case()) {
+        case message::PeerNotify::kAddFriend: {
+            message::AddFriendRsp rsp;
+            service_->handleAddFriend(&notify.add_friend(), &rsp);
+            break;
+        }
+        case message::PeerNotify::kAuthFriend: {
+            message::AuthFriendRsp rsp;
+            service_->handleAuthFriend(&notify.auth_friend(), &rsp);
+            break;
+        }
+        case message::PeerNotify::kTextChatMsg: {
+            message::TextChatMsgRsp rsp;
+            service_->handleTextChatMsg(&notify.text_chat_msg(), &rsp);
+            break;
+        }
+        case message::PeerNotify::kKickUser: {
+            message::KickUserRsp rsp;
+            service_->handleKickUser(&notify.kick_user(), &rsp);
+            break;
+        }
+        case message::PeerNotify::kChatImg: {
+            message::NotifyChatImgRsp rsp;
+            service_->handleChatImgMsg(&notify.chat_img(), &rsp);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+void PeerRouter::sendByStream(const std::string& server, BatchPtr batch) {
+    auto& link = links_[server];
+    if (link.stream == nullptr && !openStream(server, link)) {
+        fallback(server, batch);
+        return;
+    }
+
+    //窗口已满时和队尾等待的批次合并，减少写入次数
+    if (!link.queued.empty() &&
+        static_cast<std::size_t>(link.queued.back()->notifies_size() + batch->notifies_size()) <= max_batch_) {
+        link.queued.back()->mutable_notifies()->MergeFrom(batch->notifies());
+    }
+    else {
+        link.queued.push_back(std::move(batch));
+    }
+    writeStream(link);
+}
+
+bool PeerRouter::openStream(const std::string& server, PeerLink& link) {
+    if (Clock::now() < link.retry_at) {
+        return false;
+    }
+    auto stub = ChatGrpcClient::getInstance()->getStub(server);
+    if (stub == nullptr) {
+        return false;
+    }
+
+    link.stream = new PeerStream(this, server);
+    link.writing = false;
+    stub->async()->PeerLink(&link.stream->context_, link.stream);
+    link.stream->AddHold();
+    link.stream->StartRead(&link.stream->ack_);
+    link.stream->StartCall();
+    std::cout << "peer link to " << server << " opened" << std::endl;
+    return true;
+}
+
+// 同一时刻只有一个写操作，在途未确认的批次不超过窗口
+void PeerRouter::writeStream(PeerLink& link) {
+    if (link.stream == nullptr || link.writing || link.queued.empty() || link.inflight.size() >= stream_window_) {
+        return;
+    }
+    auto batch = link.queued.front();
+    link.queued.pop_front();
+    batch->set_seq(link.next_seq++);
+    link.inflight.push_back(batch);
+    link.writing = true;
+    link.stream->writing_batch_ = batch;
+    link.stream->StartWrite(batch.get());
+}
+
+// 关闭流，未确认和未写入的批次改走grpc；未确认的批次对端可能已经处理过，会重复通知
+void PeerRouter::closeStream(const std::string& server, PeerLink& link) {
+    auto stream = link.stream;
+    link.stream = nullptr;
+    link.writing = false;
+    link.retry_at = Clock::now() + std::chrono::seconds(1);
+    stream->context_.TryCancel();
+    stream->RemoveHold();
+
+    for (auto& batch : link.inflight) {
+        fallback(server, batch);
+    }
+    for (auto& batch : link.queued) {
+        fallback(server, batch);
+    }
+    link.inflight.clear();
+    link.queued.clear();
+}
+
+// 已关闭的流上迟到的回调返回空
+PeerRouter::PeerLink* PeerRouter::findLink(const std::string& server, PeerStream* stream) {
+    auto iter = links_.find(server);
+    if (iter == links_.end() || iter->second.stream != stream) {
+        return nullptr;
+    }
+    return &iter->second;
+}
+
+void PeerRouter::onStreamWriteDone(const std::string& server, PeerStream* stream, bool ok) {
+    auto link = findLink(server, stream);
+    if (link == nullptr) {
+        return;
+    }
+    link->writing = false;
+    if (!ok) {
+        closeStream(server, *link);
+        return;
+    }
+    writeStream(*link);
+}
+
+void PeerRouter::onStreamAck(const std::string& server, PeerStream* stream, bool ok, int64_t seq) {
+    auto link = findLink(server, stream);
+    if (link == nullptr) {
+        return;
+    }
+    if (!ok) {
+        closeStream(server, *link);
+        return;
+    }
+    //确认是累计的
+    while (!link->inflight.empty() && link->inflight.front()->seq() <= seq) {
+        link->inflight.pop_front();
+    }
+    stream->StartRead(&stream->ack_);
+    writeStream(*link);
+}
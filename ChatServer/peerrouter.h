@@ -0,0 +1,108 @@
+﻿#ifndef PEERROUTER_H
+#define PEERROUTER_H
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <boost/asio.hpp>
+#include "singleton.h"
+#include "dbexecutor.h"
+#include "message.pb.h"
+
+/******************************************************************************
+ * @file       peerrouter.h
+ * @brief      聊天服务器之间的通知转发，替代逐条的grpc调用：
+ *             发往同一服务器的通知攒成一批PeerNotifyBatch，按配置的模式发出
+ *             pubsub：每个服务器订阅自己的频道peer_<Name>，一批一次PUBLISH
+ *             stream：和每个对端保持一条PeerLink双向流，一批一次写入，
+ *                     对端按批确认，在途批次数受窗口限制
+ *             对端不可达时退回逐条grpc
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+namespace net = boost::asio;
+
+class ChatServiceImpl;
+class PeerStream;
+
+class PeerRouter : public Singleton<PeerRouter> {
+    friend class Singleton<PeerRouter>;
+    friend class PeerStream;
+public:
+    ~PeerRouter();
+    // 配置[PeerRouter] Mode=pubsub或stream时启用，否则所有通知直接走grpc（同样不阻塞）
+    bool enabled() const;
+    // pubsub模式下订阅本服务器的频道，收到的通知交给service处理
+    void start(ChatServiceImpl* service);
+    void stop();
+
+    // 通知server上的用户，不阻塞
+    void notifyAddFriend(const std::string& server, const message::AddFriendReq& req);
+    void notifyAuthFriend(const std::string& server, const message::AuthFriendReq& req);
+    void notifyTextChatMsg(const std::string& server, const message::TextChatMsgReq& req);
+    void notifyKickUser(const std::string& server, const message::KickUserReq& req);
+
+    // 处理其他服务器发来的一批通知，redis频道和PeerLink流共用
+    void deliver(const message::PeerNotifyBatch& batch);
+private:
+    enum class Mode { Grpc, PubSub, Stream };
+    using Clock = std::chrono::steady_clock;
+    using BatchPtr = std::shared_ptr<message::PeerNotifyBatch>;
+
+    // 和一个对端之间的双向流状态，只在ioc_线程上访问
+    struct PeerLink {
+        PeerStream* stream = nullptr;
+        std::deque<BatchPtr> queued;    // 窗口已满，等待写入
+        std::deque<BatchPtr> inflight;  // 已写入，等待确认
+        bool writing = false;
+        int64_t next_seq = 1;
+        Clock::time_point retry_at;     // 流断开后到该时间之前直接走grpc
+    };
+
+    PeerRouter();
+    // 加入发往server的最后一个批次，批次满了另起一批，都等本线程下一次flush按顺序发出
+    void post(const std::string& server, message::PeerNotify notify);
+    void flush();
+    void publish(const std::string& server, BatchPtr batch);
+    // 逐条用grpc补发
+    void fallback(const std::string& server, BatchPtr batch);
+    static void sendByGrpc(const std::string& server, const message::PeerNotify& notify);
+
+    // 以下函数只在ioc_线程上调用
+    void sendByStream(const std::string& server, BatchPtr batch);
+    bool openStream(const std::string& server, PeerLink& link);
+    void writeStream(PeerLink& link);
+    void closeStream(const std::string& server, PeerLink& link);
+    PeerLink* findLink(const std::string& server, PeerStream* stream);
+    void onStreamWriteDone(const std::string& server, PeerStream* stream, bool ok);
+    void onStreamAck(const std::string& server, PeerStream* stream, bool ok, int64_t seq);
+
+    Mode mode_;
+    std::size_t max_batch_;
+    std::size_t stream_window_;
+    std::string self_name_;
+    ChatServiceImpl* service_;
+
+    // 攒批和发送都在这个线程上，不占用redis和grpc的线程
+    net::io_context ioc_;
+    net::executor_work_guard<net::io_context::executor_type> work_;
+    std::thread thread_;
+    // pubsub模式下收到的批次在DBExecutor上按到达顺序处理，处理时会查询redis和mysql
+    net::strand<net::thread_pool::executor_type> deliver_strand_;
+
+    std::mutex mutex_;
+    // 按目标服务器攒批，同一服务器的批次按提交顺序排列，只有最后一批还在追加
+    std::unordered_map<std::string, std::deque<BatchPtr>> pending_;
+    bool flush_posted_;
+
+    std::unordered_map<std::string, PeerLink> links_;
+};
+
+#endif // PEERROUTER_H
@@ -18,43 +18,14 @@
 class RedisConPool {
 public:
     RedisConPool(size_t poolSize, const char* host, int port, const char* pwd)
-        : poolSize_(poolSize), host_(host), port_(port), b_stop_(false) {
+        : b_stop_(false), poolSize_(poolSize), host_(host), port_(port), pwd_(pwd), missing_(0) {
         for (size_t i = 0; i < poolSize_; ++i) {
-            auto* context = redisConnect(host, port);
-            if (context == nullptr || context->err != 0) {
-                if (context != nullptr) {
-                    std::cout << "Redis连接失败: " << context->errstr << std::endl;
-                    redisFree(context);
-                }
+            auto* context = createConnection();
+            if (context == nullptr) {
                 continue;
             }
-
-            // 密码认证
-            auto reply = (redisReply*)redisCommand(context, "AUTH %s", pwd);
-            if (reply->type == REDIS_REPLY_ERROR) {
-                std::cout << "Redis认证失败: " << reply->str << std::endl;
-                //执行成功 释放redisCommand执行后返回的redisReply所占用的内存
-                freeReplyObject(reply);
-                continue;
-            }
-
-            //执行成功 释放redisCommand执行后返回的redisReply所占用的内存
-            freeReplyObject(reply);
-            std::cout << "认证成功" << std::endl;
-
-            // 显式选择 DB 0
-            auto select_reply = (redisReply*)redisCommand(context, "SELECT 0");
-            if (select_reply == nullptr || select_reply->type == REDIS_REPLY_ERROR) {
-                std::cout << "选择数据库失败" << std::endl;
-                if (select_reply) freeReplyObject(select_reply);
-                redisFree(context);
-                continue;
-            }
-            freeReplyObject(select_reply);
-
             connections_.push(context);
         }
-
     }
 
     ~RedisConPool() {
@@ -66,18 +37,30 @@ public:
         }
     }
 
+    // 空闲连接用完且有被丢弃的连接时，在锁外重新建立一条
     redisContext* getConnection() {
         std::unique_lock<std::mutex> lock(mutex_);
         cond_.wait(lock, [this] {
             if (b_stop_) {
                 return true;
             }
-            return !connections_.empty();
+            return !connections_.empty() || missing_ > 0;
             });
         //如果停止则直接返回空指针
         if (b_stop_) {
             return  nullptr;
         }
+        if (connections_.empty()) {
+            --missing_;
+            lock.unlock();
+            auto* context = createConnection();
+            if (context == nullptr) {
+                lock.lock();
+                ++missing_;
+                cond_.notify_one();
+            }
+            return context;
+        }
         auto* context = connections_.front();
         connections_.pop();
         return context;
@@ -92,16 +75,66 @@ public:
         cond_.notify_one();
     }
 
+    // 出错的连接中可能残留未读的回复，不能再归还，释放后由之后的getConnection补建
+    void dropConnection(redisContext* context) {
+        redisFree(context);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (b_stop_) {
+            return;
+        }
+        ++missing_;
+        cond_.notify_one();
+    }
+
     void Close() {
         b_stop_ = true;
         cond_.notify_all();
     }
 
 private:
+    // 建立连接并完成认证和选库，失败返回空指针
+    redisContext* createConnection() {
+        auto* context = redisConnect(host_.c_str(), port_);
+        if (context == nullptr || context->err != 0) {
+            if (context != nullptr) {
+                std::cout << "Redis连接失败: " << context->errstr << std::endl;
+                redisFree(context);
+            }
+            return nullptr;
+        }
+
+        // 密码认证
+        auto reply = (redisReply*)redisCommand(context, "AUTH %s", pwd_.c_str());
+        if (reply == nullptr || reply->type == REDIS_REPLY_ERROR) {
+            std::cout << "Redis认证失败: " << (reply ? reply->str : context->errstr) << std::endl;
+            //执行成功 释放redisCommand执行后返回的redisReply所占用的内存
+            if (reply) freeReplyObject(reply);
+            redisFree(context);
+            return nullptr;
+        }
+
+        //执行成功 释放redisCommand执行后返回的redisReply所占用的内存
+        freeReplyObject(reply);
+        std::cout << "认证成功" << std::endl;
+
+        // 显式选择 DB 0
+        auto select_reply = (redisReply*)redisCommand(context, "SELECT 0");
+        if (select_reply == nullptr || select_reply->type == REDIS_REPLY_ERROR) {
+            std::cout << "选择数据库失败" << std::endl;
+            if (select_reply) freeReplyObject(select_reply);
+            redisFree(context);
+            return nullptr;
+        }
+        freeReplyObject(select_reply);
+        return context;
+    }
+
     std::atomic<bool> b_stop_;
     size_t poolSize_;
-    const char* host_;
+    std::string host_;
     int port_;
+    std::string pwd_;
+    size_t missing_;    // 被丢弃还没补建的连接数
     std::queue<redisContext*> connections_;
     std::mutex mutex_;
     std::condition_variable cond_;
@@ -112,14 +145,19 @@ private:
 class RedisConnGuard {
 public:
     // 构造时借出连接
-    RedisConnGuard(std::unique_ptr<RedisConPool>& pool) : _pool(pool) {
+    RedisConnGuard(std::unique_ptr<RedisConPool>& pool) : _pool(pool), _broken(false) {
         _context = _pool->getConnection();
     }
 
-    // 析构时自动归还连接
+    // 析构时自动归还连接；出过错的连接（hiredis置了err）不再复用
     ~RedisConnGuard() {
         if (_context && _pool) {
-            _pool->returnConnection(_context);
+            if (_broken || _context->err != 0) {
+                _pool->dropConnection(_context);
+            }
+            else {
+                _pool->returnConnection(_context);
+            }
         }
     }
 
@@ -128,6 +166,11 @@ public:
         return _context; 
     }
 
+    // 连接上的请求和回复已经错位，析构时丢弃
+    void markBroken() {
+        _broken = true;
+    }
+
     // 禁用拷贝，确保连接归还逻辑唯一
     RedisConnGuard(const RedisConnGuard&) = delete;
     RedisConnGuard& operator=(const RedisConnGuard&) = delete;
@@ -135,15 +178,34 @@ public:
 private:
     std::unique_ptr<RedisConPool>& _pool;
     redisContext* _context;
+    bool _broken;
 };
 
 
-RedisMgr::RedisMgr() {
+// 读取正整数配置，未配置时使用默认值
+static int redisConfigCount(const std::string& key, int default_count) {
+    auto count_str = ConfigMgr::getInst()["Redis"][key];
+    int count = count_str.empty() ? 0 : atoi(count_str.c_str());
+    return count > 0 ? count : default_count;
+}
+
+RedisMgr::RedisMgr() : async_work_(net::make_work_guard(async_ioc_)), next_client_(0) {
     auto& gCfgMgr = ConfigMgr::getInst();
     auto host = gCfgMgr["Redis"]["Host"];
     auto port = gCfgMgr["Redis"]["Port"];
     auto pwd = gCfgMgr["Redis"]["Passwd"];
-    con_pool_.reset(new RedisConPool(10, host.c_str(), atoi(port.c_str()), pwd.c_str()));
+    con_pool_.reset(new RedisConPool(redisConfigCount("PoolSize", 10), host.c_str(), atoi(port.c_str()), pwd.c_str()));
+
+    //每条异步连接可以同时有多条命令在途，少量连接即可
+    auto async_count = redisConfigCount("AsyncConnections", 2);
+    for (int i = 0; i < async_count; ++i) {
+        auto client = std::make_shared<AsyncRedisClient>(async_ioc_.get_executor(), host, atoi(port.c_str()), pwd);
+        client->start();
+        async_clients_.push_back(client);
+    }
+    async_thread_ = std::thread([this]() {
+        async_ioc_.run();
+        });
 }
 
 RedisMgr::~RedisMgr() {
@@ -406,15 +468,12 @@ std::string RedisMgr::hGet(const std::string& key, const std::string& hkey) {
 }
 
 bool RedisMgr::hDel(const std::string& key, const std::string& field) {
-    auto connect = con_pool_->getConnection();
+    RedisConnGuard guard(con_pool_);
+    auto connect = guard.get();
     if (connect == nullptr) {
         return false;
     }
 
-    Defer defer([&connect, this]() {
-        con_pool_->returnConnection(connect);
-        });
-
     redisReply* reply = (redisReply*)redisCommand(connect, "HDEL %s %s", key.c_str(), field.c_str());
     if (reply == nullptr) {
         std::cerr << "HDEL command failed" << std::endl;
@@ -472,24 +531,195 @@ bool RedisMgr::existsKey(const std::string& key) {
     return true;
 }
 
+// 批量读取
+bool RedisMgr::mGet(const std::vector<std::string>& keys, std::vector<std::optional<std::string>>& values) {
+    values.clear();
+    if (keys.empty()) {
+        return true;
+    }
+
+    RedisCommand command;
+    command.reserve(keys.size() + 1);
+    command.push_back("MGET");
+    command.insert(command.end(), keys.begin(), keys.end());
+    std::vector<RedisResult> results;
+    if (!pipeline({ command }, results)) {
+        return false;
+    }
+
+    auto& elements = results[0].elements;
+    if (results[0].type != REDIS_REPLY_ARRAY || elements.size() != keys.size()) {
+        std::cout << "Execut command [ MGET ] failure ! " << std::endl;
+        return false;
+    }
+
+    values.reserve(keys.size());
+    for (auto& element : elements) {
+        if (element.type == REDIS_REPLY_STRING) {
+            values.emplace_back(std::move(element.str));
+        }
+        else {
+            values.emplace_back(std::nullopt);
+        }
+    }
+    return true;
+}
+
+// 批量写入
+bool RedisMgr::mSet(const std::vector<std::pair<std::string, std::string>>& key_values) {
+    if (key_values.empty()) {
+        return true;
+    }
+
+    RedisCommand command;
+    command.reserve(key_values.size() * 2 + 1);
+    command.push_back("MSET");
+    for (auto& kv : key_values) {
+        command.push_back(kv.first);
+        command.push_back(kv.second);
+    }
+    std::vector<RedisResult> results;
+    if (!pipeline({ command }, results) || results[0].type != REDIS_REPLY_STATUS) {
+        std::cout << "Execut command [ MSET ] failure ! " << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 一次删除多个key
+bool RedisMgr::del(const std::vector<std::string>& keys) {
+    if (keys.empty()) {
+        return true;
+    }
+
+    RedisCommand command;
+    command.reserve(keys.size() + 1);
+    command.push_back("DEL");
+    command.insert(command.end(), keys.begin(), keys.end());
+    std::vector<RedisResult> results;
+    if (!pipeline({ command }, results) || results[0].type != REDIS_REPLY_INTEGER) {
+        std::cout << "Execut command [ DEL ] failure ! " << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 将hiredis的reply拷贝为RedisResult
+static RedisResult toResult(const redisReply* reply) {
+    RedisResult result;
+    result.type = reply->type;
+    if (reply->type == REDIS_REPLY_INTEGER) {
+        result.integer = reply->integer;
+    }
+    else if (reply->type == REDIS_REPLY_ARRAY) {
+        result.elements.reserve(reply->elements);
+        for (std::size_t i = 0; i < reply->elements; ++i) {
+            result.elements.push_back(toResult(reply->element[i]));
+        }
+    }
+    else if (reply->str != nullptr) {
+        result.str.assign(reply->str, reply->len);
+    }
+    return result;
+}
+
+// 管道：先把所有命令写入输出缓冲区，读取第一个结果时一次发出
+bool RedisMgr::pipeline(const std::vector<RedisCommand>& commands, std::vector<RedisResult>& results) {
+    results.clear();
+    if (commands.empty()) {
+        return true;
+    }
+
+    RedisConnGuard guard(con_pool_);
+    auto connect = guard.get();
+    if (connect == nullptr) {
+        return false;
+    }
+
+    std::vector<const char*> argv;
+    std::vector<size_t> argvlen;
+    for (auto& command : commands) {
+        argv.clear();
+        argvlen.clear();
+        for (auto& arg : command) {
+            argv.push_back(arg.data());
+            argvlen.push_back(arg.size());
+        }
+        //之前追加的命令还留在输出缓冲区中，连接不能再归还
+        if (redisAppendCommandArgv(connect, static_cast<int>(argv.size()), argv.data(), argvlen.data()) != REDIS_OK) {
+            std::cout << "Execut pipeline append failure ! " << std::endl;
+            guard.markBroken();
+            return false;
+        }
+    }
+
+    //必须读完所有回复，否则连接归还后会读到残留的结果
+    bool success = true;
+    for (std::size_t i = 0; i < commands.size(); ++i) {
+        redisReply* reply = nullptr;
+        if (redisGetReply(connect, (void**)&reply) != REDIS_OK || reply == nullptr) {
+            std::cout << "Execut pipeline get reply failure ! " << std::endl;
+            guard.markBroken();
+            results.clear();
+            return false;
+        }
+        if (reply->type == REDIS_REPLY_ERROR) {
+            std::cout << "Execut pipeline command [ " << commands[i][0] << " ] error: " << reply->str << std::endl;
+            success = false;
+        }
+        results.push_back(toResult(reply));
+        freeReplyObject(reply);
+    }
+
+    return success;
+}
+
 // 关闭
 void RedisMgr::close() {
     con_pool_->Close();
+    if (!async_thread_.joinable()) {
+        return;
+    }
+    for (auto& client : async_clients_) {
+        client->stop();
+    }
+    {
+        std::lock_guard<std::mutex> lock(sub_mutex_);
+        for (auto& client : sub_clients_) {
+            client->stop();
+        }
+    }
+    async_work_.reset();
+    async_ioc_.stop();
+    async_thread_.join();
+}
+
+std::shared_ptr<AsyncRedisClient> RedisMgr::asyncClient() {
+    return async_clients_[next_client_++ % async_clients_.size()];
+}
+
+// 订阅连接不能执行普通命令，每次订阅单独建一条连接
+void RedisMgr::subscribe(std::vector<std::string> channels, std::vector<std::string> patterns,
+    AsyncRedisClient::MessageHandler handler) {
+    auto& gCfgMgr = ConfigMgr::getInst();
+    auto client = std::make_shared<AsyncRedisClient>(async_ioc_.get_executor(), gCfgMgr["Redis"]["Host"],
+        atoi(gCfgMgr["Redis"]["Port"].c_str()), gCfgMgr["Redis"]["Passwd"]);
+    client->subscribe(std::move(channels), std::move(patterns), std::move(handler));
+    client->start();
+    std::lock_guard<std::mutex> lock(sub_mutex_);
+    sub_clients_.push_back(client);
 }
 
 // 获取分布式锁
 std::string RedisMgr::acquireLock(const std::string& lockName,
     int lockTimeout, int acquireTimeout) {
 
-    auto connect = con_pool_->getConnection();
+    RedisConnGuard guard(con_pool_);
+    auto connect = guard.get();
     if (connect == nullptr) {
         return "";
     }
 
-    Defer defer([&connect, this]() {
-        con_pool_->returnConnection(connect);
-        });
-
     return DistLock::getInst().acquireLock(connect, lockName, lockTimeout, acquireTimeout);
 }
 
@@ -499,15 +729,141 @@ bool RedisMgr::releaseLock(const std::string& lockName,
     if (identifier.empty()) {
         return true;
     }
-    auto connect = con_pool_->getConnection();
+    RedisConnGuard guard(con_pool_);
+    auto connect = guard.get();
     if (connect == nullptr) {
         return false;
     }
 
+    return DistLock::getInst().releaseLock(connect, lockName, identifier);
+}
 
-    Defer defer([&connect, this]() {
-        con_pool_->returnConnection(connect);
-        });
+// 协程版本的字符串读取
+net::awaitable<bool> RedisMgr::asyncGet(std::string key, std::string& value) {
+    RedisCommand command{ "GET", key };
+    boost::system::error_code ec;
+    auto result = co_await asyncClient()->asyncCommand(std::move(command),
+        net::redirect_error(net::use_awaitable, ec));
+    if (ec || result.type != REDIS_REPLY_STRING) {
+        std::cout << "[ async GET " << key << " ] failure ! " << std::endl;
+        co_return false;
+    }
+    value = std::move(result.str);
+    co_return true;
+}
 
-    return DistLock::getInst().releaseLock(connect, lockName, identifier);
-}
\ No newline at end of file
+// 协程版本的字符串写入
+net::awaitable<bool> RedisMgr::asyncSet(std::string key, std::string value) {
+    RedisCommand command{ "SET", key, value };
+    boost::system::error_code ec;
+    auto result = co_await asyncClient()->asyncCommand(std::move(command),
+        net::redirect_error(net::use_awaitable, ec));
+    if (ec || result.type != REDIS_REPLY_STATUS) {
+        std::cout << "Execut command [ async SET " << key << " ] failure ! " << std::endl;
+        co_return false;
+    }
+    co_return true;
+}
+
+// 协程版本的删除
+net::awaitable<bool> RedisMgr::asyncDel(std::string key) {
+    std::vector<std::string> keys{ key };
+    co_return co_await asyncDel(std::move(keys));
+}
+
+// 协程版本的批量删除
+net::awaitable<bool> RedisMgr::asyncDel(std::vector<std::string> keys) {
+    if (keys.empty()) {
+        co_return true;
+    }
+    RedisCommand command{ "DEL" };
+    command.insert(command.end(), keys.begin(), keys.end());
+    boost::system::error_code ec;
+    auto result = co_await asyncClient()->asyncCommand(std::move(command),
+        net::redirect_error(net::use_awaitable, ec));
+    if (ec || result.type != REDIS_REPLY_INTEGER) {
+        std::cout << "Execut command [ async DEL ] failure ! " << std::endl;
+        co_return false;
+    }
+    co_return true;
+}
+
+// 协程版本的批量读取
+net::awaitable<bool> RedisMgr::asyncMGet(std::vector<std::string> keys,
+    std::vector<std::optional<std::string>>& values) {
+    values.clear();
+    if (keys.empty()) {
+        co_return true;
+    }
+    RedisCommand command{ "MGET" };
+    command.insert(command.end(), keys.begin(), keys.end());
+    boost::system::error_code ec;
+    auto result = co_await asyncClient()->asyncCommand(std::move(command),
+        net::redirect_error(net::use_awaitable, ec));
+    if (ec || result.type != REDIS_REPLY_ARRAY || result.elements.size() != keys.size()) {
+        std::cout << "Execut command [ async MGET ] failure ! " << std::endl;
+        co_return false;
+    }
+
+    values.reserve(keys.size());
+    for (auto& element : result.elements) {
+        if (element.type == REDIS_REPLY_STRING) {
+            values.emplace_back(std::move(element.str));
+        }
+        else {
+            values.emplace_back(std::nullopt);
+        }
+    }
+    co_return true;
+}
+
+// 协程版本的批量写入
+net::awaitable<bool> RedisMgr::asyncMSet(std::vector<std::pair<std::string, std::string>> key_values) {
+    if (key_values.empty()) {
+        co_return true;
+    }
+    RedisCommand command{ "MSET" };
+    for (auto& kv : key_values) {
+        command.push_back(kv.first);
+        command.push_back(kv.second);
+    }
+    boost::system::error_code ec;
+    auto result = co_await asyncClient()->asyncCommand(std::move(command),
+        net::redirect_error(net::use_awaitable, ec));
+    if (ec || result.type != REDIS_REPLY_STATUS) {
+        std::cout << "Execut command [ async MSET ] failure ! " << std::endl;
+        co_return false;
+    }
+    co_return true;
+}
+
+// 协程版本的管道
+net::awaitable<bool> RedisMgr::asyncPipeline(std::vector<RedisCommand> commands, std::vector<RedisResult>& results) {
+    boost::system::error_code ec;
+    results = co_await asyncClient()->asyncPipeline(std::move(commands),
+        net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+        std::cout << "Execut async pipeline failure: " << ec.message() << std::endl;
+        co_return false;
+    }
+    for (auto& result : results) {
+        if (result.type == REDIS_REPLY_ERROR) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+// 协程版本的获取分布式锁
+net::awaitable<std::string> RedisMgr::asyncAcquireLock(std::string lockName,
+    int lockTimeout, int acquireTimeout) {
+    co_return co_await DistLock::getInst().asyncAcquireLock(asyncClient(), lockName, lockTimeout, acquireTimeout);
+}
+
+// 协程版本的解锁
+net::awaitable<bool> RedisMgr::asyncReleaseLock(std::string lockName, std::string identifier) {
+    if (identifier.empty()) {
+        co_return true;
+    }
+    co_return co_await DistLock::getInst().asyncReleaseLock(asyncClient(), lockName, identifier);
+}
@@ -2,6 +2,12 @@
 #define REDISMGR_H
 
 #include "singleton.h"
+#include "dbexecutor.h"
+#include "../Common/asyncredis.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <optional>
 #include <hiredis.h>
 
 /******************************************************************************
@@ -38,6 +44,16 @@ public:
     bool del(const std::string& key);
     // 判断键值是否存在
     bool existsKey(const std::string& key);
+
+    // 批量操作，一次往返完成
+    // MGET：values与keys一一对应，不存在的key为空
+    bool mGet(const std::vector<std::string>& keys, std::vector<std::optional<std::string>>& values);
+    // MSET
+    bool mSet(const std::vector<std::pair<std::string, std::string>>& key_values);
+    // 一次删除多个key
+    bool del(const std::vector<std::string>& keys);
+    // 管道：所有命令一次发出再依次读取结果，results与commands一一对应
+    bool pipeline(const std::vector<RedisCommand>& commands, std::vector<RedisResult>& results);
     // 关闭
     void close();
 
@@ -46,11 +62,36 @@ public:
     // 解锁
     bool releaseLock(const std::string& lockName, const std::string& identifier);
     void initCount(std::string server_name);
+
+    // 协程版本：命令通过异步客户端发出，多个协程的命令复用同一条连接，完成后回到调用方的executor
+    net::awaitable<bool> asyncGet(std::string key, std::string& value);
+    net::awaitable<bool> asyncSet(std::string key, std::string value);
+    net::awaitable<bool> asyncDel(std::string key);
+    net::awaitable<bool> asyncDel(std::vector<std::string> keys);
+    net::awaitable<bool> asyncMGet(std::vector<std::string> keys, std::vector<std::optional<std::string>>& values);
+    net::awaitable<bool> asyncMSet(std::vector<std::pair<std::string, std::string>> key_values);
+    net::awaitable<bool> asyncPipeline(std::vector<RedisCommand> commands, std::vector<RedisResult>& results);
+    net::awaitable<std::string> asyncAcquireLock(std::string lockName, int lockTimeout, int acquireTimeout);
+    net::awaitable<bool> asyncReleaseLock(std::string lockName, std::string identifier);
+    // 轮询取一个异步客户端
+    std::shared_ptr<AsyncRedisClient> asyncClient();
+    // 新建一条订阅连接，handler在异步客户端的io线程上执行
+    void subscribe(std::vector<std::string> channels, std::vector<std::string> patterns,
+        AsyncRedisClient::MessageHandler handler);
 private:
     RedisMgr();
 
     // 连接池
     std::unique_ptr<RedisConPool> con_pool_;
+
+    // 异步客户端运行在独立的io线程上
+    net::io_context async_ioc_;
+    net::executor_work_guard<net::io_context::executor_type> async_work_;
+    std::thread async_thread_;
+    std::vector<std::shared_ptr<AsyncRedisClient>> async_clients_;
+    std::mutex sub_mutex_;
+    std::vector<std::shared_ptr<AsyncRedisClient>> sub_clients_;
+    std::atomic<std::size_t> next_client_;
 };
 
 #endif // REDISMGR_H
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "sendnodepool.h"
+#include "const.h"
+
+/******************************************************************************
+ * @file       sendnodepool.cpp
+ * @brief      发送消息节点池实现
+ *
+ * @author     lueying
+ * @date       2026/10/18
+ * @history
+ *****************************************************************************/
+
+// 最后一个引用释放时执行：把节点放回空闲链表
+struct SendNodeReleaser {
+    std::shared_ptr<SendNodeFreeList> free_list;
+
+    void operator()(SendNode* node) const {
+        std::lock_guard<std::mutex> lock(free_list->mutex_);
+        free_list->nodes_.push_back(node);
+    }
+};
+
+SendNodePool::SendNodePool() : free_list_(std::make_shared<SendNodeFreeList>()), created_(0) {
+    free_list_->nodes_.reserve(SEND_NODE_POOL_SIZE);
+    free_list_->blocks_.reserve(SEND_NODE_POOL_SIZE);
+}
+
+SendNodePool::~SendNodePool() {
+}
+
+SendNodePool& SendNodePool::local() {
+    thread_local SendNodePool pool;
+    return pool;
+}
+
+std::shared_ptr<SendNode> SendNodePool::acquire(const char* msg, short max_len, short msg_id) {
+    if (max_len > MAX_LENGTH) {
+        return std::make_shared<SendNode>(msg, max_len, msg_id);
+    }
+
+    SendNode* node = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(free_list_->mutex_);
+        if (!free_list_->nodes_.empty()) {
+            node = free_list_->nodes_.back();
+            free_list_->nodes_.pop_back();
+        }
+    }
+
+    if (node == nullptr) {
+        // 池满时退化为普通分配，节点用完直接释放
+        if (created_ >= SEND_NODE_POOL_SIZE) {
+            return std::make_shared<SendNode>(msg, max_len, msg_id);
+        }
+        node = new SendNode(HEAD_TOTAL_LEN + MAX_LENGTH);
+        ++created_;
+    }
+    // 归还时在锁内入链，这里在锁内取出，io线程对缓冲区的写操作已经结束
+    node->reset(msg, max_len, msg_id);
+    return std::shared_ptr<SendNode>(node, SendNodeReleaser{ free_list_ },
+        NodeBlockAllocator<SendNode, SendNode>(free_list_));
+}
@@ -0,0 +1,36 @@
+#ifndef SENDNODEPOOL_H
+#define SENDNODEPOOL_H
+
+#include <memory>
+#include "msgnode.h"
+#include "nodepool.h"
+
+/******************************************************************************
+ * @file       sendnodepool.h
+ * @brief      发送消息节点池，每个发送线程一个，节点写完后由io线程归还；
+ *             节点本身就是发送队列的链表节点，控制块也从池中复用，
+ *             稳定运行后每条发送的消息不再有堆分配
+ *
+ * @author     lueying
+ * @date       2026/10/18
+ * @history
+ *****************************************************************************/
+
+// 空闲节点和控制块链表，发送线程取出、会话的io线程归还
+using SendNodeFreeList = NodeFreeList<SendNode>;
+
+class SendNodePool {
+public:
+    ~SendNodePool();
+    // 获取当前线程的节点池，逻辑工作线程、grpc线程和io线程各自使用自己的池
+    static SendNodePool& local();
+    // 取出一个节点并写入消息，最后一个引用释放时归还到池中
+    // 消息体超过MAX_LENGTH时退化为普通分配
+    std::shared_ptr<SendNode> acquire(const char* msg, short max_len, short msg_id);
+private:
+    SendNodePool();
+    std::shared_ptr<SendNodeFreeList> free_list_;
+    std::size_t created_;   // 池创建的节点数，不超过SEND_NODE_POOL_SIZE
+};
+
+#endif // SENDNODEPOOL_H
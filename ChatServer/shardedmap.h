@@ -0,0 +1,108 @@
+﻿#ifndef SHARDEDMAP_H
+#define SHARDEDMAP_H
+
+#include <array>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <unordered_map>
+
+/******************************************************************************
+ * @file       shardedmap.h
+ * @brief      分片并发哈希表，按key的哈希值分到多个分片，每个分片一把读写锁，
+ *             不同分片的读写互不阻塞，同一分片的读操作可以并发
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+template <typename Key, typename Value, std::size_t ShardCount = 32,
+    typename Hash = std::hash<Key>>
+class ShardedMap {
+public:
+    // 查找key，找到则拷贝到value并返回true
+    bool find(const Key& key, Value& value) const {
+        auto& shard = shardOf(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto iter = shard.map.find(key);
+        if (iter == shard.map.end()) {
+            return false;
+        }
+        value = iter->second;
+        return true;
+    }
+
+    bool contains(const Key& key) const {
+        auto& shard = shardOf(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.find(key) != shard.map.end();
+    }
+
+    // 插入或覆盖
+    void set(const Key& key, Value value) {
+        auto& shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.map[key] = std::move(value);
+    }
+
+    bool erase(const Key& key) {
+        auto& shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.erase(key) > 0;
+    }
+
+    // 删除key并把被删除的值拷贝到value，key不存在返回false
+    bool take(const Key& key, Value& value) {
+        auto& shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto iter = shard.map.find(key);
+        if (iter == shard.map.end()) {
+            return false;
+        }
+        value = std::move(iter->second);
+        shard.map.erase(iter);
+        return true;
+    }
+
+    // 仅当当前值等于expected时删除，防止误删被覆盖后的新值
+    bool eraseIf(const Key& key, const Value& expected) {
+        auto& shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto iter = shard.map.find(key);
+        if (iter == shard.map.end() || !(iter->second == expected)) {
+            return false;
+        }
+        shard.map.erase(iter);
+        return true;
+    }
+
+    // 各分片元素数量之和，统计用，不是一致快照
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (auto& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            total += shard.map.size();
+        }
+        return total;
+    }
+
+private:
+    // 按缓存行对齐，避免相邻分片的锁产生伪共享
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Key, Value, Hash> map;
+    };
+
+    Shard& shardOf(const Key& key) {
+        return shards_[Hash{}(key) % ShardCount];
+    }
+
+    const Shard& shardOf(const Key& key) const {
+        return shards_[Hash{}(key) % ShardCount];
+    }
+
+    std::array<Shard, ShardCount> shards_;
+};
+
+#endif // SHARDEDMAP_H
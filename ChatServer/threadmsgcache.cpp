@@ -0,0 +1,293 @@
+﻿#include "threadmsgcache.h"
+#include <map>
+#include "configmgr.h"
+#include "redismgr.h"
+#include "mysqlmgr.h"
+#include "chatmsgwriter.h"
+#include "../Common/jsonutil.h"
+#include "const.h"
+
+/******************************************************************************
+ * @file       threadmsgcache.cpp
+ * @brief      活跃会话的最近消息缓存实现，读写都用lua脚本保证窗口下界和成员一致
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 窗口下界在有序集合中的成员名，消息成员都是json，不会重名
+static const std::string FLOOR_MEMBER = "floor";
+
+// 超出容量时淘汰最旧的消息并抬高下界，调用前已取出floor成员，结束时放回，不修改过期时间
+// 变量：floor为当前下界（没有窗口时为nil），cap为容量
+static const std::string TRIM_SCRIPT =
+    "local n = redis.call('ZCARD', KEYS[1]) "
+    "if n > cap then "
+    "  redis.call('ZREMRANGEBYRANK', KEYS[1], 0, n - cap - 1) "
+    "  local low = redis.call('ZRANGE', KEYS[1], 0, 0, 'WITHSCORES') "
+    "  if floor then floor = math.max(floor, tonumber(low[2]) - 1) end "
+    "end "
+    "if floor then redis.call('ZADD', KEYS[1], floor, '" + FLOOR_MEMBER + "') end ";
+
+// 同一id的旧成员先删除，保证每条消息只有一个成员；
+// 只给还没有过期时间的集合设置过期，追加不延长窗口的寿命
+// ARGV: 容量, 过期时间, 之后为id和json交替
+static const std::string APPEND_SCRIPT =
+    "local cap = tonumber(ARGV[1]) "
+    "local floor = redis.call('ZSCORE', KEYS[1], '" + FLOOR_MEMBER + "') "
+    "if floor then floor = tonumber(floor) redis.call('ZREM', KEYS[1], '" + FLOOR_MEMBER + "') end "
+    "for i = 3, #ARGV, 2 do "
+    "  if not floor or tonumber(ARGV[i]) > floor then "
+    "    redis.call('ZREMRANGEBYSCORE', KEYS[1], ARGV[i], ARGV[i]) "
+    "    redis.call('ZADD', KEYS[1], ARGV[i], ARGV[i + 1]) "
+    "  end "
+    "end " + TRIM_SCRIPT +
+    "if redis.call('TTL', KEYS[1]) < 0 then redis.call('EXPIRE', KEYS[1], ARGV[2]) end "
+    "return 1";
+
+// 只补写集合中还没有的id，已有成员可能是从mysql重建的新状态，不能用旧内容覆盖；
+// 没有补写任何消息时不产生写操作
+// ARGV: 容量, 过期时间, 之后为id和json交替
+static const std::string REPAIR_SCRIPT =
+    "local cap = tonumber(ARGV[1]) "
+    "local floor = redis.call('ZSCORE', KEYS[1], '" + FLOOR_MEMBER + "') "
+    "if floor then floor = tonumber(floor) end "
+    "local missing = {} "
+    "for i = 3, #ARGV, 2 do "
+    "  if (not floor or tonumber(ARGV[i]) > floor) and redis.call('ZCOUNT', KEYS[1], ARGV[i], ARGV[i]) == 0 then "
+    "    missing[#missing + 1] = i "
+    "  end "
+    "end "
+    "if #missing == 0 then return 0 end "
+    "if floor then redis.call('ZREM', KEYS[1], '" + FLOOR_MEMBER + "') end "
+    "for _, i in ipairs(missing) do redis.call('ZADD', KEYS[1], ARGV[i], ARGV[i + 1]) end " + TRIM_SCRIPT +
+    "if redis.call('TTL', KEYS[1]) < 0 then redis.call('EXPIRE', KEYS[1], ARGV[2]) end "
+    "return #missing";
+
+// 从mysql读到的最近消息和已追加的消息合并，mysql读取期间追加的消息不会丢失；
+// 过期时间从建立窗口时开始计算，之后的读取和追加都不续期，不完整的窗口最多存活一个TTL
+// ARGV: 容量, 过期时间, 新窗口的下界, 之后为id和json交替
+static const std::string FILL_SCRIPT =
+    "local cap = tonumber(ARGV[1]) "
+    "local floor = tonumber(ARGV[3]) "
+    "local old = redis.call('ZSCORE', KEYS[1], '" + FLOOR_MEMBER + "') "
+    "if old then floor = math.min(floor, tonumber(old)) redis.call('ZREM', KEYS[1], '" + FLOOR_MEMBER + "') end "
+    "for i = 4, #ARGV, 2 do "
+    "  redis.call('ZREMRANGEBYSCORE', KEYS[1], ARGV[i], ARGV[i]) "
+    "  redis.call('ZADD', KEYS[1], ARGV[i], ARGV[i + 1]) "
+    "end " + TRIM_SCRIPT +
+    "redis.call('EXPIRE', KEYS[1], ARGV[2]) "
+    "return 1";
+
+// 没有窗口返回nil，游标在窗口之外返回0，否则返回游标之后、上界之内的消息，读取不续期
+// ARGV: 游标, 条数, 上界
+static const std::string LOAD_SCRIPT =
+    "local floor = redis.call('ZSCORE', KEYS[1], '" + FLOOR_MEMBER + "') "
+    "if not floor then return false end "
+    "if tonumber(ARGV[1]) < tonumber(floor) then return 0 end "
+    "return redis.call('ZRANGEBYSCORE', KEYS[1], '(' .. ARGV[1], ARGV[3], 'LIMIT', 0, ARGV[2])";
+
+// 读取正整数配置，未配置时使用默认值
+static int threadMsgCacheConfig(const std::string& key, int default_value) {
+    auto value_str = ConfigMgr::getInst()["ThreadMsgCache"][key];
+    if (value_str.empty()) {
+        return default_value;
+    }
+    int value = atoi(value_str.c_str());
+    return value >= 0 ? value : default_value;
+}
+
+ThreadMsgCache::ThreadMsgCache() : capacity_(threadMsgCacheConfig("Capacity", 200)),
+    ttl_(threadMsgCacheConfig("TTL", 600)) {
+    if (ttl_ == 0) {
+        ttl_ = 600;
+    }
+}
+
+ThreadMsgCache::~ThreadMsgCache() {
+}
+
+bool ThreadMsgCache::enabled() const {
+    return capacity_ > 0;
+}
+
+std::shared_ptr<PageResult> ThreadMsgCache::load(int thread_id, int last_message_id, int max_message_id,
+    int page_size, bool& b_window) {
+    b_window = true;
+    if (!enabled()) {
+        return nullptr;
+    }
+
+    //多取一条判断是否还有更多
+    std::vector<RedisCommand> commands{ { "EVAL", LOAD_SCRIPT, "1", cacheKey(thread_id),
+        std::to_string(last_message_id), std::to_string(page_size + 1), std::to_string(max_message_id) } };
+    std::vector<RedisResult> results;
+    if (!RedisMgr::getInstance()->pipeline(commands, results) || results.empty()) {
+        return nullptr;
+    }
+    auto& result = results[0];
+    if (result.type == REDIS_REPLY_NIL) {
+        b_window = false;
+        return nullptr;
+    }
+    if (result.type != REDIS_REPLY_ARRAY) {
+        return nullptr;
+    }
+
+    auto page_res = std::make_shared<PageResult>();
+    page_res->load_more = false;
+    for (auto& element : result.elements) {
+        ChatMessage msg;
+        if (!decode(element.str, msg)) {
+            //缓存内容异常，交给mysql处理并重建
+            invalidate(thread_id);
+            return nullptr;
+        }
+        page_res->messages.push_back(std::move(msg));
+    }
+    if (page_res->messages.size() > static_cast<std::size_t>(page_size)) {
+        page_res->messages.pop_back();
+        page_res->load_more = true;
+    }
+    page_res->next_cursor = page_res->messages.empty() ? last_message_id : page_res->messages.back().message_id;
+    return page_res;
+}
+
+void ThreadMsgCache::fill(int thread_id) {
+    if (!enabled()) {
+        return;
+    }
+    //本服务器还有该会话未落库的消息时mysql中的最近消息不完整，不建立窗口，落库后再建
+    if (ChatMsgWriter::getInstance()->hasPending(thread_id)) {
+        return;
+    }
+
+    std::vector<ChatMessage> messages;
+    if (!MysqlMgr::getInstance()->loadLatestChatMsg(thread_id, capacity_, messages)) {
+        return;
+    }
+
+    //不足容量说明会话的消息全部在内，下界为0
+    int floor = 0;
+    if (messages.size() >= static_cast<std::size_t>(capacity_)) {
+        floor = messages.back().message_id - 1;
+    }
+    RedisCommand command{ "EVAL", FILL_SCRIPT, "1", cacheKey(thread_id),
+        std::to_string(capacity_), std::to_string(ttl_), std::to_string(floor) };
+    for (auto& msg : messages) {
+        command.push_back(std::to_string(msg.message_id));
+        command.push_back(encode(msg));
+    }
+    std::vector<RedisCommand> commands{ std::move(command) };
+    std::vector<RedisResult> results;
+    RedisMgr::getInstance()->pipeline(commands, results);
+}
+
+void ThreadMsgCache::append(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas) {
+    if (!enabled() || chat_datas.empty()) {
+        return;
+    }
+
+    //还没有窗口的会话也先写入，之后fill时合并，避免和mysql读取交错时丢消息
+    RedisCommand command{ "EVAL", APPEND_SCRIPT, "1", cacheKey(chat_datas.front()->thread_id),
+        std::to_string(capacity_), std::to_string(ttl_) };
+    for (auto& msg : chat_datas) {
+        command.push_back(std::to_string(msg->message_id));
+        command.push_back(encode(*msg));
+    }
+    std::vector<RedisCommand> commands{ std::move(command) };
+    std::vector<RedisResult> results;
+    if (!RedisMgr::getInstance()->pipeline(commands, results) || results.empty()
+        || results[0].type == REDIS_REPLY_ERROR) {
+        //追加失败时窗口不再完整，撤销后重建
+        invalidate(chat_datas.front()->thread_id);
+    }
+}
+
+void ThreadMsgCache::repair(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas) {
+    if (!enabled() || chat_datas.empty()) {
+        return;
+    }
+
+    std::map<int, RedisCommand> thread_commands;
+    for (auto& msg : chat_datas) {
+        auto& command = thread_commands[msg->thread_id];
+        if (command.empty()) {
+            command = { "EVAL", REPAIR_SCRIPT, "1", cacheKey(msg->thread_id),
+                std::to_string(capacity_), std::to_string(ttl_) };
+        }
+        command.push_back(std::to_string(msg->message_id));
+        command.push_back(encode(*msg));
+    }
+    std::vector<int> thread_ids;
+    std::vector<RedisCommand> commands;
+    for (auto& [thread_id, command] : thread_commands) {
+        thread_ids.push_back(thread_id);
+        commands.push_back(std::move(command));
+    }
+    std::vector<RedisResult> results;
+    bool b_ok = RedisMgr::getInstance()->pipeline(commands, results);
+    for (std::size_t i = 0; i < thread_ids.size(); ++i) {
+        //补写失败时窗口可能缺少消息，撤销后重建
+        if (!b_ok || i >= results.size() || results[i].type == REDIS_REPLY_ERROR) {
+            invalidate(thread_ids[i]);
+        }
+    }
+}
+
+void ThreadMsgCache::remove(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas) {
+    if (!enabled() || chat_datas.empty()) {
+        return;
+    }
+    std::vector<RedisCommand> commands;
+    for (auto& msg : chat_datas) {
+        auto id_str = std::to_string(msg->message_id);
+        commands.push_back({ "ZREMRANGEBYSCORE", cacheKey(msg->thread_id), id_str, id_str });
+    }
+    std::vector<RedisResult> results;
+    RedisMgr::getInstance()->pipeline(commands, results);
+}
+
+void ThreadMsgCache::invalidate(int thread_id) {
+    if (!enabled()) {
+        return;
+    }
+    //只撤销下界，已追加但可能还没落库的消息保留在集合中，重建时和mysql的结果合并
+    std::vector<RedisCommand> commands{ { "ZREM", cacheKey(thread_id), FLOOR_MEMBER } };
+    std::vector<RedisResult> results;
+    RedisMgr::getInstance()->pipeline(commands, results);
+}
+
+std::string ThreadMsgCache::cacheKey(int thread_id) {
+    return THREAD_MSG_PREFIX + std::to_string(thread_id);
+}
+
+std::string ThreadMsgCache::encode(const ChatMessage& msg) {
+    Json::Value root;
+    root["message_id"] = msg.message_id;
+    root["thread_id"] = msg.thread_id;
+    root["sender_id"] = msg.sender_id;
+    root["recv_id"] = msg.recv_id;
+    root["content"] = msg.content;
+    root["chat_time"] = msg.chat_time;
+    root["status"] = msg.status;
+    root["msg_type"] = msg.msg_type;
+    return toJsonString(root);
+}
+
+bool ThreadMsgCache::decode(const std::string& data, ChatMessage& msg) {
+    Json::Value root;
+    if (!parseJson(data, root) || !root.isObject()) {
+        return false;
+    }
+    msg.message_id = root["message_id"].asInt();
+    msg.thread_id = root["thread_id"].asInt();
+    msg.sender_id = root["sender_id"].asInt();
+    msg.recv_id = root["recv_id"].asInt();
+    msg.content = root["content"].asString();
+    msg.chat_time = root["chat_time"].asString();
+    msg.status = root["status"].asInt();
+    msg.msg_type = root["msg_type"].asInt();
+    return true;
+}
@@ -0,0 +1,52 @@
+﻿#ifndef THREADMSGCACHE_H
+#define THREADMSGCACHE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "singleton.h"
+#include "data.h"
+
+/******************************************************************************
+ * @file       threadmsgcache.h
+ * @brief      活跃会话的最近消息缓存，每个会话一个redis有序集合，
+ *             分数为message_id，成员为消息json，最多保留最近Capacity条；
+ *             集合中的floor成员记录窗口下界，id大于下界的消息都在集合中，
+ *             游标不小于下界的翻页请求直接由缓存返回
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+class ThreadMsgCache : public Singleton<ThreadMsgCache> {
+    friend class Singleton<ThreadMsgCache>;
+public:
+    ~ThreadMsgCache();
+    // 配置[ThreadMsgCache] Capacity为0时关闭
+    bool enabled() const;
+    // 按游标翻页，只返回message_id不超过max_message_id的消息；
+    // 命中返回结果，未命中返回空，b_window为false表示该会话还没有缓存窗口，需要fill
+    std::shared_ptr<PageResult> load(int thread_id, int last_message_id, int max_message_id, int page_size, bool& b_window);
+    // 用mysql中最近的消息建立缓存窗口，和期间追加的消息合并
+    void fill(int thread_id);
+    // 追加新保存的消息，消息需属于同一个会话
+    void append(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas);
+    // 落库后补写缓存中缺少的消息，已有的成员不覆盖，可以包含多个会话的消息，一次往返完成
+    void repair(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas);
+    // 删除已追加但最终没有落库的消息
+    void remove(const std::vector<std::shared_ptr<ChatMessage>>& chat_datas);
+    // 会话中已有的消息被修改或有消息绕过append写入时撤销窗口，下次读取时从mysql重建
+    void invalidate(int thread_id);
+private:
+    ThreadMsgCache();
+
+    static std::string cacheKey(int thread_id);
+    static std::string encode(const ChatMessage& msg);
+    static bool decode(const std::string& data, ChatMessage& msg);
+
+    int capacity_;
+    int ttl_;
+};
+
+#endif // THREADMSGCACHE_H
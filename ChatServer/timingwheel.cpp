@@ -0,0 +1,70 @@
+﻿#include "timingwheel.h"
+
+/******************************************************************************
+ * @file       timingwheel.cpp
+ * @brief      哈希时间轮实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+TimingWheel::TimingWheel(std::size_t timeout_ticks)
+    : slots_(timeout_ticks + 1), cursor_(0), timeout_ticks_(timeout_ticks) {
+}
+
+void TimingWheel::touch(const std::string& uuid, std::shared_ptr<CSession> session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto slot = (cursor_ + timeout_ticks_) % slots_.size();
+    auto iter = entries_.find(uuid);
+    if (iter != entries_.end()) {
+        auto& entry = iter->second;
+        // 同一个tick内多次刷新无需移动
+        if (entry.slot == slot) {
+            return;
+        }
+        // splice只修改链表指针，原有迭代器仍然有效
+        slots_[slot].splice(slots_[slot].end(), slots_[entry.slot], entry.iter);
+        entry.slot = slot;
+        return;
+    }
+
+    slots_[slot].push_back(Slot{ uuid, session });
+    entries_.emplace(uuid, Entry{ slot, std::prev(slots_[slot].end()) });
+}
+
+void TimingWheel::remove(const std::string& uuid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = entries_.find(uuid);
+    if (iter == entries_.end()) {
+        return;
+    }
+    slots_[iter->second.slot].erase(iter->second.iter);
+    entries_.erase(iter);
+}
+
+std::vector<std::shared_ptr<CSession>> TimingWheel::tick() {
+    Bucket due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cursor_ = (cursor_ + 1) % slots_.size();
+        due.swap(slots_[cursor_]);
+        for (auto& item : due) {
+            entries_.erase(item.key);
+        }
+    }
+
+    std::vector<std::shared_ptr<CSession>> expired;
+    for (auto& item : due) {
+        auto session = item.session.lock();
+        if (session) {
+            expired.push_back(session);
+        }
+    }
+    return expired;
+}
+
+std::size_t TimingWheel::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
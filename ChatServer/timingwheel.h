@@ -0,0 +1,57 @@
+﻿#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/******************************************************************************
+ * @file       timingwheel.h
+ * @brief      哈希时间轮，用于会话心跳超时检测
+ *             每个桶对应一个tick，刷新心跳时把会话移到timeout个tick之后的桶中，
+ *             每个tick只处理当前到期的桶，开销与在线会话总数无关；
+ *             以会话uuid为键，旧会话的残留条目不会被同一地址上的新会话继承
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+class CSession;
+
+class TimingWheel {
+public:
+    // timeout_ticks: 超时的tick数，桶的数量为timeout_ticks + 1
+    explicit TimingWheel(std::size_t timeout_ticks);
+    // 刷新会话的超时时间，O(1)
+    void touch(const std::string& uuid, std::shared_ptr<CSession> session);
+    // 将会话移出时间轮
+    void remove(const std::string& uuid);
+    // 前进一个tick，返回到期的会话
+    std::vector<std::shared_ptr<CSession>> tick();
+    // 时间轮中的会话数量
+    std::size_t size();
+private:
+    // 桶中同时保存会话uuid，会话析构后仍能用它清理索引
+    struct Slot {
+        std::string key;
+        std::weak_ptr<CSession> session;
+    };
+    using Bucket = std::list<Slot>;
+    // 会话所在的桶及其在桶中的位置，用于O(1)移动
+    struct Entry {
+        std::size_t slot;
+        Bucket::iterator iter;
+    };
+
+    std::mutex mutex_;
+    std::vector<Bucket> slots_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::size_t cursor_;
+    std::size_t timeout_ticks_;
+};
+
+#endif // TIMINGWHEEL_H
@@ -0,0 +1,208 @@
+﻿#include "usercache.h"
+#include "configmgr.h"
+#include "redismgr.h"
+#include "const.h"
+
+/******************************************************************************
+ * @file       usercache.cpp
+ * @brief      进程内的用户基础信息缓存实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history    2026/10/18 按uid分片加锁
+ *****************************************************************************/
+
+// 键空间通知的频道前缀，只使用0号库
+static const std::string KEYSPACE_PREFIX = "__keyspace@0__:";
+
+// 本节点写入后等待对应通知的最长时间
+static const std::chrono::seconds LOCAL_WRITE_WINDOW(5);
+
+// 读取正整数配置，未配置时使用默认值
+static int userCacheConfig(const std::string& key, int default_value) {
+    auto value_str = ConfigMgr::getInst()["UserCache"][key];
+    int value = value_str.empty() ? 0 : atoi(value_str.c_str());
+    return value > 0 ? value : default_value;
+}
+
+UserCache::UserCache() : shard_capacity_((userCacheConfig("Capacity", 10000) + SHARD_COUNT - 1) / SHARD_COUNT),
+    ttl_(userCacheConfig("TTL", 60)), hits_(0), misses_(0) {
+    //需要redis开启notify-keyspace-events K$gx，未开启时依靠过期时间兜底
+    std::vector<std::string> patterns{ KEYSPACE_PREFIX + USER_BASE_INFO + "*", KEYSPACE_PREFIX + NAME_INFO + "*" };
+    RedisMgr::getInstance()->subscribe({}, patterns, [](const std::string& channel, const std::string& event) {
+        if (channel.compare(0, KEYSPACE_PREFIX.size(), KEYSPACE_PREFIX) == 0) {
+            UserCache::getInstance()->onKeyChanged(channel.substr(KEYSPACE_PREFIX.size()));
+        }
+        });
+}
+
+UserCache::~UserCache() {
+}
+
+bool UserCache::get(int uid, UserInfo& info) {
+    std::shared_ptr<const UserInfo> cached;
+    {
+        auto& shard = shardOf(uid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        cached = lookup(shard, uid);
+    }
+    if (!cached) {
+        misses_++;
+        return false;
+    }
+    hits_++;
+    info = *cached;
+    return true;
+}
+
+bool UserCache::getByName(const std::string& name, UserInfo& info) {
+    std::shared_ptr<const UserInfo> cached;
+    int uid = 0;
+    if (name_index_.find(name, uid)) {
+        auto& shard = shardOf(uid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        cached = lookup(shard, uid);
+    }
+    //两次加锁之间该用户可能已被淘汰或改名
+    if (!cached || cached->name != name) {
+        misses_++;
+        return false;
+    }
+    hits_++;
+    info = *cached;
+    return true;
+}
+
+void UserCache::put(const UserInfo& info) {
+    auto cached = std::make_shared<const UserInfo>(info);
+    auto& shard = shardOf(info.uid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    eraseLocked(shard, info.uid);
+
+    shard.lru.push_front(info.uid);
+    shard.entries[info.uid] = Entry{ cached, Clock::now() + ttl_, shard.lru.begin() };
+    if (!info.name.empty()) {
+        name_index_.set(info.name, info.uid);
+    }
+
+    //超出容量则淘汰最久未使用的
+    while (shard.entries.size() > shard_capacity_) {
+        eraseLocked(shard, shard.lru.back());
+    }
+}
+
+void UserCache::invalidate(int uid) {
+    auto& shard = shardOf(uid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    eraseLocked(shard, uid);
+}
+
+void UserCache::invalidateName(const std::string& name) {
+    int uid = 0;
+    if (!name_index_.find(name, uid)) {
+        return;
+    }
+    auto& shard = shardOf(uid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.entries.find(uid);
+    if (iter != shard.entries.end() && iter->second.info->name == name) {
+        eraseLocked(shard, uid);
+    }
+}
+
+// 写入前登记，保证通知到达时已经能查到
+void UserCache::noteLocalWrite(const std::string& key) {
+    auto now = Clock::now();
+    auto& shard = shardOfKey(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto& local_writes = shard.local_writes;
+    //收不到通知时登记会一直留着，数量过多时清理过期的
+    if (local_writes.size() > shard_capacity_) {
+        for (auto iter = local_writes.begin(); iter != local_writes.end();) {
+            if (now >= iter->second.expire_at) {
+                iter = local_writes.erase(iter);
+            }
+            else {
+                ++iter;
+            }
+        }
+    }
+    auto& write = local_writes[key];
+    if (now >= write.expire_at) {
+        write.count = 0;
+    }
+    write.count++;
+    write.expire_at = now + LOCAL_WRITE_WINDOW;
+}
+
+void UserCache::onKeyChanged(const std::string& key) {
+    //本节点自己的写入，缓存中已是写入的内容，不需要失效
+    {
+        auto& shard = shardOfKey(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto iter = shard.local_writes.find(key);
+        if (iter != shard.local_writes.end()) {
+            bool b_local = Clock::now() < iter->second.expire_at;
+            if (--iter->second.count <= 0 || !b_local) {
+                shard.local_writes.erase(iter);
+            }
+            if (b_local) {
+                return;
+            }
+        }
+    }
+
+    std::string base_prefix = USER_BASE_INFO;
+    std::string name_prefix = NAME_INFO;
+    if (key.compare(0, base_prefix.size(), base_prefix) == 0) {
+        auto uid = atoi(key.c_str() + base_prefix.size());
+        invalidate(uid);
+    }
+    else if (key.compare(0, name_prefix.size(), name_prefix) == 0) {
+        invalidateName(key.substr(name_prefix.size()));
+    }
+}
+
+UserCacheStats UserCache::getStats() {
+    UserCacheStats stats;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.size += shard.entries.size();
+    }
+    stats.hits = hits_;
+    stats.misses = misses_;
+    return stats;
+}
+
+UserCache::Shard& UserCache::shardOf(int uid) {
+    return shards_[static_cast<unsigned int>(uid) % SHARD_COUNT];
+}
+
+UserCache::Shard& UserCache::shardOfKey(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % SHARD_COUNT];
+}
+
+std::shared_ptr<const UserInfo> UserCache::lookup(Shard& shard, int uid) {
+    auto iter = shard.entries.find(uid);
+    if (iter == shard.entries.end()) {
+        return nullptr;
+    }
+    if (Clock::now() >= iter->second.expire_at) {
+        eraseLocked(shard, uid);
+        return nullptr;
+    }
+    //移到表头
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second.lru_iter);
+    return iter->second.info;
+}
+
+void UserCache::eraseLocked(Shard& shard, int uid) {
+    auto iter = shard.entries.find(uid);
+    if (iter == shard.entries.end()) {
+        return;
+    }
+    //名字索引仍指向该用户时才删除
+    name_index_.eraseIf(iter->second.info->name, uid);
+    shard.lru.erase(iter->second.lru_iter);
+    shard.entries.erase(iter);
+}
@@ -0,0 +1,97 @@
+﻿#ifndef USERCACHE_H
+#define USERCACHE_H
+
+#include <list>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "singleton.h"
+#include "shardedmap.h"
+#include "data.h"
+
+/******************************************************************************
+ * @file       usercache.h
+ * @brief      进程内的用户基础信息缓存，位于redis和mysql之前
+ *             容量有限，按LRU淘汰，每项有过期时间；订阅redis键空间通知，
+ *             ubaseinfo_/nameinfo_被其他服务修改或删除时立即失效，
+ *             本节点自己写入产生的通知不使刚放入的缓存失效
+ *             按uid分片，每个分片有自己的锁和LRU，不同用户的查询互不阻塞
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history    2026/10/18 按uid分片加锁
+ *****************************************************************************/
+
+// 缓存命中统计
+struct UserCacheStats {
+    std::size_t size = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+class UserCache : public Singleton<UserCache> {
+    friend class Singleton<UserCache>;
+public:
+    ~UserCache();
+    // 按uid查询，命中则拷贝到info
+    bool get(int uid, UserInfo& info);
+    // 按名字查询
+    bool getByName(const std::string& name, UserInfo& info);
+    // 放入完整的用户信息，同时建立名字索引
+    void put(const UserInfo& info);
+    // 使缓存失效
+    void invalidate(int uid);
+    void invalidateName(const std::string& name);
+    // 本节点即将写入redis中的用户信息键，需在写入之前调用，对应的一次键空间通知将被忽略
+    void noteLocalWrite(const std::string& key);
+    // 收到redis键空间通知
+    void onKeyChanged(const std::string& key);
+    UserCacheStats getStats();
+private:
+    UserCache();
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::shared_ptr<const UserInfo> info;
+        Clock::time_point expire_at;
+        std::list<int>::iterator lru_iter;
+    };
+
+    // 本节点写入但尚未收到通知的键：剩余要忽略的通知数和截止时间，
+    // 未开启键空间通知时收不到通知，过期后不再忽略并清理
+    struct LocalWrite {
+        int count;
+        Clock::time_point expire_at;
+    };
+
+    // 用户信息按uid分片，本节点写入的登记按键名分片，各自在所在分片的mutex下访问
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<int, Entry> entries;
+        std::list<int> lru;    // 表头为最近使用
+        std::unordered_map<std::string, LocalWrite> local_writes;
+    };
+    static constexpr std::size_t SHARD_COUNT = 32;
+
+    Shard& shardOf(int uid);
+    Shard& shardOfKey(const std::string& key);
+    // 以下函数调用时需持有shard.mutex
+    std::shared_ptr<const UserInfo> lookup(Shard& shard, int uid);
+    void eraseLocked(Shard& shard, int uid);
+
+    std::size_t shard_capacity_;    // 每个分片的容量
+    std::chrono::seconds ttl_;
+    std::array<Shard, SHARD_COUNT> shards_;
+    // 名字到uid的索引，单独分片；查到的uid可能已被淘汰或改名，取出后需校验名字
+    ShardedMap<std::string, int> name_index_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+#endif // USERCACHE_H
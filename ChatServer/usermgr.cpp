@@ -11,28 +11,21 @@
  *****************************************************************************/
 
 UserMgr:: ~UserMgr() {
-	uid_to_session_.clear();
 }
 
 
 std::shared_ptr<CSession> UserMgr::getSession(int uid) {
-	std::lock_guard<std::mutex> lock(session_mtx_);
-	auto iter = uid_to_session_.find(uid);
-	if (iter == uid_to_session_.end()) {
-		return nullptr;
-	}
-
-	return iter->second;
+	std::shared_ptr<CSession> session;
+	uid_to_session_.find(uid, session);
+	return session;
 }
 
 void UserMgr::setUserSession(int uid, std::shared_ptr<CSession> session) {
-	std::lock_guard<std::mutex> lock(session_mtx_);
-	uid_to_session_[uid] = session;
+	uid_to_session_.set(uid, session);
 }
 
-void UserMgr::rmvUserSession(int uid) {
-	std::lock_guard<std::mutex> lock(session_mtx_);
-	uid_to_session_.erase(uid);
+void UserMgr::rmvUserSession(int uid, std::shared_ptr<CSession> session) {
+	uid_to_session_.eraseIf(uid, session);
 }
 
 UserMgr::UserMgr() {
@@ -2,9 +2,8 @@
 #define USERMGR_H_
 
 #include "singleton.h"
-#include <unordered_map>
+#include "shardedmap.h"
 #include <memory>
-#include <mutex>
 
 /******************************************************************************
  * @file       usermgr.h
@@ -25,12 +24,11 @@ public:
 	std::shared_ptr<CSession> getSession(int uid);
 	// 上线：将uid和session存入哈希表
 	void setUserSession(int uid, std::shared_ptr<CSession> session);
-	// 离线：从表中删除对应的 uid
-	void rmvUserSession(int uid);
+	// 离线：仅当uid仍绑定在该session上时删除，避免旧连接清理时删掉重新登录的新连接
+	void rmvUserSession(int uid, std::shared_ptr<CSession> session);
 private:
 	UserMgr();
-	std::mutex session_mtx_;
-	std::unordered_map<int, std::shared_ptr<CSession>> uid_to_session_;	// uid到session的映射表
+	ShardedMap<int, std::shared_ptr<CSession>> uid_to_session_;	// uid到session的映射表，按uid分片加锁
 };
 
 
@@ -0,0 +1,337 @@
+﻿#include "asyncredis.h"
+#include <charconv>
+#include <iostream>
+
+/******************************************************************************
+ * @file       asyncredis.cpp
+ * @brief      基于asio的异步redis客户端实现
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+AsyncRedisClient::AsyncRedisClient(net::any_io_executor executor, std::string host, int port, std::string pwd)
+    : strand_(net::make_strand(executor)), resolver_(strand_), socket_(strand_), reconnect_timer_(strand_),
+    host_(std::move(host)), port_(port), pwd_(std::move(pwd)), state_(State::Disconnected), writing_(false), generation_(0) {
+}
+
+void AsyncRedisClient::start() {
+    net::dispatch(strand_, [self = shared_from_this()]() {
+        if (self->state_ == State::Disconnected) {
+            self->doConnect();
+        }
+    });
+}
+
+void AsyncRedisClient::stop() {
+    net::dispatch(strand_, [self = shared_from_this()]() {
+        self->fail(net::error::operation_aborted);
+        self->state_ = State::Stopped;
+        self->reconnect_timer_.cancel();
+    });
+}
+
+void AsyncRedisClient::subscribe(std::vector<std::string> channels, std::vector<std::string> patterns,
+    MessageHandler handler) {
+    channels_ = std::move(channels);
+    patterns_ = std::move(patterns);
+    message_handler_ = std::move(handler);
+}
+
+void AsyncRedisClient::enqueue(std::vector<RedisCommand> commands, BatchHandler handler) {
+    net::dispatch(strand_, [self = shared_from_this(), commands = std::move(commands), handler = std::move(handler)]() mutable {
+        //连接断开期间直接失败，不在内存中堆积
+        if (self->state_ == State::Disconnected || self->state_ == State::Stopped) {
+            handler(net::error::not_connected, {});
+            return;
+        }
+        if (commands.empty()) {
+            handler({}, {});
+            return;
+        }
+
+        auto batch = std::make_shared<Batch>();
+        batch->expected = commands.size();
+        batch->results.reserve(commands.size());
+        batch->handler = std::move(handler);
+        for (auto& command : commands) {
+            encode(command, self->write_buf_);
+            self->pending_.push_back(batch);
+        }
+
+        //连接建立前的命令先留在缓冲区，连接后和认证命令一起发出
+        if (self->state_ == State::Connected) {
+            self->doWrite();
+        }
+    });
+}
+
+void AsyncRedisClient::doConnect() {
+    state_ = State::Connecting;
+    resolver_.async_resolve(host_, std::to_string(port_),
+        [self = shared_from_this()](const boost::system::error_code& ec, net::ip::tcp::resolver::results_type results) {
+            if (ec) {
+                self->fail(ec);
+                return;
+            }
+            net::async_connect(self->socket_, results,
+                [self](const boost::system::error_code& ec, const net::ip::tcp::endpoint&) {
+                    if (ec) {
+                        self->fail(ec);
+                        return;
+                    }
+                    self->onConnected();
+                });
+        });
+}
+
+void AsyncRedisClient::onConnected() {
+    boost::system::error_code ignored;
+    socket_.set_option(net::ip::tcp::no_delay(true), ignored);
+    read_buf_.clear();
+    writing_ = false;
+    ++generation_;
+
+    //认证和选库放在所有已排队命令之前
+    std::vector<RedisCommand> handshake;
+    if (!pwd_.empty()) {
+        handshake.push_back({ "AUTH", pwd_ });
+    }
+    handshake.push_back({ "SELECT", "0" });
+
+    auto batch = std::make_shared<Batch>();
+    batch->expected = handshake.size();
+    batch->handler = [](boost::system::error_code ec, std::vector<RedisResult> results) {
+        for (auto& result : results) {
+            if (result.type == REDIS_REPLY_ERROR) {
+                std::cout << "async redis handshake failed: " << result.str << std::endl;
+            }
+        }
+    };
+
+    std::string handshake_buf;
+    for (auto& command : handshake) {
+        encode(command, handshake_buf);
+        pending_.push_front(batch);
+    }
+
+    //订阅的确认回复由dispatchPush丢弃，不占用pending_
+    if (!channels_.empty()) {
+        RedisCommand command{ "SUBSCRIBE" };
+        command.insert(command.end(), channels_.begin(), channels_.end());
+        encode(command, handshake_buf);
+    }
+    if (!patterns_.empty()) {
+        RedisCommand command{ "PSUBSCRIBE" };
+        command.insert(command.end(), patterns_.begin(), patterns_.end());
+        encode(command, handshake_buf);
+    }
+    write_buf_.insert(0, handshake_buf);
+
+    state_ = State::Connected;
+    std::cout << "async redis connected to " << host_ << ":" << port_ << std::endl;
+    doRead();
+    doWrite();
+}
+
+// 同一时刻只有一个async_write，期间提交的命令攒到下一次一起写出
+void AsyncRedisClient::doWrite() {
+    if (writing_ || write_buf_.empty()) {
+        return;
+    }
+    writing_ = true;
+    sending_buf_.clear();
+    sending_buf_.swap(write_buf_);
+    net::async_write(socket_, net::buffer(sending_buf_),
+        [self = shared_from_this(), generation = generation_](const boost::system::error_code& ec, std::size_t) {
+            //重连前发起的操作直接忽略
+            if (generation != self->generation_) {
+                return;
+            }
+            self->writing_ = false;
+            if (ec) {
+                self->fail(ec);
+                return;
+            }
+            self->doWrite();
+        });
+}
+
+void AsyncRedisClient::doRead() {
+    auto offset = read_buf_.size();
+    read_buf_.resize(offset + 16 * 1024);
+    socket_.async_read_some(net::buffer(&read_buf_[offset], read_buf_.size() - offset),
+        [self = shared_from_this(), offset, generation = generation_](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+            if (generation != self->generation_) {
+                return;
+            }
+            if (ec) {
+                self->fail(ec);
+                return;
+            }
+            self->read_buf_.resize(offset + bytes_transferred);
+
+            //一次读取可能包含多个回复，逐个匹配到在途命令上
+            std::size_t pos = 0;
+            RedisResult result;
+            ParseStatus status;
+            while ((status = parse(self->read_buf_, pos, result)) == ParseStatus::Complete) {
+                if (self->dispatchPush(result) || self->pending_.empty()) {
+                    result = RedisResult();
+                    continue;
+                }
+                auto batch = self->pending_.front();
+                self->pending_.pop_front();
+                batch->results.push_back(std::move(result));
+                result = RedisResult();
+                if (batch->results.size() == batch->expected) {
+                    batch->handler({}, std::move(batch->results));
+                }
+            }
+            //协议错误后无法确定下一个回复从哪里开始，在途命令和回复已对不上，断开重连
+            if (status == ParseStatus::Error) {
+                self->fail(boost::system::errc::make_error_code(boost::system::errc::protocol_error));
+                return;
+            }
+            self->read_buf_.erase(0, pos);
+            self->doRead();
+        });
+}
+
+bool AsyncRedisClient::dispatchPush(RedisResult& result) {
+    if (!message_handler_ || result.type != REDIS_REPLY_ARRAY || result.elements.empty()) {
+        return false;
+    }
+
+    auto& kind = result.elements[0].str;
+    if (kind == "message" && result.elements.size() == 3) {
+        message_handler_(result.elements[1].str, result.elements[2].str);
+        return true;
+    }
+    if (kind == "pmessage" && result.elements.size() == 4) {
+        message_handler_(result.elements[2].str, result.elements[3].str);
+        return true;
+    }
+    //订阅和退订的确认
+    return kind == "subscribe" || kind == "psubscribe" || kind == "unsubscribe" || kind == "punsubscribe";
+}
+
+void AsyncRedisClient::fail(const boost::system::error_code& ec) {
+    //读写两端可能都报错，只处理第一次
+    if (state_ == State::Stopped || state_ == State::Disconnected) {
+        return;
+    }
+    if (ec != net::error::operation_aborted) {
+        std::cout << "async redis connection error: " << ec.message() << std::endl;
+    }
+
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+    write_buf_.clear();
+    read_buf_.clear();
+
+    //同一批次的多条命令只回调一次
+    std::shared_ptr<Batch> last;
+    for (auto& batch : pending_) {
+        if (batch != last) {
+            batch->handler(ec, {});
+            last = batch;
+        }
+    }
+    pending_.clear();
+
+    state_ = State::Disconnected;
+    reconnect_timer_.expires_after(std::chrono::seconds(1));
+    reconnect_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+        if (!ec && self->state_ == State::Disconnected) {
+            self->doConnect();
+        }
+    });
+}
+
+void AsyncRedisClient::encode(const RedisCommand& command, std::string& out) {
+    out += '*';
+    out += std::to_string(command.size());
+    out += "\r\n";
+    for (auto& arg : command) {
+        out += '$';
+        out += std::to_string(arg.size());
+        out += "\r\n";
+        out += arg;
+        out += "\r\n";
+    }
+}
+
+// 解析回复头中的整数，格式错误时返回false，不抛异常
+static bool parseNumber(const std::string& line, long long& value) {
+    auto end = line.data() + line.size();
+    auto [ptr, ec] = std::from_chars(line.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+AsyncRedisClient::ParseStatus AsyncRedisClient::parse(const std::string& data, std::size_t& pos, RedisResult& result) {
+    auto line_end = data.find("\r\n", pos);
+    if (pos >= data.size() || line_end == std::string::npos) {
+        return ParseStatus::Incomplete;
+    }
+
+    auto type = data[pos];
+    std::string line = data.substr(pos + 1, line_end - pos - 1);
+    auto next = line_end + 2;
+    long long number = 0;
+    if ((type == ':' || type == '$' || type == '*') && !parseNumber(line, number)) {
+        type = 0;
+    }
+    switch (type) {
+    case '+':
+        result.type = REDIS_REPLY_STATUS;
+        result.str = std::move(line);
+        break;
+    case '-':
+        result.type = REDIS_REPLY_ERROR;
+        result.str = std::move(line);
+        break;
+    case ':':
+        result.type = REDIS_REPLY_INTEGER;
+        result.integer = number;
+        break;
+    case '$': {
+        auto len = number;
+        if (len < 0) {
+            result.type = REDIS_REPLY_NIL;
+            break;
+        }
+        if (data.size() < next + len + 2) {
+            return ParseStatus::Incomplete;
+        }
+        result.type = REDIS_REPLY_STRING;
+        result.str.assign(data, next, static_cast<std::size_t>(len));
+        next += len + 2;
+        break;
+    }
+    case '*': {
+        auto count = number;
+        if (count < 0) {
+            result.type = REDIS_REPLY_NIL;
+            break;
+        }
+        result.type = REDIS_REPLY_ARRAY;
+        result.elements.resize(static_cast<std::size_t>(count));
+        for (auto& element : result.elements) {
+            auto status = parse(data, next, element);
+            if (status != ParseStatus::Complete) {
+                result.elements.clear();
+                return status;
+            }
+        }
+        break;
+    }
+    default:
+        //未知类型或长度不是数字
+        return ParseStatus::Error;
+    }
+
+    pos = next;
+    return ParseStatus::Complete;
+}
@@ -0,0 +1,143 @@
+﻿#ifndef ASYNCREDIS_H
+#define ASYNCREDIS_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <boost/asio.hpp>
+#include <hiredis.h>
+
+/******************************************************************************
+ * @file       asyncredis.h
+ * @brief      基于asio的异步redis客户端，直接在socket上收发RESP协议，
+ *             一条连接上可以同时有多条命令在途（按发送顺序匹配回复），
+ *             完成回调投递回调用方的executor，支持回调和co_await两种用法；
+ *             也可以切换为订阅连接，接收频道和模式订阅的消息；
+ *             只依赖boost.asio和hiredis的reply类型常量，各服务器共用
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history    2026/10/18 从ChatServer移到Common
+ *****************************************************************************/
+
+namespace net = boost::asio;
+
+// 一条命令，按参数拆分，支持二进制数据
+using RedisCommand = std::vector<std::string>;
+
+// 一条命令的执行结果，类型沿用hiredis的REDIS_REPLY_*常量
+struct RedisResult {
+    int type = REDIS_REPLY_NIL;     // hiredis的reply类型
+    long long integer = 0;          // 整数类型的结果
+    std::string str;                // 字符串、状态和错误类型的结果
+    std::vector<RedisResult> elements;  // 数组类型的元素
+};
+
+class AsyncRedisClient : public std::enable_shared_from_this<AsyncRedisClient> {
+public:
+    using BatchHandler = std::function<void(boost::system::error_code, std::vector<RedisResult>)>;
+    // 订阅消息回调，在客户端的strand上执行，channel为实际收到消息的频道
+    using MessageHandler = std::function<void(const std::string& channel, const std::string& message)>;
+
+    AsyncRedisClient(net::any_io_executor executor, std::string host, int port, std::string pwd);
+    // 发起连接，连接断开后每秒重连一次
+    void start();
+    // 关闭连接，在途的命令以operation_aborted结束
+    void stop();
+    // 切换为订阅连接，需在start之前调用，之后不能再执行普通命令，断线重连后自动重新订阅
+    void subscribe(std::vector<std::string> channels, std::vector<std::string> patterns, MessageHandler handler);
+
+    // 执行一条命令，完成签名为void(error_code, RedisResult)
+    template <typename CompletionToken>
+    auto asyncCommand(RedisCommand command, CompletionToken&& token) {
+        return net::async_initiate<CompletionToken, void(boost::system::error_code, RedisResult)>(
+            [self = shared_from_this()](auto handler, RedisCommand command) {
+                std::vector<RedisCommand> commands;
+                commands.push_back(std::move(command));
+                self->enqueue(std::move(commands), wrapHandler(std::move(handler),
+                    [](std::vector<RedisResult>& results) {
+                        return results.empty() ? RedisResult() : std::move(results.front());
+                    }));
+            }, token, std::move(command));
+    }
+
+    // 管道执行多条命令，一次写出，全部回复到达后完成，完成签名为void(error_code, std::vector<RedisResult>)
+    template <typename CompletionToken>
+    auto asyncPipeline(std::vector<RedisCommand> commands, CompletionToken&& token) {
+        return net::async_initiate<CompletionToken, void(boost::system::error_code, std::vector<RedisResult>)>(
+            [self = shared_from_this()](auto handler, std::vector<RedisCommand> commands) {
+                self->enqueue(std::move(commands), wrapHandler(std::move(handler),
+                    [](std::vector<RedisResult>& results) {
+                        return std::move(results);
+                    }));
+            }, token, std::move(commands));
+    }
+
+private:
+    // 同一次提交的命令共享一个批次，回复齐了再回调
+    struct Batch {
+        std::size_t expected = 0;
+        std::vector<RedisResult> results;
+        BatchHandler handler;
+    };
+
+    enum class State { Connecting, Connected, Disconnected, Stopped };
+
+    // 解析结果：数据不完整、解析出一个完整回复、协议错误（流已错位，只能断开重连）
+    enum class ParseStatus { Incomplete, Complete, Error };
+
+    // 把asio的完成处理器包装成BatchHandler，完成时投递回处理器关联的executor
+    template <typename Handler, typename Convert>
+    static BatchHandler wrapHandler(Handler handler, Convert convert) {
+        auto work = std::make_shared<net::executor_work_guard<net::associated_executor_t<Handler>>>(
+            net::make_work_guard(handler));
+        auto shared_handler = std::make_shared<Handler>(std::move(handler));
+        return [shared_handler, work, convert](boost::system::error_code ec, std::vector<RedisResult> results) {
+            auto executor = net::get_associated_executor(*shared_handler);
+            net::post(executor, [shared_handler, ec, result = convert(results)]() mutable {
+                (*shared_handler)(ec, std::move(result));
+            });
+            work->reset();
+        };
+    }
+
+    void enqueue(std::vector<RedisCommand> commands, BatchHandler handler);
+    void doConnect();
+    void onConnected();
+    void doWrite();
+    void doRead();
+    // 订阅连接上收到的推送消息，返回false表示不是推送
+    bool dispatchPush(RedisResult& result);
+    // 连接出错，结束所有在途命令并安排重连
+    void fail(const boost::system::error_code& ec);
+    // 追加一条RESP编码的命令
+    static void encode(const RedisCommand& command, std::string& out);
+    // 从pos开始解析一个完整的回复，只有Complete时移动pos
+    static ParseStatus parse(const std::string& data, std::size_t& pos, RedisResult& result);
+
+    net::strand<net::any_io_executor> strand_;
+    net::ip::tcp::resolver resolver_;
+    net::ip::tcp::socket socket_;
+    net::steady_timer reconnect_timer_;
+    std::string host_;
+    int port_;
+    std::string pwd_;
+    State state_;
+
+    // 已写入缓冲区、等待回复的命令，每条命令一项，按发送顺序排列
+    std::deque<std::shared_ptr<Batch>> pending_;
+    std::string write_buf_;     // 等待发送的数据
+    std::string sending_buf_;   // 正在发送的数据
+    bool writing_;
+    std::string read_buf_;
+    std::size_t generation_;    // 每次连接成功加一，用于丢弃旧连接上的回调
+
+    // 订阅连接
+    std::vector<std::string> channels_;
+    std::vector<std::string> patterns_;
+    MessageHandler message_handler_;
+};
+
+#endif // ASYNCREDIS_H
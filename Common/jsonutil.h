@@ -0,0 +1,45 @@
+#ifndef JSONUTIL_H
+#define JSONUTIL_H
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <json/json.h>
+
+/******************************************************************************
+ * @file       jsonutil.h
+ * @brief      json序列化和解析的工具函数，替代toStyledString和已废弃的Json::Reader
+ *             ChatServer、GateServer和ResourceServer共用，只有头文件，各服务器直接包含即可
+ *
+ * @author     lueying
+ * @date       2026/10/17
+ * @history
+ *****************************************************************************/
+
+// 紧凑格式序列化（无缩进和换行，中文直接输出UTF-8）
+// writer创建时需要解析配置，每个线程复用一个实例
+inline std::string toJsonString(const Json::Value& value) {
+    thread_local std::unique_ptr<Json::StreamWriter> writer = []() {
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        builder["emitUTF8"] = true;
+        return std::unique_ptr<Json::StreamWriter>(builder.newStreamWriter());
+    }();
+    std::ostringstream oss;
+    writer->write(value, &oss);
+    return oss.str();
+}
+
+// 解析json字符串，失败返回false，reader同样每个线程复用一个实例
+inline bool parseJson(std::string_view data, Json::Value& root) {
+    thread_local std::unique_ptr<Json::CharReader> reader = []() {
+        Json::CharReaderBuilder builder;
+        builder["collectComments"] = false;
+        return std::unique_ptr<Json::CharReader>(builder.newCharReader());
+    }();
+    std::string errs;
+    return reader->parse(data.data(), data.data() + data.size(), &root, &errs);
+}
+
+#endif // JSONUTIL_H
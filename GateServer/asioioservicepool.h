@@ -26,6 +26,10 @@ public:
     AsioIOServicePool& operator=(const AsioIOServicePool&) = delete;
     // 使用 round-robin 的方式返回一个 io_service
     boost::asio::io_context& getIOService();
+    // 按下标返回io_context，用于每个io线程各自监听端口
+    boost::asio::io_context& getIOService(std::size_t index);
+    // io_context的数量
+    std::size_t size() const;
     void stop();
 private:
     AsioIOServicePool(std::size_t size = 2/*std::thread::hardware_concurrency()*/);
@@ -12,33 +12,67 @@
  * @history
  *****************************************************************************/
 
-CServer::CServer(net::io_context& io_context, unsigned short port) :
-	acceptor_(io_context, tcp::endpoint(tcp::v4(), port)) {
+#ifdef SO_REUSEPORT
+using reuse_port_option = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
 
+CServer::CServer(net::io_context& io_context, unsigned short port, bool reuse_port) :
+	reuse_port_(reuse_port) {
+#ifndef SO_REUSEPORT
+	if (reuse_port_) {
+		std::cout << "SO_REUSEPORT is not supported on this platform, use single acceptor" << std::endl;
+		reuse_port_ = false;
+	}
+#else
+	if (reuse_port_) {
+		//每个io线程一个监听器，都绑定同一端口，新连接由内核分发，连接留在接受它的线程上
+		auto pool = AsioIOServicePool::getInstance();
+		tcp::endpoint endpoint(tcp::v4(), port);
+		for (std::size_t i = 0; i < pool->size(); ++i) {
+			auto acceptor = std::make_unique<tcp::acceptor>(pool->getIOService(i));
+			acceptor->open(endpoint.protocol());
+			acceptor->set_option(tcp::acceptor::reuse_address(true));
+			acceptor->set_option(reuse_port_option(true));
+			acceptor->bind(endpoint);
+			acceptor->listen();
+			acceptors_.push_back(std::move(acceptor));
+		}
+		return;
+	}
+#endif
+	acceptors_.push_back(std::make_unique<tcp::acceptor>(io_context, tcp::endpoint(tcp::v4(), port)));
 }
 
 // 接受http函数
 void CServer::start() {
+    for (std::size_t i = 0; i < acceptors_.size(); ++i) {
+        doAccept(i);
+    }
+}
+
+// 在第index个监听器上接受连接
+void CServer::doAccept(std::size_t index) {
     auto self = shared_from_this();
-    // 通过IOServicePool连接池中获取连接
-    auto& io_context = AsioIOServicePool::getInstance()->getIOService();
+    // reuse_port模式下连接和监听器使用同一个io_context，否则从IOServicePool连接池中轮询获取
+    auto pool = AsioIOServicePool::getInstance();
+    auto& io_context = reuse_port_ ? pool->getIOService(index) : pool->getIOService();
     std::shared_ptr<HttpConnection> new_con = std::make_shared<HttpConnection>(io_context);
-    acceptor_.async_accept(new_con->getSocket(), [self, new_con](beast::error_code ec) {
+    acceptors_[index]->async_accept(new_con->getSocket(), [self, new_con, index](beast::error_code ec) {
         try {
             //出错则放弃这个连接，继续监听新链接
             if (ec) {
-                self->start();
+                self->doAccept(index);
                 return;
             }
 
             //处理新链接，创建HpptConnection类管理新连接
             new_con->start();
             //继续监听
-            self->start();
+            self->doAccept(index);
         }
         catch (std::exception& exp) {
             std::cout << "exception is " << exp.what() << std::endl;
-            self->start();
+            self->doAccept(index);
         }
     });
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define CSERVER_H
 
 #include "const.h"
+#include <vector>
+#include <memory>
 
 /******************************************************************************
  * @file       cserver.h
@@ -16,13 +18,18 @@ class CServer : public std::enable_shared_from_this<CServer>
 {
 public:
 	// 构造函数传一个io管理器和端口
-	CServer(net::io_context& io_context, unsigned short port);
+	// reuse_port为true时在每个io线程上各开一个SO_REUSEPORT监听，由内核分发新连接
+	CServer(net::io_context& io_context, unsigned short port, bool reuse_port = false);
 	// 没有new不用写析构函数
 	// 接受http函数
 	void start();
 
 private:
-	tcp::acceptor acceptor_;	// 连接接收器
+	// 在第index个监听器上接受连接
+	void doAccept(std::size_t index);
+
+	bool reuse_port_;
+	std::vector<std::unique_ptr<tcp::acceptor>> acceptors_;	// 连接接收器
 };
 
 #endif // CSERVER_H
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "const.h"
 #include "configmgr.h"
 #include <iostream>
+#include "../Common/jsonutil.h"
 
 /******************************************************************************
  * @file       logicsystem.cpp
@@ -35,15 +36,14 @@ LogicSystem::LogicSystem() {
         std::cout << "receive body is " << body_str << std::endl;
         connection->response_.set(http::field::content_type, "text/json");
         Json::Value root;       // 返回给客户端的JSON
-        Json::Reader reader;    // 用于解析客户端发来的JSON
         Json::Value src_root;   // 解析后的客户端数据的JSON
         // 将string解析为JSON
-        bool parse_success = reader.parse(body_str, src_root);
+        bool parse_success = parseJson(body_str, src_root);
         if (!parse_success) {
             // 如果解析失败，返回错误信息
             std::cout << "Failed to parse JSON data!" << std::endl;
             root["error"] = ErrorCodes::Error_Json;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -55,7 +55,7 @@ LogicSystem::LogicSystem() {
         root["error"] = 0;
         root["email"] = src_root["email"];
         // 将JSON转化为string
-        std::string jsonstr = root.toStyledString();
+        std::string jsonstr = toJsonString(root);
         // 将string写入response body
         beast::ostream(connection->response_.body()) << jsonstr;
         return true;
@@ -67,13 +67,12 @@ LogicSystem::LogicSystem() {
         std::cout << "receive body is " << body_str << std::endl;
         connection->response_.set(http::field::content_type, "text/json");
         Json::Value root;
-        Json::Reader reader;
         Json::Value src_root;
-        bool parse_success = reader.parse(body_str, src_root);
+        bool parse_success = parseJson(body_str, src_root);
         if (!parse_success) {
             std::cout << "Failed to parse JSON data!" << std::endl;
             root["error"] = ErrorCodes::Error_Json;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -87,7 +86,7 @@ LogicSystem::LogicSystem() {
         if (pwd != confirm) {
             std::cout << "password err " << std::endl;
             root["error"] = ErrorCodes::PwdConfirmErr;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -101,7 +100,7 @@ LogicSystem::LogicSystem() {
             std::cout << " get varify code expired" << std::endl;
             std::cout << "Redis Error: Key NOT FOUND!" << std::endl;
             root["error"] = ErrorCodes::VerifyExpired;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         } else {
@@ -111,7 +110,7 @@ LogicSystem::LogicSystem() {
         if (verify_code != src_root["varifycode"].asString()) {
             std::cout << " varify code error" << std::endl;
             root["error"] = ErrorCodes::VerifyCodeErr;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -121,7 +120,7 @@ LogicSystem::LogicSystem() {
         if (uid == 0 || uid == -1) {
             std::cout << " user or email exist" << std::endl;
             root["error"] = ErrorCodes::UserExist;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -133,7 +132,7 @@ LogicSystem::LogicSystem() {
         root["confirm"] = confirm;
         root["icon"] = icon;
         root["varifycode"] = src_root["varifycode"].asString();
-        std::string jsonstr = root.toStyledString();
+        std::string jsonstr = toJsonString(root);
         beast::ostream(connection->response_.body()) << jsonstr;
         return true;
     });
@@ -144,13 +143,12 @@ LogicSystem::LogicSystem() {
         std::cout << "receive body is " << body_str << std::endl;
         connection->response_.set(http::field::content_type, "text/json");
         Json::Value root;
-        Json::Reader reader;
         Json::Value src_root;
-        bool parse_success = reader.parse(body_str, src_root);
+        bool parse_success = parseJson(body_str, src_root);
         if (!parse_success) {
             std::cout << "Failed to parse JSON data!" << std::endl;
             root["error"] = ErrorCodes::Error_Json;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -165,7 +163,7 @@ LogicSystem::LogicSystem() {
         if (!b_get_varify) {
             std::cout << " get varify code expired" << std::endl;
             root["error"] = ErrorCodes::VerifyExpired;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -173,7 +171,7 @@ LogicSystem::LogicSystem() {
         if (varify_code != src_root["varifycode"].asString()) {
             std::cout << " varify code error" << std::endl;
             root["error"] = ErrorCodes::VerifyCodeErr;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -183,7 +181,7 @@ LogicSystem::LogicSystem() {
         if (!email_valid) {
             std::cout << " user email not match" << std::endl;
             root["error"] = ErrorCodes::EmailNotMatch;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -193,7 +191,7 @@ LogicSystem::LogicSystem() {
         if (!b_up) {
             std::cout << " update pwd failed" << std::endl;
             root["error"] = ErrorCodes::PwdUpdateFailed;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -204,7 +202,7 @@ LogicSystem::LogicSystem() {
         root["user"] = name;
         root["passwd"] = pwd;
         root["varifycode"] = src_root["varifycode"].asString();
-        std::string jsonstr = root.toStyledString();
+        std::string jsonstr = toJsonString(root);
         beast::ostream(connection->response_.body()) << jsonstr;
         return true;
     });
@@ -215,13 +213,12 @@ LogicSystem::LogicSystem() {
         std::cout << "receive body is " << body_str << std::endl;
         connection->response_.set(http::field::content_type, "text/json");
         Json::Value root;
-        Json::Reader reader;
         Json::Value src_root;
-        bool parse_success = reader.parse(body_str, src_root);
+        bool parse_success = parseJson(body_str, src_root);
         if (!parse_success) {
             std::cout << "Failed to parse JSON data!" << std::endl;
             root["error"] = ErrorCodes::Error_Json;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -234,7 +231,7 @@ LogicSystem::LogicSystem() {
         if (!pwd_valid) {
             std::cout << " user pwd not match" << std::endl;
             root["error"] = ErrorCodes::PasswdInvalid;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -244,7 +241,7 @@ LogicSystem::LogicSystem() {
         if (reply.error()) {
             std::cout << " grpc get chat server failed, error is " << reply.error() << std::endl;
             root["error"] = ErrorCodes::RPCGetFailed;
-            std::string jsonstr = root.toStyledString();
+            std::string jsonstr = toJsonString(root);
             beast::ostream(connection->response_.body()) << jsonstr;
             return true;
         }
@@ -262,7 +259,7 @@ LogicSystem::LogicSystem() {
         root["reshost"] = res_host;
         root["resport"] = res_port;
 
-        std::string jsonstr = root.toStyledString();
+        std::string jsonstr = toJsonString(root);
         beast::ostream(connection->response_.body()) << jsonstr;
         return true;
     });
@@ -21,6 +21,8 @@ int main()
         ConfigMgr& gCfgMgr = ConfigMgr::getInst();
         std::string gate_port_str = gCfgMgr["GateServer"]["Port"];
         unsigned short gate_port = atoi(gate_port_str.c_str());
+        // 开启后每个io线程各自监听端口
+        bool reuse_port = gCfgMgr["GateServer"]["ReusePort"] == "true";
         net::io_context ioc{ 1 };
         // 监听操作系统的信号
         boost::asio::signal_set signals(ioc, SIGINT, SIGTERM);
@@ -31,7 +33,7 @@ int main()
             }
             ioc.stop();
             });
-        std::make_shared<CServer>(ioc, gate_port)->start();
+        std::make_shared<CServer>(ioc, gate_port, reuse_port)->start();
         ioc.run();
     }
     catch (std::exception const& e)
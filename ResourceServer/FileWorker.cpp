@@ -8,6 +8,27 @@
 #include "MysqlMgr.h"
 #include "RedisMgr.h"
 #include "ChatServerGrpcClient.h"
+#include "../Common/jsonutil.h"
+
+// 消息落库前留下的上传完成标记的保留时间（秒）
+static const int CHAT_MSG_UPLOADED_TTL = 24 * 3600;
+
+// 更新图片消息的上传状态，并撤销ChatServer中该会话的消息缓存窗口，避免翻页读到旧状态；
+// 只删除窗口下界，集合中ChatServer还没落库的消息保留，重建时由mysql中的新状态覆盖
+static void UpdateChatImgStatus(int chat_msg_id)
+{
+	if (!MysqlMgr::GetInstance()->UpdateUploadStatus(chat_msg_id)) {
+		//ChatServer启用写后持久化时消息可能还没落库：先留下标记，ChatServer落库后按标记补上状态；
+		//再更新一次，覆盖写标记之前已经落库、ChatServer却没看到标记的情况
+		RedisMgr::GetInstance()->SetExp(CHAT_MSG_UPLOADED_PREFIX + std::to_string(chat_msg_id), "1",
+			CHAT_MSG_UPLOADED_TTL);
+		MysqlMgr::GetInstance()->UpdateUploadStatus(chat_msg_id);
+	}
+	auto chat_msg = MysqlMgr::GetInstance()->GetChatMsgById(chat_msg_id);
+	if (chat_msg) {
+		RedisMgr::GetInstance()->ZRem(THREAD_MSG_PREFIX + std::to_string(chat_msg->thread_id), THREAD_MSG_FLOOR);
+	}
+}
 
 FileWorker::FileWorker() :_b_stop(false)
 {
@@ -187,7 +208,7 @@ void FileWorker::RegisterHandlers()
 			redis_root["sex"] = user_info->sex;
 			redis_root["icon"] = user_info->icon;
 			std::string base_key = USER_BASE_INFO + std::to_string(task->_uid);
-			RedisMgr::GetInstance()->Set(base_key, redis_root.toStyledString());
+			RedisMgr::GetInstance()->Set(base_key, toJsonString(redis_root));
 		}
 
 		if (task->_callback) {
@@ -253,7 +274,7 @@ void FileWorker::RegisterHandlers()
 		if (last) {
 			std::cout << "文件已成功保存为: " << task->_name << std::endl;
 			//更新数据库聊天图像上传状态
-			MysqlMgr::GetInstance()->UpdateUploadStatus(task->_chat_msg_id);
+			UpdateChatImgStatus(task->_chat_msg_id);
 
 			std::string uid_ip_value = "";
 			auto receiver_str = std::to_string(task->_receiver);
@@ -340,7 +361,7 @@ void FileWorker::RegisterHandlers()
 		if (last) {
 			std::cout << "文件已成功保存为: " << task->_name << std::endl;
 			//todo...更新数据库聊天图像上传状态
-			MysqlMgr::GetInstance()->UpdateUploadStatus(task->_chat_msg_id);
+			UpdateChatImgStatus(task->_chat_msg_id);
 			std::string uid_ip_value = "";
 			auto receiver_str = std::to_string(task->_receiver);
 			auto uid_ip_key = USERIPPREFIX + receiver_str;
@@ -426,7 +447,7 @@ void FileWorker::RegisterHandlers()
 		if (last) {
 			std::cout << "文件已成功保存为: " << task->_name << std::endl;
 			//更新数据库聊天图像上传状态
-			MysqlMgr::GetInstance()->UpdateUploadStatus(task->_chat_msg_id);
+			UpdateChatImgStatus(task->_chat_msg_id);
 
 			std::string uid_ip_value = "";
 			auto receiver_str = std::to_string(task->_receiver);
@@ -8,6 +8,7 @@
 #include "ConfigMgr.h"
 #include "RedisMgr.h"
 #include "MysqlMgr.h"
+#include "../Common/jsonutil.h"
 
 LogicWorker::LogicWorker():_b_stop(false)
 {
@@ -59,15 +60,14 @@ void LogicWorker::RegisterCallBacks()
 {
 	_fun_callbacks[ID_TEST_MSG_REQ] = [this](shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 			auto data = root["data"].asString();
 			std::cout << "recv test data is  " << data << std::endl;
 
 			Json::Value  rtvalue;
 			Defer defer([this, &rtvalue, session]() {
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_TEST_MSG_RSP);
 				});
 
@@ -77,9 +77,8 @@ void LogicWorker::RegisterCallBacks()
 
 	_fun_callbacks[ID_UPLOAD_FILE_REQ] = [this](shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 			auto md5 = root["md5"].asString();
 			auto seq = root["seq"].asInt();
 			auto name = root["name"].asString();
@@ -106,7 +105,7 @@ void LogicWorker::RegisterCallBacks()
 				rtvalue["last"] = last;
 				rtvalue["md5"] = md5;
 				rtvalue["uid"] = uid;
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_UPLOAD_FILE_RSP);
 			};
 			
@@ -129,7 +128,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(md5, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_UPLOAD_HEAD_ICON_RSP);
 					return;
 				}
@@ -138,7 +137,7 @@ void LogicWorker::RegisterCallBacks()
 				auto file_info = RedisMgr::GetInstance()->GetFileInfo(md5);
 				if (file_info == nullptr) {
 					rtvalue["error"] = ErrorCodes::FileNotExists;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_UPLOAD_FILE_RSP);
 					return;
 				}
@@ -147,7 +146,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(md5, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_UPLOAD_FILE_RSP);
 					return;
 				}
@@ -166,13 +165,12 @@ void LogicWorker::RegisterCallBacks()
 	_fun_callbacks[ID_SYNC_FILE_REQ] = [this](shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
 
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 
 			Json::Value  rtvalue;
 			Defer defer([this, &rtvalue, session]() {
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_SYNC_FILE_RSP);
 				});
 
@@ -196,9 +194,8 @@ void LogicWorker::RegisterCallBacks()
 
 	_fun_callbacks[ID_UPLOAD_HEAD_ICON_REQ] = [this](shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 			auto md5 = root["md5"].asString();
 			auto seq = root["seq"].asInt();
 			auto name = root["name"].asString();
@@ -227,7 +224,7 @@ void LogicWorker::RegisterCallBacks()
 				rtvalue["md5"] = md5;
 				rtvalue["uid"] = uid;
 				rtvalue["last_seq"] = last_seq;
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_UPLOAD_HEAD_ICON_RSP);
 			};
 
@@ -240,14 +237,14 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->Get(token_key, token_value);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::UidInvalid;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_UPLOAD_HEAD_ICON_RSP);
 					return;
 				}
 
 				if (token_value != token) {
 					rtvalue["error"] = ErrorCodes::TokenInvalid;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_UPLOAD_HEAD_ICON_RSP);
 					return;
 				}
@@ -273,7 +270,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(name, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_UPLOAD_HEAD_ICON_RSP);
 					return;
 				}
@@ -284,7 +281,7 @@ void LogicWorker::RegisterCallBacks()
 				auto file_info = RedisMgr::GetInstance()->GetFileInfo(name);
 				if (file_info == nullptr) {
 					rtvalue["error"] = ErrorCodes::FileNotExists;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_UPLOAD_HEAD_ICON_RSP);
 					return;
 				}
@@ -293,7 +290,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(name, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_UPLOAD_HEAD_ICON_RSP);
 					return;
 				}
@@ -310,9 +307,8 @@ void LogicWorker::RegisterCallBacks()
 
 	_fun_callbacks[ID_DOWN_LOAD_FILE_REQ] = [this](shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 			auto seq = root["seq"].asInt();
 			auto name = root["name"].asString();
 			auto uid = root["uid"].asInt();
@@ -332,7 +328,7 @@ void LogicWorker::RegisterCallBacks()
 				rtvalue["client_path"] = client_path;
 				rtvalue["name"] = name;
 				rtvalue["req_type"] = req_type;
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_DOWN_LOAD_FILE_RSP);
 			};
 
@@ -345,14 +341,14 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->Get(token_key, token_value);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::UidInvalid;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_DOWN_LOAD_FILE_RSP);
 					return;
 				}
 
 				if (token_value != token) {
 					rtvalue["error"] = ErrorCodes::TokenInvalid;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_DOWN_LOAD_FILE_RSP);
 					return;
 				}
@@ -373,9 +369,8 @@ void LogicWorker::RegisterCallBacks()
 
 	_fun_callbacks[ID_IMG_CHAT_UPLOAD_REQ] = [this](shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 			auto md5 = root["md5"].asString();
 			auto seq = root["seq"].asInt();
 			auto name = root["name"].asString();
@@ -409,7 +404,7 @@ void LogicWorker::RegisterCallBacks()
 				rtvalue["uid"] = uid;
 				rtvalue["sender"] = sender;
 				rtvalue["receiver"] = receiver;
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_IMG_CHAT_UPLOAD_RSP);
 			};
 
@@ -431,7 +426,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(name, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_IMG_CHAT_UPLOAD_RSP);
 					return;
 				}
@@ -440,7 +435,7 @@ void LogicWorker::RegisterCallBacks()
 				auto file_info = RedisMgr::GetInstance()->GetFileInfo(name);
 				if (file_info == nullptr) {
 					rtvalue["error"] = ErrorCodes::FileNotExists;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_IMG_CHAT_UPLOAD_RSP);
 					return;
 				}
@@ -449,7 +444,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(name, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_IMG_CHAT_UPLOAD_RSP);
 					return;
 				}
@@ -466,9 +461,8 @@ void LogicWorker::RegisterCallBacks()
 	// 处理同步信息回包
 	_fun_callbacks[ID_FILE_INFO_SYNC_REQ] = [this](shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 			auto md5 = root["md5"].asString();
 			auto seq = root["seq"].asInt();
 			auto name = root["name"].asString();
@@ -500,7 +494,7 @@ void LogicWorker::RegisterCallBacks()
 				rtvalue["uid"] = uid;
 				rtvalue["sender"] = sender;
 				rtvalue["receiver"] = receiver;
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_FILE_INFO_SYNC_RSP);
 			};
 
@@ -522,7 +516,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(name, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_FILE_INFO_SYNC_RSP);
 					return;
 				}
@@ -531,7 +525,7 @@ void LogicWorker::RegisterCallBacks()
 				auto file_info = RedisMgr::GetInstance()->GetFileInfo(name);
 				if (file_info == nullptr) {
 					rtvalue["error"] = ErrorCodes::FileNotExists;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_FILE_INFO_SYNC_RSP);
 					return;
 				}
@@ -540,7 +534,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(name, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_FILE_INFO_SYNC_RSP);
 					return;
 				}
@@ -558,9 +552,8 @@ void LogicWorker::RegisterCallBacks()
 	// 响应聊天图片断点续传请求
 	_fun_callbacks[ID_IMG_CHAT_CONTINUE_UPLOAD_REQ] = [this](shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 			auto md5 = root["md5"].asString();
 			auto seq = root["seq"].asInt();
 			auto name = root["name"].asString();
@@ -592,7 +585,7 @@ void LogicWorker::RegisterCallBacks()
 				rtvalue["uid"] = uid;
 				rtvalue["sender"] = sender;
 				rtvalue["receiver"] = receiver;
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_IMG_CHAT_CONTINUE_UPLOAD_RSP);
 			};
 
@@ -614,7 +607,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(name, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_IMG_CHAT_CONTINUE_UPLOAD_RSP);
 					return;
 				}
@@ -623,7 +616,7 @@ void LogicWorker::RegisterCallBacks()
 				auto file_info = RedisMgr::GetInstance()->GetFileInfo(name);
 				if (file_info == nullptr) {
 					rtvalue["error"] = ErrorCodes::FileNotExists;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_IMG_CHAT_CONTINUE_UPLOAD_RSP);
 					return;
 				}
@@ -632,7 +625,7 @@ void LogicWorker::RegisterCallBacks()
 				bool success = RedisMgr::GetInstance()->SetFileInfo(name, file_info);
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::FileSaveRedisFailed;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_IMG_CHAT_CONTINUE_UPLOAD_RSP);
 					return;
 				}
@@ -648,9 +641,8 @@ void LogicWorker::RegisterCallBacks()
 
 	_fun_callbacks[ID_IMG_CHAT_DOWN_INFO_SYNC_REQ] = [this](std::shared_ptr<CSession> session, const short& msg_id,
 		const string& msg_data) {
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 			auto message_id = root["message_id"].asInt();
 			auto chat_msg = MysqlMgr::GetInstance()->GetChatMsgById(message_id);
 			if (chat_msg == nullptr) {
@@ -677,16 +669,15 @@ void LogicWorker::RegisterCallBacks()
 			rtvalue["msg_type"] = chat_msg->msg_type;
 			rtvalue["status"] = chat_msg->status;
 			rtvalue["total_size"] = std::to_string(file_size);
-			std::string return_str = rtvalue.toStyledString();
+			std::string return_str = toJsonString(rtvalue);
 			session->Send(return_str, ID_IMG_CHAT_DOWN_INFO_SYNC_RSP);
 		};
 
 	_fun_callbacks[ID_IMG_CHAT_DOWN_REQ] = [this](std::shared_ptr<CSession> session, const short& msg_req_id,
 		const string& msg_data) {
 
-			Json::Reader reader;
 			Json::Value root;
-			reader.parse(msg_data, root);
+			parseJson(msg_data, root);
 
 			auto seq = root["seq"].asInt();
 			auto name = root["name"].asString();
@@ -706,7 +697,7 @@ void LogicWorker::RegisterCallBacks()
 				rtvalue["name"] = name;
 				rtvalue["sender_id"] = sender;
 				rtvalue["receiver_id"] = receiver;
-				std::string return_str = rtvalue.toStyledString();
+				std::string return_str = toJsonString(rtvalue);
 				session->Send(return_str, ID_IMG_CHAT_DOWN_RSP);
 			};
 
@@ -727,14 +718,14 @@ void LogicWorker::RegisterCallBacks()
 				Json::Value  rtvalue;
 				if (!success) {
 					rtvalue["error"] = ErrorCodes::UidInvalid;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_IMG_CHAT_DOWN_RSP);
 					return;
 				}
 
 				if (token_value != token) {
 					rtvalue["error"] = ErrorCodes::TokenInvalid;
-					std::string return_str = rtvalue.toStyledString();
+					std::string return_str = toJsonString(rtvalue);
 					session->Send(return_str, ID_IMG_CHAT_DOWN_RSP);
 					return;
 				}
@@ -5,6 +5,7 @@
 #include <json/json.h>
 #include <json/value.h>
 #include <json/reader.h>
+#include "../Common/jsonutil.h"
 RedisMgr::RedisMgr() {
 	auto& gCfgMgr = ConfigMgr::Inst();
 	auto host = gCfgMgr["Redis"]["Host"];
@@ -342,6 +343,28 @@ bool RedisMgr::HDel(const std::string& key, const std::string& field)
 	return success;
 }
 
+bool RedisMgr::ZRem(const std::string& key, const std::string& member)
+{
+	auto connect = _con_pool->getConnection();
+	if (connect == nullptr) {
+		return false;
+	}
+
+	Defer defer([&connect, this]() {
+		_con_pool->returnConnection(connect);
+		});
+
+	redisReply* reply = (redisReply*)redisCommand(connect, "ZREM %s %s", key.c_str(), member.c_str());
+	if (reply == nullptr) {
+		std::cerr << "ZREM command failed" << std::endl;
+		return false;
+	}
+
+	bool success = reply->type == REDIS_REPLY_INTEGER;
+	freeReplyObject(reply);
+	return success;
+}
+
 bool RedisMgr::Del(const std::string &key)
 {
 	auto connect = _con_pool->getConnection();
@@ -498,28 +521,26 @@ void RedisMgr::DelCount(std::string server_name) {
 
 bool RedisMgr::SetFileInfo(const std::string& name, std::shared_ptr<FileInfo> file_info)
 {
-	Json::Reader reader;
 	Json::Value root;
 	root["file_path_str"] = file_info->_file_path_str;
 	root["name"] = file_info->_name;
 	root["seq"] = file_info->_seq;
 	root["total_size"] = std::to_string(file_info->_total_size);
 	root["trans_size"] = std::to_string(file_info->_trans_size);
-	auto file_info_str = root.toStyledString();
+	auto file_info_str = toJsonString(root);
 	auto redis_key = "file_upload_" + name;
 	bool success = SetExp(redis_key, file_info_str, 3600);
 	return success;
 }
 
 bool RedisMgr::SetDownLoadInfo(const std::string& name, std::shared_ptr<FileInfo> file_info) {
-	Json::Reader reader;
 	Json::Value root;
 	root["file_path_str"] = file_info->_file_path_str;
 	root["name"] = file_info->_name;
 	root["seq"] = file_info->_seq;
 	root["total_size"] = std::to_string(file_info->_total_size);
 	root["trans_size"] = std::to_string(file_info->_trans_size);
-	auto file_info_str = root.toStyledString();
+	auto file_info_str = toJsonString(root);
 	auto redis_key = "file_download_" + name;
 	bool success = SetExp(redis_key, file_info_str, 3600);
 	return success;
@@ -541,9 +562,8 @@ std::shared_ptr<FileInfo> RedisMgr::GetFileInfo(const std::string& name) {
 	}
 
 	// 解析 JSON
-	Json::Reader reader;
 	Json::Value root;
-	if (!reader.parse(file_info_str, root)) {
+	if (!parseJson(file_info_str, root)) {
 		std::cout << "Failed to parse file info JSON for name: " << name << std::endl;
 		return nullptr;
 	}
@@ -577,9 +597,8 @@ std::shared_ptr<FileInfo> RedisMgr::GetDownloadInfo(const std::string& name) {
 	}
 
 	// 解析 JSON
-	Json::Reader reader;
 	Json::Value root;
-	if (!reader.parse(file_info_str, root)) {
+	if (!parseJson(file_info_str, root)) {
 		std::cout << "Failed to parse file info JSON for name: " << name << std::endl;
 		return nullptr;
 	}
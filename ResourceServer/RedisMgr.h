@@ -283,6 +283,7 @@ public:
 	bool HSet(const char* key, const char* hkey, const char* hvalue, size_t hvaluelen);
 	std::string HGet(const std::string &key, const std::string &hkey);
 	bool HDel(const std::string& key, const std::string& field);
+	bool ZRem(const std::string& key, const std::string& member);
 	bool Del(const std::string &key);
 	bool ExistsKey(const std::string &key);
 	void Close() {
@@ -103,6 +103,9 @@ enum MSG_IDS {
 
 #define LOCK_PREFIX "lock_"
 #define USER_SESSION_PREFIX "usession_"
+#define THREAD_MSG_PREFIX "threadmsg_"      // ChatServer的会话最近消息缓存
+#define THREAD_MSG_FLOOR "floor"           // 消息缓存中记录窗口下界的成员
+#define CHAT_MSG_UPLOADED_PREFIX "chatmsguploaded_" // ChatServer还没落库时已上传完成的图片消息
 #define LOCK_COUNT "lockcount"
 
 //分布式锁的持有时间
@@ -1,4 +1,5 @@
-﻿#include "chatdialog.h"
+﻿#include "message.pb.h"
+#include "chatdialog.h"
 #include "ui_chatdialog.h"
 #include <QAction>
 #include "chatuserwid.h"
@@ -164,6 +165,15 @@ ChatDialog::ChatDialog(QWidget* parent) :
 	timer_ = new QTimer(this);
 	connect(timer_, &QTimer::timeout, this, [this]() {
 		auto user_info = UserMgr::getInstance()->getUserInfo();
+		//登录时服务器确认了protobuf编码则直接组织protobuf心跳
+		if (TcpMgr::getInstance()->useProtobuf()) {
+			message::ClientHeartBeatReq req;
+			req.set_fromuid(user_info->_uid);
+			std::string body = req.SerializeAsString();
+			emit TcpMgr::getInstance()->sig_send_data(ReqId::ID_HEART_BEAT_REQ,
+				QByteArray(body.data(), static_cast<qsizetype>(body.size())));
+			return;
+		}
 		QJsonObject textObj;
 		textObj["fromuid"] = user_info->_uid;
 		QJsonDocument doc(textObj);
@@ -217,6 +227,8 @@ void ChatDialog::loadChatList() {
 	jsonObj["uid"] = uid;
 	int last_chat_thread_id = UserMgr::getInstance()->getLastChatThreadId();
 	jsonObj["thread_id"] = last_chat_thread_id;
+	jsonObj["last_msg_id"] = UserMgr::getInstance()->getLastChatThreadMsgId();
+	jsonObj["snapshot"] = UserMgr::getInstance()->getChatThreadSnapshot();
 
 
 	QJsonDocument doc(jsonObj);
@@ -357,14 +369,21 @@ void ChatDialog::updateChatMsg(std::vector<std::shared_ptr<TextChatData> > msgda
 }
 
 
-void ChatDialog::slot_load_chat_thread(bool load_more, int last_thread_id,
+void ChatDialog::slot_load_chat_thread(bool load_more, int last_thread_id, qint64 last_msg_id, qint64 snapshot,
 	std::vector<std::shared_ptr<ChatThreadInfo>> chat_threads) {
+	//加载期间有新消息的会话放在列表顶部，按服务器返回的顺序排列
+	int changed_row = 0;
 	for (auto& cti : chat_threads) {
 		//先处理单聊，群聊跳过，以后添加
 		if (cti->_type == "group") {
 			continue;
 		}
 
+		//按thread_id合并，同一会话可能在翻页和最后一页的变化列表中各返回一次
+		if (chat_thread_items_.contains(cti->_thread_id)) {
+			continue;
+		}
+
 		auto uid = UserMgr::getInstance()->getUid();
 		auto other_uid = 0;
 		if (uid == cti->_user1_id) {
@@ -382,19 +401,28 @@ void ChatDialog::slot_load_chat_thread(bool load_more, int last_thread_id,
 		QListWidgetItem* item = new QListWidgetItem;
 		//qDebug()<<"chat_user_wid sizeHint is " << chat_user_wid->sizeHint();
 		item->setSizeHint(chat_user_wid->sizeHint());
-		ui->chat_user_list->addItem(item);
+		if (cti->_changed) {
+			ui->chat_user_list->insertItem(changed_row++, item);
+		}
+		else {
+			ui->chat_user_list->addItem(item);
+		}
 		ui->chat_user_list->setItemWidget(item, chat_user_wid);
 		chat_thread_items_.insert(cti->_thread_id, item);
 	}
 
 	UserMgr::getInstance()->setLastChatThreadId(last_thread_id);
+	UserMgr::getInstance()->setLastChatThreadMsgId(last_msg_id);
+	UserMgr::getInstance()->setChatThreadSnapshot(snapshot);
 
 	if (load_more) {
-		//发送请求逻辑
+		//发送请求逻辑，游标和快照原样带回
 		QJsonObject jsonObj;
 		auto uid = UserMgr::getInstance()->getUid();
 		jsonObj["uid"] = uid;
 		jsonObj["thread_id"] = last_thread_id;
+		jsonObj["last_msg_id"] = last_msg_id;
+		jsonObj["snapshot"] = snapshot;
 
 
 		QJsonDocument doc(jsonObj);
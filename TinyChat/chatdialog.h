@@ -38,7 +38,7 @@ public slots:
 	void slot_img_chat_msg(std::shared_ptr<ImgChatData> imgchat);	// 收到图片聊天信息槽函数
 
 	void slot_create_private_chat(int uid, int other_id, int thread_id);	// 创建私人聊天槽函数
-	void slot_load_chat_thread(bool load_more, int last_thread_id,
+	void slot_load_chat_thread(bool load_more, int last_thread_id, qint64 last_msg_id, qint64 snapshot,
 		std::vector<std::shared_ptr<ChatThreadInfo>> chat_threads);	// 加载聊天线程列表槽函数
 	void slot_load_chat_msg(int thread_id, int msg_id, bool load_more,
 		std::vector<std::shared_ptr<ChatDataBase>> msglists);		// 加载聊天消息槽函数
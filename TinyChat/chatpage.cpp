@@ -1,4 +1,5 @@
-﻿#include "chatpage.h"
+﻿#include "message.pb.h"
+#include "chatpage.h"
 #include "ui_chatpage.h"
 #include <QStyleOption>
 #include <QPainter>
@@ -411,8 +412,36 @@ void ChatPage::on_send_btn_clicked() {
     const QVector<std::shared_ptr<MsgInfo>>& msgList = pTextEdit->getMsgList();
     QJsonObject textObj;
     QJsonArray textArray;
+    //登录时服务器确认了protobuf编码则直接组织protobuf请求，不再经过json
+    bool use_protobuf = TcpMgr::getInstance()->useProtobuf();
+    message::ClientTextChatMsgReq textReq;
     int txt_size = 0;
     auto thread_id = chat_data_->GetThreadId();
+    //发送并清空之前累计的文本列表
+    auto sendTextMsg = [&]() {
+        QByteArray data;
+        if (use_protobuf) {
+            textReq.set_fromuid(user_info->_uid);
+            textReq.set_touid(chat_data_->GetOtherId());
+            textReq.set_thread_id(thread_id);
+            std::string body = textReq.SerializeAsString();
+            data = QByteArray(body.data(), static_cast<qsizetype>(body.size()));
+            textReq.Clear();
+        }
+        else {
+            textObj["fromuid"] = user_info->_uid;
+            textObj["touid"] = chat_data_->GetOtherId();
+            textObj["thread_id"] = thread_id;
+            textObj["text_array"] = textArray;
+            QJsonDocument doc(textObj);
+            data = doc.toJson(QJsonDocument::Compact);
+            textArray = QJsonArray();
+            textObj = QJsonObject();
+        }
+        txt_size = 0;
+        //发送tcp请求给chat server
+        emit TcpMgr::getInstance()->sig_send_data(ReqId::ID_TEXT_CHAT_MSG_REQ, data);
+    };
     for (int i = 0; i < msgList.size(); ++i) {
         //消息内容长度不合规就跳过
         if (msgList[i]->_text_or_url.length() > 1024) {
@@ -431,29 +460,25 @@ void ChatPage::on_send_btn_clicked() {
         if (type == MsgType::TEXT_MSG) {
             pBubble = new TextBubble(role, msgList[i]->_text_or_url);
             if (txt_size + msgList[i]->_text_or_url.length() > 1024) {
-                textObj["fromuid"] = user_info->_uid;
-                textObj["touid"] = chat_data_->GetOtherId();
-                textObj["thread_id"] = thread_id;
-                textObj["text_array"] = textArray;
-                QJsonDocument doc(textObj);
-                QByteArray jsonData = doc.toJson(QJsonDocument::Compact);
-                //发送并清空之前累计的文本列表
-                txt_size = 0;
-                textArray = QJsonArray();
-                textObj = QJsonObject();
-                //发送tcp请求给chat server
-                emit TcpMgr::getInstance()->sig_send_data(ReqId::ID_TEXT_CHAT_MSG_REQ, jsonData);
+                sendTextMsg();
             }
 
             //将bubble和uid绑定，以后可以等网络返回消息后设置是否送达
             //_bubble_map[uuidString] = pBubble;
             txt_size += msgList[i]->_text_or_url.length();
-            QJsonObject obj;
             QByteArray utf8Message = msgList[i]->_text_or_url.toUtf8();
             auto content = QString::fromUtf8(utf8Message);
-            obj["content"] = content;
-            obj["unique_id"] = uuidString;
-            textArray.append(obj);
+            if (use_protobuf) {
+                auto* item = textReq.add_text_array();
+                item->set_content(utf8Message.toStdString());
+                item->set_unique_id(uuidString.toStdString());
+            }
+            else {
+                QJsonObject obj;
+                obj["content"] = content;
+                obj["unique_id"] = uuidString;
+                textArray.append(obj);
+            }
             //注意，此处先按私聊处理
             auto txt_msg = std::make_shared<TextChatData>(uuidString, thread_id, ChatFormType::PRIVATE,
                 ChatMsgType::TEXT, content, user_info->_uid, 0);
@@ -463,18 +488,7 @@ void ChatPage::on_send_btn_clicked() {
         else if (type == MsgType::IMG_MSG) {
             //将之前缓存的文本发送过去
             if (txt_size) {
-                textObj["fromuid"] = user_info->_uid;
-                textObj["touid"] = chat_data_->GetOtherId();
-                textObj["thread_id"] = thread_id;
-                textObj["text_array"] = textArray;
-                QJsonDocument doc(textObj);
-                QByteArray jsonData = doc.toJson(QJsonDocument::Compact);
-                //发送并清空之前累计的文本列表
-                txt_size = 0;
-                textArray = QJsonArray();
-                textObj = QJsonObject();
-                //发送tcp请求给chat server
-                emit TcpMgr::getInstance()->sig_send_data(ReqId::ID_TEXT_CHAT_MSG_REQ, jsonData);
+                sendTextMsg();
             }
 
             pBubble = new PictureBubble(QPixmap(msgList[i]->_text_or_url), role, msgList[i]->_total_size);
@@ -523,20 +537,8 @@ void ChatPage::on_send_btn_clicked() {
     }
 
     if (txt_size > 0) {
-        qDebug() << "textArray is " << textArray;
         //发送给服务器
-        textObj["text_array"] = textArray;
-        textObj["fromuid"] = user_info->_uid;
-        textObj["touid"] = chat_data_->GetOtherId();
-        textObj["thread_id"] = thread_id;
-        QJsonDocument doc(textObj);
-        QByteArray jsonData = doc.toJson(QJsonDocument::Compact);
-        //发送并清空之前累计的文本列表
-        txt_size = 0;
-        textArray = QJsonArray();
-        textObj = QJsonObject();
-        //发送tcp请求给chat server
-        emit TcpMgr::getInstance()->sig_send_data(ReqId::ID_TEXT_CHAT_MSG_REQ, jsonData);
+        sendTextMsg();
     }
 }
 
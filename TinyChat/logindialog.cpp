@@ -202,6 +202,8 @@ void LoginDialog::slot_res_con_finish(bool bsuccess) {
         QJsonObject jsonObj;
         jsonObj["uid"] = si_->_uid;
         jsonObj["token"] = si_->_token;
+        //请求聊天消息和心跳使用protobuf编码，服务器在登录回复中确认
+        jsonObj["codec"] = "protobuf";
 
         QJsonDocument doc(jsonObj);
         QByteArray jsonData = doc.toJson(QJsonDocument::Indented);
@@ -1,4 +1,5 @@
-﻿#include "tcpmgr.h"
+﻿#include "message.pb.h"
+#include "tcpmgr.h"
 #include "usermgr.h"
 #include "filetcpmgr.h"
 #include <QStandardPaths>
@@ -26,7 +27,7 @@ TcpThread::~TcpThread() {
 }
 
 TcpMgr::TcpMgr() :host_(""), port_(0), b_recv_pending_(false), message_id_(0), 
-message_len_(0), bytes_sent_(0), pending_(false), socket_(this) {
+message_len_(0), bytes_sent_(0), pending_(false), use_protobuf_(false), socket_(this) {
     registerMetaType();
     QObject::connect(&socket_, &QTcpSocket::connected, [&]() {
         qDebug() << "Connected to server!";
@@ -159,6 +160,8 @@ void TcpMgr::slot_tcp_connect(std::shared_ptr<ServerInfo> si) {
     qDebug() << "Connecting to server...";
     host_ = si->_chat_host;
     port_ = static_cast<uint16_t>(si->_chat_port.toUInt());
+    //新连接在登录确认前使用json
+    use_protobuf_ = false;
     socket_.connectToHost(host_, port_);
 }
 
@@ -242,6 +245,8 @@ void TcpMgr::initHandlers() {
 
         UserMgr::getInstance()->setUserInfo(user_info);
         UserMgr::getInstance()->setToken(jsonObj["token"].toString());
+        //服务器回显codec表示同意，之后聊天消息和心跳使用protobuf
+        use_protobuf_ = jsonObj["codec"].toString() == "protobuf";
         if (jsonObj.contains("apply_list")) {
             UserMgr::getInstance()->appendApplyList(jsonObj["apply_list"].toArray());
         }
@@ -445,6 +450,14 @@ void TcpMgr::initHandlers() {
     handlers_.insert(ID_TEXT_CHAT_MSG_RSP, [this](ReqId id, int len, QByteArray data) {
         Q_UNUSED(len);
         qDebug() << "handle id is " << id << " data is " << data;
+        if (use_protobuf_) {
+            int thread_id = 0;
+            std::vector<std::shared_ptr<TextChatData>> chat_datas;
+            if (decodeTextChatMsg(data, thread_id, chat_datas)) {
+                emit sig_chat_msg_rsp(thread_id, chat_datas);
+            }
+            return;
+        }
         // 将QByteArray转换为QJsonDocument
         QJsonDocument jsonDoc = QJsonDocument::fromJson(data);
 
@@ -495,6 +508,14 @@ void TcpMgr::initHandlers() {
     handlers_.insert(ID_NOTIFY_TEXT_CHAT_MSG_REQ, [this](ReqId id, int len, QByteArray data) {
         Q_UNUSED(len);
         qDebug() << "handle id is " << id << " data is " << data;
+        if (use_protobuf_) {
+            int thread_id = 0;
+            std::vector<std::shared_ptr<TextChatData>> chat_datas;
+            if (decodeTextChatMsg(data, thread_id, chat_datas)) {
+                emit sig_text_chat_msg(chat_datas);
+            }
+            return;
+        }
         // 将QByteArray转换为QJsonDocument
         QJsonDocument jsonDoc = QJsonDocument::fromJson(data);
 
@@ -580,6 +601,19 @@ void TcpMgr::initHandlers() {
     handlers_.insert(ID_HEARTBEAT_RSP, [this](ReqId id, int len, QByteArray data) {
         Q_UNUSED(len);
         qDebug() << "handle id is " << id << " data is " << data;
+        if (use_protobuf_) {
+            message::ClientHeartBeatRsp rsp;
+            if (!rsp.ParseFromArray(data.constData(), data.size())) {
+                qDebug() << "Heart Beat Msg Failed, protobuf parse err";
+                return;
+            }
+            if (rsp.error() != ErrorCodes::SUCCESS) {
+                qDebug() << "Heart Beat Msg Failed, err is " << rsp.error();
+                return;
+            }
+            qDebug() << "Receive Heart Beat Msg Success";
+            return;
+        }
         // 将QByteArray转换为QJsonDocument
         QJsonDocument jsonDoc = QJsonDocument::fromJson(data);
 
@@ -644,13 +678,16 @@ void TcpMgr::initHandlers() {
             cti->_type = value["type"].toString();
             cti->_user1_id = value["user1_id"].toInt();
             cti->_user2_id = value["user2_id"].toInt();
+            cti->_changed = value["changed"].toBool();
             chat_threads.push_back(cti);
         }
 
         bool load_more = jsonObj["load_more"].toBool();
         int next_last_id = jsonObj["next_last_id"].toInt();
+        qint64 next_last_msg_id = jsonObj["next_last_msg_id"].toVariant().toLongLong();
+        qint64 snapshot = jsonObj["snapshot"].toVariant().toLongLong();
         //发送信号通知界面
-        emit sig_load_chat_thread(load_more, next_last_id, chat_threads);
+        emit sig_load_chat_thread(load_more, next_last_id, next_last_msg_id, snapshot, chat_threads);
         });
 
     // 注册创建私聊回调函数
@@ -992,6 +1029,31 @@ void TcpMgr::handleMsg(ReqId id, int len, QByteArray data) {
     find_iter.value()(id, len, data);
 }
 
+// 解析protobuf编码的文本聊天回复或通知
+bool TcpMgr::decodeTextChatMsg(const QByteArray& data, int& thread_id,
+    std::vector<std::shared_ptr<TextChatData>>& chat_datas) {
+    message::ClientTextChatMsgRsp rsp;
+    if (!rsp.ParseFromArray(data.constData(), data.size())) {
+        qDebug() << "Text Chat Msg Failed, protobuf parse err";
+        return false;
+    }
+    if (rsp.error() != ErrorCodes::SUCCESS) {
+        qDebug() << "Text Chat Msg Failed, err is " << rsp.error();
+        return false;
+    }
+
+    thread_id = rsp.thread_id();
+    auto sender = rsp.fromuid();
+    for (const auto& chat : rsp.chat_datas()) {
+        auto chat_data = std::make_shared<TextChatData>(chat.message_id(),
+            QString::fromStdString(chat.unique_id()), thread_id, ChatFormType::PRIVATE,
+            ChatMsgType::TEXT, QString::fromStdString(chat.content()), sender, chat.status(),
+            QString::fromStdString(chat.chat_time()));
+        chat_datas.push_back(chat_data);
+    }
+    return true;
+}
+
 void TcpMgr::createPlaceholderImgMsgL(QString img_path_str, QString msg_content,
     int msg_id, int thread_id, int send_uid, int recv_id, int status, QString chat_time,
     std::vector<std::shared_ptr<ChatDataBase>>& chat_datas) {
@@ -1027,6 +1089,11 @@ void TcpMgr::closeConnection() {
     emit sig_close();
 }
 
+// 服务器是否确认使用protobuf编码
+bool TcpMgr::useProtobuf() {
+    return use_protobuf_;
+}
+
 // tcp关闭槽函数
 void TcpMgr::slot_tcp_close() {
     socket_.close();
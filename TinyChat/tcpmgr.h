@@ -7,6 +7,7 @@
 #include <QJsonDocument>
 #include <QThread>
 #include <QQueue>
+#include <atomic>
 #include "singleton.h"
 #include "global.h"
 #include "userdata.h"
@@ -36,6 +37,8 @@ public:
     TcpMgr();
     // 关闭链接
     void closeConnection();
+    // 服务器是否确认文本聊天消息和心跳使用protobuf编码，界面据此直接组织请求体
+    bool useProtobuf();
 private:
     QTcpSocket socket_;
     QString host_;
@@ -54,8 +57,13 @@ private:
     qint64 bytes_sent_;
     //是否正在发送
     bool pending_;
+    //登录时服务器确认使用protobuf编码聊天消息和心跳，界面线程组织请求时读取
+    std::atomic<bool> use_protobuf_;
 
     void initHandlers();
+    // 解析protobuf编码的文本聊天回复或通知，失败返回false
+    bool decodeTextChatMsg(const QByteArray& data, int& thread_id,
+        std::vector<std::shared_ptr<TextChatData>>& chat_datas);
     // 处理消息
     void handleMsg(ReqId id, int len, QByteArray data);
     // 注册自定义的类型
@@ -85,7 +93,7 @@ signals:
     void sig_notify_offline();                              // 通知客户端下线
     void sig_close();                                       // 关闭连接信号
     void sig_connection_closed();                           // 连接断开信号
-    void sig_load_chat_thread(bool load_more, int last_thread_id,
+    void sig_load_chat_thread(bool load_more, int last_thread_id, qint64 last_msg_id, qint64 snapshot,
         std::vector<std::shared_ptr<ChatThreadInfo>> chat_list);    // 加载聊天线程完成信号
     void sig_create_private_chat(int uid, int other_id, int thread_id); // 创建私聊完成信号
     void sig_load_chat_msg(int thread_id, int last_msg_id, bool load_more, 
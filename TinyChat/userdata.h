@@ -245,6 +245,7 @@ struct ChatThreadInfo {
     QString _type;     // "private" or "group"
     int _user1_id;    // 私聊时对应 private_chat.user1_id；群聊时设为 0
     int _user2_id;    // 私聊时对应 private_chat.user2_id；群聊时设为 0
+    bool _changed = false;  // 列表加载期间有了新消息的会话，放到列表顶部
     ChatThreadInfo() = default;
 };
 
@@ -170,7 +170,8 @@ std::vector<std::shared_ptr<UserInfo>> UserMgr::getConListPerPage() {
 }
 
 // 初始化成员变量和加载计数
-UserMgr::UserMgr() :user_info_(nullptr), chat_loaded_(0), contact_loaded_(0), last_chat_thread_id_(0), cur_load_chat_index_(0) {
+UserMgr::UserMgr() :user_info_(nullptr), chat_loaded_(0), contact_loaded_(0), last_chat_thread_id_(0),
+    last_chat_thread_msg_id_(0), chat_thread_snapshot_(0), cur_load_chat_index_(0) {
 
 }
 
@@ -276,6 +277,26 @@ void UserMgr::setLastChatThreadId(int id) {
     last_chat_thread_id_ = id;
 }
 
+qint64 UserMgr::getLastChatThreadMsgId() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return last_chat_thread_msg_id_;
+}
+
+void UserMgr::setLastChatThreadMsgId(qint64 id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    last_chat_thread_msg_id_ = id;
+}
+
+qint64 UserMgr::getChatThreadSnapshot() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return chat_thread_snapshot_;
+}
+
+void UserMgr::setChatThreadSnapshot(qint64 snapshot) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    chat_thread_snapshot_ = snapshot;
+}
+
 void UserMgr::addChatThreadData(std::shared_ptr<ChatThreadData> chat_thread_data, int other_uid) {
     std::lock_guard<std::mutex> lock(mtx_);
     //建立会话id到数据的映射关系
@@ -70,6 +70,12 @@ public:
     int getLastChatThreadId();
     // 记录当前正在进行的或最后一次操作的聊天会话 ID
     void setLastChatThreadId(int id);
+    // 会话列表翻页游标中上一页最后一个会话的最近消息id
+    qint64 getLastChatThreadMsgId();
+    void setLastChatThreadMsgId(qint64 id);
+    // 会话列表第一页时服务器记下的快照
+    qint64 getChatThreadSnapshot();
+    void setChatThreadSnapshot(qint64 snapshot);
     // 将会话线程对象存入管理中心
     void addChatThreadData(std::shared_ptr<ChatThreadData> chat_thread_data, int other_uid);
     // 根据好友的 UID 查找对应的会话 ID
@@ -132,6 +138,10 @@ private:
     int cur_load_chat_index_;
     //上次会话的id
     int last_chat_thread_id_;
+    //上次会话的最近消息id，和上次会话的id一起作为会话列表的翻页游标
+    qint64 last_chat_thread_msg_id_;
+    //会话列表的快照，翻页时原样带回
+    qint64 chat_thread_snapshot_;
     //缓存其他用户uid和聊天的thread_id的映射关系。
     QMap<int, int> uid_to_thread_id_;
     std::mutex mtx_;